@@ -4,12 +4,15 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../Frame.c \
 ../Net_TCP.c 
 
 OBJS += \
+./Frame.o \
 ./Net_TCP.o 
 
 C_DEPS += \
+./Frame.d \
 ./Net_TCP.d 
 
 
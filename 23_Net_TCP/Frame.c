@@ -0,0 +1,142 @@
+/*
+ * 	Frame.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "Frame.h"
+
+int frame_reader_init(frame_reader_t* reader) {
+	reader->buf = malloc(FRAME_READ_SIZE);
+	if (reader->buf == NULL)
+		return -1;
+	reader->cap = FRAME_READ_SIZE;
+	reader->start = reader->end = 0;
+	return 0;
+}
+
+void frame_reader_free(frame_reader_t* reader) {
+	free(reader->buf);
+	reader->buf = NULL;
+	reader->cap = reader->start = reader->end = 0;
+}
+
+/* 待处理数据中第一帧的总长度，帧头还没收齐时返回帧头长度 */
+static uint32_t frame_need(const frame_reader_t* reader) {
+	uint32_t len;
+	if (reader->end - reader->start < FRAME_HEADER_SIZE)
+		return FRAME_HEADER_SIZE;
+	memcpy(&len, reader->buf + reader->start, FRAME_HEADER_SIZE);
+	len = ntohl(len);
+	if (len > FRAME_MAX_SIZE)
+		return FRAME_HEADER_SIZE;
+	return FRAME_HEADER_SIZE + len;
+}
+
+int frame_read(frame_reader_t* reader, int fd) {
+	uint32_t need = frame_need(reader);
+	uint32_t cap;
+	char* buf;
+	int ret;
+	/* 已处理的数据移到前面，空出缓冲区后部 */
+	if (reader->start > 0) {
+		memmove(reader->buf, reader->buf + reader->start,
+				reader->end - reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
+	}
+	/* 放不下一整帧时扩大缓冲区 */
+	if (need > reader->cap) {
+		for (cap = reader->cap; cap < need; cap *= 2)
+			;
+		buf = realloc(reader->buf, cap);
+		if (buf == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		reader->buf = buf;
+		reader->cap = cap;
+	}
+	do {
+		ret = recv(fd, reader->buf + reader->end, reader->cap - reader->end,
+				0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret > 0)
+		reader->end += ret;
+	return ret;
+}
+
+int frame_next(frame_reader_t* reader, const char** payload, uint32_t* len) {
+	uint32_t size;
+	if (reader->end - reader->start < FRAME_HEADER_SIZE)
+		return 0;
+	memcpy(&size, reader->buf + reader->start, FRAME_HEADER_SIZE);
+	size = ntohl(size);
+	if (size > FRAME_MAX_SIZE)
+		return -1;
+	if (reader->end - reader->start < FRAME_HEADER_SIZE + size)
+		return 0;
+	*payload = reader->buf + reader->start + FRAME_HEADER_SIZE;
+	*len = size;
+	reader->start += FRAME_HEADER_SIZE + size;
+	return 1;
+}
+
+void frame_writer_init(frame_writer_t* writer) {
+	memset(writer, 0, sizeof(frame_writer_t));
+}
+
+int frame_add(frame_writer_t* writer, int fd, const void* payload,
+		uint32_t len) {
+	int i;
+	if (writer->count == FRAME_IOV_MAX && frame_flush(writer, fd) < 0)
+		return -1;
+	i = writer->count++;
+	writer->header[i] = htonl(len);
+	writer->iov[2 * i].iov_base = &writer->header[i];
+	writer->iov[2 * i].iov_len = FRAME_HEADER_SIZE;
+	writer->iov[2 * i + 1].iov_base = (void*) payload;
+	writer->iov[2 * i + 1].iov_len = len;
+	return 0;
+}
+
+int frame_flush(frame_writer_t* writer, int fd) {
+	struct iovec* iov = writer->iov;
+	int iovcnt = writer->count * 2;
+	ssize_t ret;
+	writer->frames += writer->count;
+	writer->count = 0;
+	while (iovcnt > 0) {
+		ret = writev(fd, iov, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		writer->writes++;
+		/* 跳过已经发送的部分 */
+		while (iovcnt > 0 && ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char*) iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+	return 0;
+}
+
+int frame_send(int fd, const void* payload, uint32_t len) {
+	frame_writer_t writer;
+	frame_writer_init(&writer);
+	frame_add(&writer, fd, payload, len);
+	return frame_flush(&writer, fd);
+}
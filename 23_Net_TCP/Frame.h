@@ -0,0 +1,115 @@
+/*
+ * 	Frame.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ *  要求：
+ *  	TCP编程---长度前缀的分帧
+ *	********************************************************************
+ *	1. TCP是字节流，一次recv可能只收到半条消息，也可能收到好几条消息，
+ *	不能把一次recv当成一条消息，也不能用strlen判断长度(数据中可能有0)
+ *	2. 每一帧前面加上4字节网络字节序的负载长度，接收方先收齐帧头，再收齐负载
+ *	3. 接收缓冲区保存不完整的帧，下次recv的数据接在后面，一次recv收到的多个帧依次处理
+ *	4. 回复的帧先放入iovec数组，处理完一批请求后用一次writev发送，
+ *	帧头和负载不需要拷贝到一起
+ *	********************************************************************
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define FRAME_HEADER_SIZE	4			//帧头大小，保存负载长度
+#define FRAME_MAX_SIZE		(1 << 20)	//单帧负载的最大长度，超过认为数据错误
+#define FRAME_READ_SIZE		4096		//接收缓冲区的初始大小
+#define FRAME_IOV_MAX		64			//一次writev最多发送的帧数量
+
+/*
+ * 帧接收器，每个连接一个
+ */
+typedef struct {
+	char* buf; //接收缓冲区
+	uint32_t cap; //接收缓冲区大小
+	uint32_t start; //下一帧的开始位置
+	uint32_t end; //已接收数据的结尾
+} frame_reader_t;
+
+/*
+ * 帧发送器，收集一批帧后一次发送
+ */
+typedef struct {
+	struct iovec iov[FRAME_IOV_MAX * 2]; //每帧两项：帧头和负载
+	uint32_t header[FRAME_IOV_MAX]; //帧头
+	int count; //已收集的帧数量
+	uint32_t frames; //发送的帧总数
+	uint32_t writes; //writev调用次数
+} frame_writer_t;
+
+/**
+ * 初始化帧接收器
+ * @param  reader 帧接收器
+ * @return        成功返回0，内存不足返回-1
+ */
+int frame_reader_init(frame_reader_t* reader);
+
+/**
+ * 释放帧接收器的缓冲区
+ * @param reader 帧接收器
+ */
+void frame_reader_free(frame_reader_t* reader);
+
+/**
+ * 从套接字读取一次数据，接在未处理完的数据后面
+ * 之前frame_next取出的负载可能被移动，读取前必须处理完并发送出去
+ * @param  reader 帧接收器
+ * @param  fd     套接字
+ * @return        读到的字节数，对端关闭返回0，出错返回-1并设置errno
+ */
+int frame_read(frame_reader_t* reader, int fd);
+
+/**
+ * 从接收缓冲区取出下一个完整的帧
+ * @param  reader  帧接收器
+ * @param  payload 返回负载的地址，指向接收缓冲区
+ * @param  len     返回负载长度
+ * @return         取出一帧返回1，数据不够一帧返回0，帧长度超过FRAME_MAX_SIZE返回-1
+ */
+int frame_next(frame_reader_t* reader, const char** payload, uint32_t* len);
+
+/**
+ * 初始化帧发送器
+ * @param writer 帧发送器
+ */
+void frame_writer_init(frame_writer_t* writer);
+
+/**
+ * 加入一帧，负载不拷贝，在发送之前必须保持有效；已收集FRAME_IOV_MAX帧时先发送
+ * @param  writer  帧发送器
+ * @param  fd      套接字
+ * @param  payload 负载
+ * @param  len     负载长度
+ * @return         成功返回0，发送出错返回-1
+ */
+int frame_add(frame_writer_t* writer, int fd, const void* payload,
+		uint32_t len);
+
+/**
+ * 用writev发送收集的所有帧，只发送了一部分时继续发送剩下的
+ * @param  writer 帧发送器
+ * @param  fd     阻塞的套接字
+ * @return        成功返回0，出错返回-1
+ */
+int frame_flush(frame_writer_t* writer, int fd);
+
+/**
+ * 发送一帧，用于不需要批量发送的场合
+ * @param  fd      阻塞的套接字
+ * @param  payload 负载
+ * @param  len     负载长度
+ * @return         成功返回0，出错返回-1
+ */
+int frame_send(int fd, const void* payload, uint32_t len);
+
+#endif /* FRAME_H_ */
@@ -22,6 +22,22 @@
  *		a. 这样，服务端程序就可以运行在任意IP地址的机器上(到处运行)
  *		b. 当运行在某机器上后，该机器上不同网口传送过来的数据，只要端口号，网络类型与
  *		服务端程序设定的一致，就能够被服务端程序接收处理（跨网口）
+ *	4. s/c模式把一次recv当成一条消息，消息被拆开或者几条消息粘在一起时就会出错，
+ *	f/p模式使用Frame.h中长度前缀的分帧
+ *		a. 服务端每次recv后处理缓冲区中所有完整的帧，回复放在一起用一次writev发送
+ *		b. 客户端流水线发送请求，不等回复就发送下一个，最多depth个请求在路上，
+ *		往返时间长的时候吞吐量大约提高depth倍
+ *		c. 负载是二进制数据，前8字节是请求序号，回复必须按顺序返回
+ *	5. d/g模式传输文件，请求是一帧文件路径，回复是8字节长度加文件内容
+ *		a. read+send每次都要把数据从内核拷贝到用户缓冲区再拷贝回内核
+ *		b. 普通文件用sendfile，数据直接从页缓存发送到套接字
+ *		c. 管道、字符设备等不能sendfile的来源，用splice经过一个管道转到套接字
+ *		d. MSG_ZEROCOPY发送mmap的文件，网卡直接从这块内存取数据，
+ *		完成通知从错误队列中读取，收到之前不能释放内存；
+ *		只对大块数据有效，回环接口上内核仍然会拷贝
+ *		e. 发送长度前设置TCP_CORK，文件发送完再取消，长度不会单独占一个报文段
+ *		f. 打不开或者不能发送的文件(如目录)在发送长度之前回复长度0，
+ *		已经发送了长度之后出错只能关闭连接，否则客户端会把后面的数据当成文件内容
  *	********************************************************************
  *  int socket(int domain, int type, int protocol);创建套接字
  *  	domain:指定通信协议的协议族
@@ -99,22 +115,544 @@
  *			出错：返回-1，并设置errno
  */
 
+#define _GNU_SOURCE
 #include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/errqueue.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
+#include "Frame.h"
 
 #define PORT				4321
 #define BUFFER_SIZE			1024
 #define MAX_QUE_CONN_NM		5
+#define PAYLOAD_SIZE		64		//流水线请求的负载大小
+#define PIPE_DEPTH_MAX		1024	//最多同时在路上的请求数
+#define BENCH_REQUESTS		4000	//基准测试每轮的请求数
+#define BENCH_DELAY_US		500		//基准测试中服务端每批回复前的延时，模拟往返时间
+#define FILE_CHUNK_SIZE		(256 * 1024)	//splice和MSG_ZEROCOPY每次发送的大小
+#define ZEROCOPY_MIN_SIZE	(16 * 1024)	//小于这个大小时MSG_ZEROCOPY得不偿失
+#define FILE_SIZE_UNKNOWN	UINT64_MAX	//不是普通文件时回复的长度
+#define BENCH_FILE_MB		64		//文件传输测试的文件大小
+#define BENCH_FILE_ROUNDS	8		//文件传输测试每种方式传输的次数
+#define BENCH_FILE_NAME		"Net_TCP.bench"
+
+static int verbose_file = 1;
 
 /* 程序使用说明 */
 void Usage(char* arg) {
 	printf("Usage:%s s/S\r\nUsage:%s c/C ipaddr content\r\n", arg, arg);
+	printf("Usage:%s f/F [delay_us]\r\n", arg);
+	printf("Usage:%s p/P ipaddr [requests] [depth]\r\n", arg);
+	printf("Usage:%s b/B [requests]\r\n", arg);
+	printf("Usage:%s d/D [sendfile|splice|zerocopy|copy]\r\n", arg);
+	printf("Usage:%s g/G ipaddr path [outfile]\r\n", arg);
+	printf("Usage:%s z/Z [size_mb]\r\n", arg);
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 创建监听套接字 */
+static int server_listen(void) {
+	struct sockaddr_in server_sockaddr;
+	int sockfd, opt = 1;
+	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sockfd == -1) {
+		perror("socket");
+		exit(1);
+	}
+	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	memset(&server_sockaddr, 0, sizeof(server_sockaddr));
+	server_sockaddr.sin_family = AF_INET;
+	server_sockaddr.sin_port = htons(PORT);
+	server_sockaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(sockfd, (struct sockaddr*) &server_sockaddr,
+			sizeof(server_sockaddr)) == -1) {
+		perror("bind");
+		exit(1);
+	}
+	if (listen(sockfd, MAX_QUE_CONN_NM) == -1) {
+		perror("listen");
+		exit(1);
+	}
+	return sockfd;
+}
+
+/*
+ * 分帧回显服务，依次服务每个客户端
+ * 每次recv之后取出所有完整的帧，回复加入frame_writer，处理完一起发送，
+ * delay_us不为0时每批回复前等待一段时间，模拟高延时的链路
+ */
+static void server_frame(int sockfd, int delay_us, int verbose) {
+	frame_reader_t reader;
+	frame_writer_t writer;
+	const char* payload;
+	uint32_t len, reads;
+	int client_fd, ret;
+	while (1) {
+		client_fd = accept(sockfd, NULL, NULL);
+		if (client_fd == -1) {
+			perror("accept");
+			exit(1);
+		}
+		if (frame_reader_init(&reader) < 0) {
+			perror("malloc");
+			exit(1);
+		}
+		frame_writer_init(&writer);
+		reads = 0;
+		while ((ret = frame_read(&reader, client_fd)) > 0) {
+			reads++;
+			while ((ret = frame_next(&reader, &payload, &len)) > 0) {
+				if (frame_add(&writer, client_fd, payload, len) < 0)
+					break;
+			}
+			if (ret < 0) {
+				printf("Frame too large, close client\r\n");
+				break;
+			}
+			if (writer.count == 0)
+				continue;
+			if (delay_us)
+				usleep(delay_us);
+			/* 回复引用接收缓冲区，必须在下次frame_read之前发送出去 */
+			if (frame_flush(&writer, client_fd) < 0)
+				break;
+		}
+		if (verbose)
+			printf("Client closed: %u frames, %u recv, %u writev\r\n",
+					writer.frames, reads, writer.writes);
+		frame_reader_free(&reader);
+		close(client_fd);
+	}
+}
+
+/*
+ * 流水线客户端，最多depth个请求没有收到回复
+ * 返回用时(秒)，回复不完整或者顺序不对时退出
+ */
+static double client_pipeline(struct sockaddr_in* addr, int requests,
+		int depth) {
+	static char payload[PIPE_DEPTH_MAX][PAYLOAD_SIZE];
+	frame_reader_t reader;
+	frame_writer_t writer;
+	const char* reply;
+	uint64_t seq, sent = 0, done = 0;
+	uint32_t len;
+	double start;
+	int fd, i, ret, opt = 1;
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		perror("socket");
+		exit(1);
+	}
+	if (connect(fd, (struct sockaddr*) addr, sizeof(*addr)) == -1) {
+		perror("connect");
+		exit(1);
+	}
+	/* 请求已经用writev批量发送，不需要Nagle再攒数据 */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+	if (frame_reader_init(&reader) < 0) {
+		perror("malloc");
+		exit(1);
+	}
+	frame_writer_init(&writer);
+	/* 负载中间有0字节，strlen处理不了 */
+	for (i = 0; i < depth; i++)
+		memset(payload[i] + sizeof(seq), i & 0xFF,
+		PAYLOAD_SIZE - sizeof(seq));
+	start = now();
+	while (done < requests) {
+		/* 补满流水线，一次writev发送 */
+		while (sent < requests && sent - done < depth) {
+			i = sent % depth;
+			memcpy(payload[i], &sent, sizeof(sent));
+			frame_add(&writer, fd, payload[i], PAYLOAD_SIZE);
+			sent++;
+		}
+		if (frame_flush(&writer, fd) < 0) {
+			perror("writev");
+			exit(1);
+		}
+		ret = frame_read(&reader, fd);
+		if (ret <= 0) {
+			printf("Server closed after %llu replies\r\n",
+					(unsigned long long) done);
+			exit(1);
+		}
+		while ((ret = frame_next(&reader, &reply, &len)) > 0) {
+			memcpy(&seq, reply, sizeof(seq));
+			if (len != PAYLOAD_SIZE || seq != done) {
+				printf("Bad reply %llu, expect %llu\r\n",
+						(unsigned long long) seq, (unsigned long long) done);
+				exit(1);
+			}
+			done++;
+		}
+	}
+	start = now() - start;
+	frame_reader_free(&reader);
+	close(fd);
+	return start;
+}
+
+/* 文件传输方式 */
+enum {
+	FILE_AUTO, //普通文件用sendfile，其他来源用splice
+	FILE_SPLICE, //都经过管道splice
+	FILE_ZEROCOPY, //mmap后用MSG_ZEROCOPY发送
+	FILE_COPY //read到用户缓冲区再send，作为对照
+};
+
+static const char* file_method_name[] = { "sendfile", "splice", "zerocopy",
+		"read/send" };
+
+/* 解析传输方式参数 */
+static int file_method(const char* arg) {
+	if (arg == NULL || strcasecmp(arg, "sendfile") == 0)
+		return FILE_AUTO;
+	if (strcasecmp(arg, "splice") == 0)
+		return FILE_SPLICE;
+	if (strcasecmp(arg, "zerocopy") == 0)
+		return FILE_ZEROCOPY;
+	if (strcasecmp(arg, "copy") == 0)
+		return FILE_COPY;
+	return -1;
+}
+
+static int set_cork(int fd, int on) {
+	return setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+/* 从in_fd经过管道splice到套接字，一直传到文件结尾 */
+static int file_splice(int sock_fd, int in_fd) {
+	int pipefd[2];
+	ssize_t n, m;
+	if (pipe(pipefd) < 0)
+		return -1;
+	while (1) {
+		n = splice(in_fd, NULL, pipefd[1], NULL, FILE_CHUNK_SIZE,
+		SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (n <= 0)
+			break;
+		while (n > 0) {
+			m = splice(pipefd[0], NULL, sock_fd, NULL, n,
+			SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (m <= 0) {
+				n = -1;
+				break;
+			}
+			n -= m;
+		}
+		if (n < 0)
+			break;
+	}
+	close(pipefd[0]);
+	close(pipefd[1]);
+	return n < 0 ? -1 : 0;
+}
+
+/*
+ * 读取错误队列中MSG_ZEROCOPY的完成通知，block为1时至少等到一个通知
+ * 每个通知是一段连续的send调用编号[ee_info, ee_data]，完成后才能修改或释放发送的内存
+ */
+static int zerocopy_reap(int fd, uint32_t* done, int block, int* copied) {
+	char control[128];
+	struct msghdr msg;
+	struct cmsghdr* cm;
+	struct sock_extended_err* serr;
+	struct pollfd pfd;
+	int ret;
+	while (1) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		ret = recvmsg(fd, &msg, MSG_ERRQUEUE);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				return -1;
+			if (!block)
+				return 0;
+			/* 错误队列中有数据时poll返回POLLERR */
+			pfd.fd = fd;
+			pfd.events = 0;
+			if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+				return -1;
+			continue;
+		}
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			serr = (struct sock_extended_err*) CMSG_DATA(cm);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+				continue;
+			*done += serr->ee_data - serr->ee_info + 1;
+			/* 回环接口等情况下内核还是拷贝了数据 */
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				*copied = 1;
+		}
+		block = 0;
+	}
+}
+
+/* 把文件映射到内存，用MSG_ZEROCOPY发送，小于ZEROCOPY_MIN_SIZE的部分直接发送 */
+static int file_zerocopy(int sock_fd, int in_fd, uint64_t len) {
+	uint32_t calls = 0, done = 0;
+	uint64_t off = 0;
+	int copied = 0, flags, one = 1;
+	ssize_t n;
+	char* map;
+	if (len == 0)
+		return 0;
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED | MAP_POPULATE, in_fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	if (setsockopt(sock_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+		one = 0;
+	while (off < len) {
+		n = len - off < FILE_CHUNK_SIZE ? len - off : FILE_CHUNK_SIZE;
+		flags = one && n >= ZEROCOPY_MIN_SIZE ? MSG_ZEROCOPY : 0;
+		n = send(sock_fd, map + off, n, flags | MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/* 未完成的通知太多，等一些完成后再发送 */
+			if (errno == ENOBUFS && calls != done) {
+				set_cork(sock_fd, 0);
+				zerocopy_reap(sock_fd, &done, 1, &copied);
+				continue;
+			}
+			break;
+		}
+		off += n;
+		if (flags)
+			calls++;
+		zerocopy_reap(sock_fd, &done, 0, &copied);
+	}
+	/*
+	 * 所有数据都被内核用完才能解除映射
+	 * 先取消TCP_CORK，否则最后不满一个报文段的数据要等200ms才发送，通知也要等这么久
+	 */
+	set_cork(sock_fd, 0);
+	while (done != calls)
+		if (zerocopy_reap(sock_fd, &done, 1, &copied) < 0)
+			break;
+	munmap(map, len);
+	if (copied && verbose_file)
+		printf("MSG_ZEROCOPY fell back to copying\r\n");
+	return off == len ? 0 : -1;
+}
+
+/* 对照：每次read到BUFFER_SIZE的缓冲区再send */
+static int file_copy(int sock_fd, int in_fd) {
+	char buf[BUFFER_SIZE];
+	ssize_t n, m, off;
+	while ((n = read(in_fd, buf, sizeof(buf))) > 0) {
+		for (off = 0; off < n; off += m) {
+			m = send(sock_fd, buf + off, n - off, MSG_NOSIGNAL);
+			if (m < 0)
+				return -1;
+		}
+	}
+	return n < 0 ? -1 : 0;
+}
+
+/*
+ * 发送一个文件：8字节网络字节序的长度，然后是文件内容
+ * 不是普通文件时长度未知，填FILE_SIZE_UNKNOWN，发送完后关闭连接
+ * TCP_CORK让长度和文件开头的数据合并在一个报文段中发送
+ * 返回发送的字节数，发送长度之前出错返回-1，对端需要关闭连接时返回-2，
+ * 发送长度之后出错返回-3，也要关闭连接
+ */
+static int64_t file_serve(int sock_fd, const char* path, int method) {
+	struct stat st;
+	uint64_t len, header;
+	off_t off = 0;
+	ssize_t n;
+	int in_fd, ret = 0, regular;
+	/* 只允许当前目录下的相对路径 */
+	if (path[0] == '/' || strstr(path, "..") != NULL) {
+		errno = EACCES;
+		return -1;
+	}
+	/* 不跟随符号链接；没有写端的FIFO不阻塞在open中 */
+	in_fd = open(path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK);
+	if (in_fd < 0)
+		return -1;
+	if (fstat(in_fd, &st) < 0) {
+		close(in_fd);
+		return -1;
+	}
+	regular = S_ISREG(st.st_mode);
+	/* 目录等不能splice的文件在发送长度之前拒绝 */
+	if (!regular && !S_ISFIFO(st.st_mode) && !S_ISCHR(st.st_mode)) {
+		errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+		close(in_fd);
+		return -1;
+	}
+	/* 打开以后恢复阻塞读，FIFO等写端写入数据 */
+	fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) & ~O_NONBLOCK);
+	len = regular ? st.st_size : 0;
+	header = htobe64(regular ? len : FILE_SIZE_UNKNOWN);
+	set_cork(sock_fd, 1);
+	if (send(sock_fd, &header, sizeof(header), MSG_NOSIGNAL) < 0) {
+		close(in_fd);
+		return -3;
+	}
+	if (!regular || method == FILE_SPLICE)
+		ret = file_splice(sock_fd, in_fd);
+	else if (method == FILE_ZEROCOPY)
+		ret = file_zerocopy(sock_fd, in_fd, len);
+	else if (method == FILE_COPY)
+		ret = file_copy(sock_fd, in_fd);
+	else {
+		while (off < len) {
+			n = sendfile(sock_fd, in_fd, &off, len - off);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				ret = -1;
+				break;
+			}
+		}
+	}
+	set_cork(sock_fd, 0);
+	close(in_fd);
+	if (ret < 0)
+		return -3;
+	return regular ? (int64_t) len : -2;
+}
+
+/*
+ * 文件服务：每个请求是一帧，负载是文件路径，依次服务每个客户端
+ * 打开失败时只回复长度0，发送文件过程中出错时关闭连接
+ */
+static void server_file(int sockfd, int method, int verbose) {
+	frame_reader_t reader;
+	const char* payload;
+	char path[PATH_MAX];
+	uint64_t header = 0;
+	uint32_t len;
+	int64_t sent;
+	int client_fd, ret;
+	verbose_file = verbose;
+	while (1) {
+		client_fd = accept(sockfd, NULL, NULL);
+		if (client_fd == -1) {
+			perror("accept");
+			exit(1);
+		}
+		if (frame_reader_init(&reader) < 0) {
+			perror("malloc");
+			exit(1);
+		}
+		/* 上一个客户端的结果不能影响这个客户端 */
+		sent = 0;
+		while (frame_read(&reader, client_fd) > 0) {
+			while ((ret = frame_next(&reader, &payload, &len)) > 0) {
+				if (len >= sizeof(path))
+					len = sizeof(path) - 1;
+				memcpy(path, payload, len);
+				path[len] = '\0';
+				sent = file_serve(client_fd, path, method);
+				if (sent == -1) {
+					if (verbose)
+						printf("%s: %s\r\n", path, strerror(errno));
+					send(client_fd, &header, sizeof(header), MSG_NOSIGNAL);
+				} else if (sent == -3) {
+					if (verbose)
+						printf("%s: %s, close connection\r\n", path,
+								strerror(errno));
+				} else if (verbose) {
+					printf("Sent %s by %s\r\n", path,
+							file_method_name[method]);
+				}
+				if (sent <= -2)
+					break;
+			}
+			if (ret != 0 || sent <= -2)
+				break;
+		}
+		frame_reader_free(&reader);
+		close(client_fd);
+	}
+}
+
+/*
+ * 向服务端请求一个文件，内容写入out_fd，out_fd小于0时丢弃
+ * 返回收到的字节数，文件不存在时返回0
+ */
+static int64_t client_get(int fd, const char* path, int out_fd) {
+	static char buf[FILE_CHUNK_SIZE];
+	uint64_t len, got = 0;
+	ssize_t n;
+	if (frame_send(fd, path, strlen(path)) < 0) {
+		perror("send");
+		exit(1);
+	}
+	if (recv(fd, &len, sizeof(len), MSG_WAITALL) != sizeof(len)) {
+		printf("Server closed\r\n");
+		exit(1);
+	}
+	len = be64toh(len);
+	while (got < len) {
+		n = len - got < sizeof(buf) ? len - got : sizeof(buf);
+		n = recv(fd, buf, n, 0);
+		if (n < 0) {
+			perror("recv");
+			exit(1);
+		}
+		/* 长度未知时服务端发送完就关闭连接 */
+		if (n == 0) {
+			if (len == FILE_SIZE_UNKNOWN)
+				break;
+			printf("Server closed after %llu bytes\r\n",
+					(unsigned long long) got);
+			exit(1);
+		}
+		if (out_fd >= 0 && write(out_fd, buf, n) != n) {
+			perror("write");
+			exit(1);
+		}
+		got += n;
+	}
+	return got;
+}
+
+static int client_connect(struct sockaddr_in* addr) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		perror("socket");
+		exit(1);
+	}
+	if (connect(fd, (struct sockaddr*) addr, sizeof(*addr)) == -1) {
+		perror("connect");
+		exit(1);
+	}
+	return fd;
 }
 
 int main(int argc, char **argv) {
@@ -124,7 +662,12 @@ int main(int argc, char **argv) {
 	int cin_size, recv_bytes, send_bytes;
 	struct hostent* host;
 	char ipv4_addr[16];
-	int ret;
+	int ret, requests, depth, delay_us;
+	double elapsed;
+	pid_t pid;
+	int method, file_fd, size_mb;
+	int64_t got;
+	struct rusage usage;
 	/* 参数检查 */
 	if (argc <= 1) {
 		Usage(argv[0]);
@@ -231,6 +774,172 @@ int main(int argc, char **argv) {
 		/* 4. 关闭套接字描述符 */
 		close(client_fd);
 	}
+	/* 分帧回显服务端 */
+	else if ((strncasecmp(argv[1], "f", 1) == 0)) {
+		delay_us = argc > 2 ? atoi(argv[2]) : 0;
+		sockfd = server_listen();
+		printf("Frame server listening on %d...\r\n", PORT);
+		server_frame(sockfd, delay_us, 1);
+	}
+	/* 流水线客户端 */
+	else if ((strncasecmp(argv[1], "p", 1) == 0)) {
+		if (argc <= 2) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		requests = argc > 3 ? atoi(argv[3]) : BENCH_REQUESTS;
+		depth = argc > 4 ? atoi(argv[4]) : 1;
+		if (requests <= 0 || depth <= 0 || depth > PIPE_DEPTH_MAX) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		host = gethostbyname(argv[2]);
+		if (host == NULL) {
+			perror("gethostbyname");
+			exit(1);
+		}
+		memset(&server_sockaddr, 0, sizeof(server_sockaddr));
+		server_sockaddr.sin_family = AF_INET;
+		server_sockaddr.sin_port = htons(PORT);
+		server_sockaddr.sin_addr = *((struct in_addr*) (host->h_addr_list[0]));
+		elapsed = client_pipeline(&server_sockaddr, requests, depth);
+		printf("%d requests, depth %d: %.3f s, %.0f req/s\r\n", requests,
+				depth, elapsed, requests / elapsed);
+	}
+	/* 基准测试：服务端放在子进程中，模拟往返时间，比较不同的流水线深度 */
+	else if ((strncasecmp(argv[1], "b", 1) == 0)) {
+		requests = argc > 2 ? atoi(argv[2]) : BENCH_REQUESTS;
+		if (requests <= 0) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		sockfd = server_listen();
+		pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			server_frame(sockfd, BENCH_DELAY_US, 0);
+			exit(0);
+		}
+		close(sockfd);
+		memset(&server_sockaddr, 0, sizeof(server_sockaddr));
+		server_sockaddr.sin_family = AF_INET;
+		server_sockaddr.sin_port = htons(PORT);
+		server_sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		printf("%d requests of %d bytes, %d us delay per reply batch\r\n",
+				requests, PAYLOAD_SIZE, BENCH_DELAY_US);
+		for (depth = 1; depth <= 64; depth *= 8) {
+			elapsed = client_pipeline(&server_sockaddr, requests, depth);
+			printf("depth %2d: %.3f s, %8.0f req/s\r\n", depth, elapsed,
+					requests / elapsed);
+		}
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+	/* 文件服务端 */
+	else if ((strncasecmp(argv[1], "d", 1) == 0)) {
+		method = file_method(argc > 2 ? argv[2] : NULL);
+		if (method < 0) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		sockfd = server_listen();
+		printf("File server (%s) listening on %d...\r\n",
+				file_method_name[method], PORT);
+		server_file(sockfd, method, 1);
+	}
+	/* 下载文件 */
+	else if ((strncasecmp(argv[1], "g", 1) == 0)) {
+		if (argc <= 3) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		host = gethostbyname(argv[2]);
+		if (host == NULL) {
+			perror("gethostbyname");
+			exit(1);
+		}
+		file_fd = -1;
+		if (argc > 4) {
+			file_fd = open(argv[4], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (file_fd < 0) {
+				perror("open");
+				exit(1);
+			}
+		}
+		memset(&server_sockaddr, 0, sizeof(server_sockaddr));
+		server_sockaddr.sin_family = AF_INET;
+		server_sockaddr.sin_port = htons(PORT);
+		server_sockaddr.sin_addr = *((struct in_addr*) (host->h_addr_list[0]));
+		client_fd = client_connect(&server_sockaddr);
+		elapsed = now();
+		got = client_get(client_fd, argv[3], file_fd);
+		elapsed = now() - elapsed;
+		printf("Received %lld bytes in %.3f s, %.1f MB/s\r\n",
+				(long long) got, elapsed, got / 1e6 / elapsed);
+		close(client_fd);
+		if (file_fd >= 0)
+			close(file_fd);
+	}
+	/* 文件传输测试：在当前目录生成测试文件，每种方式由一个服务端子进程传输 */
+	else if ((strncasecmp(argv[1], "z", 1) == 0)) {
+		size_mb = argc > 2 ? atoi(argv[2]) : BENCH_FILE_MB;
+		if (size_mb <= 0) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		file_fd = open(BENCH_FILE_NAME, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file_fd < 0) {
+			perror("open");
+			exit(1);
+		}
+		memset(buf, 'x', sizeof(buf));
+		for (ret = 0; ret < size_mb * 1024; ret++) {
+			if (write(file_fd, buf, sizeof(buf)) != sizeof(buf)) {
+				perror("write");
+				exit(1);
+			}
+		}
+		close(file_fd);
+		sockfd = server_listen();
+		memset(&server_sockaddr, 0, sizeof(server_sockaddr));
+		server_sockaddr.sin_family = AF_INET;
+		server_sockaddr.sin_port = htons(PORT);
+		server_sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		printf("%d MB file, %d transfers each\r\n", size_mb,
+				BENCH_FILE_ROUNDS);
+		for (method = FILE_AUTO; method <= FILE_COPY; method++) {
+			pid = fork();
+			if (pid == -1) {
+				perror("fork");
+				exit(1);
+			}
+			if (pid == 0) {
+				server_file(sockfd, method, 0);
+				exit(0);
+			}
+			client_fd = client_connect(&server_sockaddr);
+			got = 0;
+			elapsed = now();
+			for (ret = 0; ret < BENCH_FILE_ROUNDS; ret++)
+				got += client_get(client_fd, BENCH_FILE_NAME, -1);
+			elapsed = now() - elapsed;
+			close(client_fd);
+			kill(pid, SIGKILL);
+			wait4(pid, NULL, 0, &usage);
+			printf("%-10s %8.1f MB/s, server cpu %.3f s (user %.3f sys %.3f)"
+					"\r\n", file_method_name[method], got / 1e6 / elapsed,
+					usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+							+ usage.ru_stime.tv_sec
+							+ usage.ru_stime.tv_usec / 1e6,
+					usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+					usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6);
+		}
+		close(sockfd);
+		unlink(BENCH_FILE_NAME);
+	}
 	return 0;
 }
 
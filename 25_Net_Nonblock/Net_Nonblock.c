@@ -5,6 +5,7 @@
  *      Author: morris
  *  要求：
  *  	网络编程之---阻塞式IO
+ *  	用非阻塞套接字和poll同时处理多个客户端
  *	********************************************************************
  *	1. 缺省模式下，套接字建立后所处于的模式就是阻塞I/O模式
  *	2. 常见的会阻塞的函数有：
@@ -13,111 +14,380 @@
  *		c. 其他操作：accept,connect
  *	3. UDP不用等待确认，没有实际的发送缓冲区，所以UDP协议中不存在发送缓冲区满的情况，在
  *	UDP套接字上执行的写操作永远都不会阻塞
+ *	4. 非阻塞套接字上没有数据时立即返回EAGAIN，如果用sleep轮询，连接最多要等一个轮询周期
+ *	才被处理，等待时间越短浪费的CPU越多
+ *	5. 用poll等待套接字就绪，有连接或数据时立即返回，没有事件时不占用CPU；
+ *	poll的超时时间等于最近一个空闲连接的到期时间，不需要定时醒来检查
+ *	6. 对延迟要求高的场合可以在处理完事件后继续用0超时的poll忙等一小段时间，
+ *	SO_BUSY_POLL让内核在recv和poll时也忙等网卡队列，省去中断和唤醒的延迟，代价是CPU占用
  *	********************************************************************
  */
 
+#define _GNU_SOURCE	//accept4
 #include <arpa/inet.h>
 #include <asm-generic/errno-base.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #define PORT				5001
-#define MAX_QUE_CONN_NUM	5
+#define MAX_QUE_CONN_NUM	128
 #define BUFFER_SIZE			1024
+#define MAX_CLIENT_NUM		1024	//同时处理的最大客户端数量
+#define IDLE_TIMEOUT		60		//客户端空闲超过这个时间(秒)就关闭
+#define BENCH_CONNS			200		//性能测试的连接数量
+#define BENCH_INTERVAL		5000	//性能测试两次连接的间隔(us)
+#define BENCH_BUSY_POLL		50		//性能测试忙等时间(us)
+#define BENCH_MSG			"ping "	//性能测试消息，后面是客户端连接时的时间
+
+/* 性能测试结果，放在共享内存中由父进程读取 */
+typedef struct {
+	volatile int count; //收到的测试消息数量
+	float lat[BENCH_CONNS]; //从客户端开始连接到服务器读到消息的时间(us)
+} bench_t;
+
+/* 客户端信息，与pollfd数组一一对应 */
+typedef struct {
+	struct in_addr addr; //客户端地址
+	double active; //最后一次收到数据的时间(us)
+} client_t;
+
+static bench_t* bench; //性能测试时不为NULL
+static int verbose = 1; //为0时不打印每条消息，性能测试时服务端使用
 
 void Usage(char* arg) {
-	printf("Usage:%s s/S\r\nUsage:%s c/C target_addr\r\n", arg, arg);
+	printf("Usage:%s s/S [busy_poll_us]\r\nUsage:%s c/C target_addr\r\n"
+			"Usage:%s b/B\r\n", arg, arg, arg);
 }
 
-int main(int argc, char **argv) {
-	int sockfd, client_fd;
-	struct sockaddr_in server_addr, client_addr;
+/* 当前时间，单位微秒 */
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* 处理客户端的一条消息，收到quit返回1 */
+static int server_message(struct in_addr addr, char* buf) {
+	if (verbose)
+		printf("Receive a message from %s:%s\r\n", inet_ntoa(addr), buf);
+	/* 性能测试消息带有客户端开始连接的时间 */
+	if (bench && strncmp(buf, BENCH_MSG, strlen(BENCH_MSG)) == 0
+			&& bench->count < BENCH_CONNS) {
+		bench->lat[bench->count] = now_us()
+				- strtod(buf + strlen(BENCH_MSG), NULL);
+		bench->count++;
+	}
+	return strncmp(buf, "quit", 4) == 0;
+}
+
+/* 原来的方式：非阻塞accept，没有连接时sleep(1)再试，作为性能测试的对比 */
+static void server_sleep(int sockfd) {
+	struct sockaddr_in client_addr;
 	socklen_t cin_size;
 	char buf[BUFFER_SIZE];
-	int real_read, real_write;
-	int flags;
-	int ret;
-	/* 参数检测 */
-	if (argc <= 1) {
-		Usage(argv[0]);
-		exit(1);
-	}
-	/* 服务端 */
-	if (strncasecmp(argv[1], "s", 1) == 0) {
-		/* 创建流式套接字 */
-		sockfd = socket(AF_INET, SOCK_STREAM, 0);
-		if (sockfd < 0) {
-			perror("socket");
+	int client_fd;
+	int real_read;
+	while (1) {
+		cin_size = sizeof(client_addr);
+		client_fd = accept(sockfd, (struct sockaddr*) &client_addr, &cin_size);
+		if (client_fd < 0) {
+			if (errno == EAGAIN) {
+				sleep(1);
+				continue;
+			}
+			perror("accept");
 			exit(1);
 		}
-		/* 套接字绑定地址信息 */
-		memset(&server_addr, 0, sizeof(server_addr));
-		server_addr.sin_family = AF_INET;
-		server_addr.sin_port = htons(PORT);
-		server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-		ret = bind(sockfd, (struct sockaddr*) &server_addr,
-				sizeof(server_addr));
-		if (ret < 0) {
-			perror("bind");
-			exit(1);
+		/* 接收的套接字是阻塞的，读到客户端关闭为止 */
+		while ((real_read = recv(client_fd, buf, BUFFER_SIZE - 1, 0)) > 0) {
+			buf[real_read] = '\0';
+			server_message(client_addr.sin_addr, buf);
 		}
-		/* 设定监听队列最大长度 */
-		ret = listen(sockfd, MAX_QUE_CONN_NUM);
-		if (ret < 0) {
-			perror("listen");
-			exit(1);
+		close(client_fd);
+	}
+}
+
+/*
+ * 用poll同时处理多个客户端，所有套接字都是非阻塞的
+ * busy_us大于0时设置SO_BUSY_POLL，并且每次有事件后用0超时的poll忙等busy_us微秒
+ */
+static void server_poll(int sockfd, int busy_us) {
+	struct pollfd fds[MAX_CLIENT_NUM + 1];
+	client_t clients[MAX_CLIENT_NUM + 1];
+	struct sockaddr_in client_addr;
+	socklen_t cin_size;
+	char buf[BUFFER_SIZE];
+	double now, deadline, busy_until = 0;
+	int nfds = 1;
+	int timeout;
+	int client_fd;
+	int real_read;
+	int quit = 0;
+	int i, ret;
+
+	/* 监听套接字放在第0个位置 */
+	fds[0].fd = sockfd;
+	fds[0].events = POLLIN;
+	if (busy_us > 0
+			&& setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_us,
+					sizeof(busy_us)) < 0)
+		perror("setsockopt(SO_BUSY_POLL)");
+	while (!quit) {
+		/* 自适应超时：等到最早的空闲连接到期，没有客户端时一直等待 */
+		now = now_us();
+		deadline = 0;
+		for (i = 1; i < nfds; i++) {
+			if (deadline == 0 || clients[i].active < deadline)
+				deadline = clients[i].active;
 		}
-		/* 设定套接字非阻塞属性*/
-		flags = fcntl(sockfd, F_GETFL);
-		if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
-			perror("fcntl");
+		if (deadline == 0)
+			timeout = -1;
+		else if ((deadline += IDLE_TIMEOUT * 1e6) <= now)
+			timeout = 0;
+		else
+			timeout = (deadline - now) / 1000 + 1;
+		/* 忙等期间不睡眠 */
+		if (now < busy_until)
+			timeout = 0;
+		ret = poll(fds, nfds, timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
 			exit(1);
 		}
-		/* 非阻塞方式等待客户端的连接 */
-		cin_size = sizeof(client_addr);
-		while (1) {
-			client_fd = accept(sockfd, (struct sockaddr*) &client_addr,
-					&cin_size);
-			if (client_fd < 0) {
-				if (errno == EAGAIN) {
-					printf("Resource temporarily unavailable\r\n");
-					sleep(1);
-				} else {
-					perror("accept");
-					exit(1);
+		now = now_us();
+		if (ret > 0 && busy_us > 0)
+			busy_until = now + busy_us;
+		/* 接收所有等待中的连接 */
+		if (fds[0].revents & POLLIN) {
+			while (1) {
+				cin_size = sizeof(client_addr);
+				client_fd = accept4(sockfd, (struct sockaddr*) &client_addr,
+						&cin_size, SOCK_NONBLOCK);
+				if (client_fd < 0) {
+					if (errno == EINTR || errno == ECONNABORTED)
+						continue;
+					if (errno != EAGAIN)
+						perror("accept");
+					break;
 				}
-			} else {
-				break;
+				if (nfds == MAX_CLIENT_NUM + 1) {
+					printf("Too many clients, reject %s\r\n",
+							inet_ntoa(client_addr.sin_addr));
+					close(client_fd);
+					continue;
+				}
+				if (busy_us > 0)
+					setsockopt(client_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_us,
+							sizeof(busy_us));
+				fds[nfds].fd = client_fd;
+				fds[nfds].events = POLLIN;
+				fds[nfds].revents = 0;
+				clients[nfds].addr = client_addr.sin_addr;
+				clients[nfds].active = now;
+				nfds++;
+				if (verbose)
+					printf("Find a client(%s)\r\n",
+							inet_ntoa(client_addr.sin_addr));
 			}
 		}
-		printf("Find a client(%s)\r\n", inet_ntoa(client_addr.sin_addr));
-		/* 循环读取客户端传来的数据 */
-		while (1) {
-			/* 接收客户端发送的数据 */
-			memset(buf, 0, BUFFER_SIZE);
-			real_read = recv(client_fd, buf, BUFFER_SIZE, 0);
-			if (real_read < 0) {
-				perror("recv");
-				exit(1);
-			} else if (real_read == 0) {
-				printf("Peer has exit\r\n");
-				break;
-			} else {
-				printf("Receive a message from %s:%s\r\n",
-						inet_ntoa(client_addr.sin_addr), buf);
-				if (strncmp(buf, "quit", 4) == 0) {
-					break;
+		/* 读取就绪的客户端，关闭退出和空闲太久的客户端 */
+		for (i = 1; i < nfds && !quit; i++) {
+			real_read = 1;
+			if (fds[i].revents) {
+				clients[i].active = now;
+				while ((real_read = recv(fds[i].fd, buf, BUFFER_SIZE - 1, 0))
+						> 0) {
+					buf[real_read] = '\0';
+					if (server_message(clients[i].addr, buf)) {
+						quit = 1;
+						break;
+					}
+				}
+				if (real_read < 0 && errno != EAGAIN) {
+					perror("recv");
+				} else if (real_read == 0 && verbose) {
+					printf("Peer %s has exit\r\n",
+							inet_ntoa(clients[i].addr));
 				}
+			} else if (now - clients[i].active >= IDLE_TIMEOUT * 1e6) {
+				printf("Client %s is idle, close it\r\n",
+						inet_ntoa(clients[i].addr));
+				real_read = 0;
+			}
+			if (real_read == 0 || (real_read < 0 && errno != EAGAIN)) {
+				/* 用最后一个客户端填补空位，再检查一次这个位置 */
+				close(fds[i].fd);
+				nfds--;
+				fds[i] = fds[nfds];
+				clients[i] = clients[nfds];
+				i--;
 			}
 		}
-		close(sockfd);
+	}
+	for (i = 1; i < nfds; i++)
+		close(fds[i].fd);
+}
+
+/* 创建非阻塞的监听套接字 */
+static int server_listen(void) {
+	struct sockaddr_in server_addr;
+	int sockfd;
+	int flags;
+	int ret;
+	/* 创建流式套接字 */
+	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sockfd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	/* 允许重复使用本地地址与套接字进行绑定 */
+	int b_reuse = 1;
+	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &b_reuse, sizeof(b_reuse));
+	/* 套接字绑定地址信息 */
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(PORT);
+	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	ret = bind(sockfd, (struct sockaddr*) &server_addr, sizeof(server_addr));
+	if (ret < 0) {
+		perror("bind");
+		exit(1);
+	}
+	/* 设定监听队列最大长度 */
+	ret = listen(sockfd, MAX_QUE_CONN_NUM);
+	if (ret < 0) {
+		perror("listen");
+		exit(1);
+	}
+	/* 设定套接字非阻塞属性*/
+	flags = fcntl(sockfd, F_GETFL);
+	if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		perror("fcntl");
+		exit(1);
+	}
+	return sockfd;
+}
+
+static int cmp_float(const void* a, const void* b) {
+	float x = *(const float*) a, y = *(const float*) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * 性能测试：在子进程中运行服务器，每隔BENCH_INTERVAL建立一个连接发送一条消息，
+ * 统计从开始连接到服务器读到消息的延迟和服务器进程的CPU时间
+ * busy_us小于0时使用原来的sleep轮询方式
+ */
+static void bench_server(const char* name, int busy_us) {
+	struct sockaddr_in server_addr;
+	struct rusage ru;
+	char buf[BUFFER_SIZE];
+	double t0, elapsed, cpu, avg;
+	int sockfd, client_fd;
+	int i, n;
+	pid_t pid;
+
+	sockfd = server_listen();
+	memset((void*) bench, 0, sizeof(bench_t));
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		verbose = 0;
+		if (busy_us < 0)
+			server_sleep(sockfd);
+		else
+			server_poll(sockfd, busy_us);
+		exit(0);
+	}
+	close(sockfd);
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(PORT);
+	server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	t0 = now_us();
+	for (i = 0; i < BENCH_CONNS; i++) {
+		n = sprintf(buf, "%s%.0f", BENCH_MSG, now_us());
+		client_fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (client_fd < 0
+				|| connect(client_fd, (struct sockaddr*) &server_addr,
+						sizeof(server_addr)) < 0) {
+			perror("connect");
+			exit(1);
+		}
+		send(client_fd, buf, n, 0);
 		close(client_fd);
+		usleep(BENCH_INTERVAL);
+	}
+	/* 等待服务器处理完最后的连接，sleep轮询方式最多要等1秒多 */
+	while (bench->count < BENCH_CONNS && now_us() - t0 < 60e6)
+		usleep(10000);
+	elapsed = now_us() - t0;
+	kill(pid, SIGKILL);
+	wait4(pid, NULL, 0, &ru);
+	cpu = ru.ru_utime.tv_sec * 1e6 + ru.ru_utime.tv_usec
+			+ ru.ru_stime.tv_sec * 1e6 + ru.ru_stime.tv_usec;
+
+	n = bench->count;
+	qsort(bench->lat, n, sizeof(float), cmp_float);
+	for (i = 0, avg = 0; i < n; i++)
+		avg += bench->lat[i];
+	if (n > 0) {
+		printf("%-14s %4d conns  latency avg %9.1f us  p50 %9.1f us  "
+				"p99 %9.1f us  cpu %7.1f ms (%4.1f%%)\r\n", name, n, avg / n,
+				bench->lat[n / 2], bench->lat[(int) (n * 0.99)], cpu / 1e3,
+				cpu * 100 / elapsed);
+	} else {
+		printf("%-14s no message\r\n", name);
+	}
+}
+
+int main(int argc, char **argv) {
+	int sockfd, client_fd;
+	struct sockaddr_in server_addr;
+	char buf[BUFFER_SIZE];
+	int real_write;
+	int ret;
+	/* 参数检测 */
+	if (argc <= 1) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	/* 服务端 */
+	if (strncasecmp(argv[1], "s", 1) == 0) {
+		sockfd = server_listen();
+		printf("Listening...\r\n");
+		server_poll(sockfd, argc > 2 ? atoi(argv[2]) : 0);
+		close(sockfd);
+	}
+	/* 性能测试，比较sleep轮询、poll和poll加忙等 */
+	else if (strncasecmp(argv[1], "b", 1) == 0) {
+		bench = mmap(NULL, sizeof(bench_t), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (bench == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+		bench_server("sleep(1) loop", -1);
+		bench_server("poll", 0);
+		bench_server("poll+busy", BENCH_BUSY_POLL);
 	}
 	/* 客户端 */
 	else if (strncasecmp(argv[1], "c", 1) == 0) {
@@ -13,68 +13,152 @@
  *	命令，使套接字归属当前进程，这样内核能够判断应该向哪个进程发送信号。
  *	3. 接下来，使用fcntl函数的F_SETFL命令将套接字的状态标志位设置为异步通知方式（使用
  *	O_ASYNC参数）
+ *	4. SIGIO是普通信号，处理之前再来的SIGIO会被合并，一次信号可能对应多个连接和数据，
+ *	信号处理函数中也不能调用accept、printf、exit等非异步信号安全的函数
+ *	5. 用F_SETSIG把通知信号改为实时信号，实时信号会排队，并且信号中带有就绪的描述符(si_fd)；
+ *	把信号屏蔽后用signalfd读取，信号就变成了普通的事件，在主循环中处理，不需要信号处理函数
+ *	6. 实时信号队列满时内核改发SIGIO，这时不知道哪些描述符就绪，要检查所有的描述符
+ *	7. 描述符设置为非阻塞，每次通知都一直读到EAGAIN，在通知到来之前的数据也不会丢失
  *	********************************************************************
  */
 
+#define _GNU_SOURCE	//F_SETSIG
 #include <arpa/inet.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #define PORT			5002
 #define BUFFER_SIZE		1024
-#define MAX_CONN_NUM	5
+#define MAX_CONN_NUM	1024	//监听队列长度，突发的连接在这里等待
+#define MAX_CLIENT_FD	65536	//最大的客户端描述符
+#define MAX_SIGINFO		64		//一次从signalfd读取的信号数量
+#define BURST_CONNS		1000	//突发测试默认的连接数量
 
-struct sockaddr_in client_addr;
-socklen_t addr_len;
 int server_fd, client_fd;
 char buf[BUFFER_SIZE];
-int real_read;
+static char client_open[MAX_CLIENT_FD]; //客户端描述符是否打开
+static long conn_count, msg_count; //接收的连接和消息数量
 
 /* 程序使用介绍 */
 void Usage(char* arg) {
-	printf("Usage:%s s/S\r\nUsage:%s c/C target_addr\r\n", arg, arg);
+	printf("Usage:%s s/S\r\nUsage:%s c/C target_addr\r\n"
+			"Usage:%s b/B target_addr [conns]\r\n", arg, arg, arg);
 }
 
-/* 异步信号处理函数，处理新的套接字的连接和数据 */
-void accept_async(int sig_num) {
-	printf("get SIGIO\r\n");
-	/* 接收客户端的连接请求 */
-	addr_len = sizeof(client_addr);
-	client_fd = accept(server_fd, (struct sockaddr*) &client_addr, &addr_len);
-	if (client_fd < 0) {
-		perror("accept");
-		exit(1);
+/* 设置套接字为异步非阻塞工作方式，就绪时向当前进程发送带有描述符的实时信号 */
+static int set_async(int fd) {
+	int flags;
+	/* 绑定套接字与当前进程 */
+	if (fcntl(fd, F_SETOWN, getpid()) < 0) {
+		perror("fcntl(F_SETOWN)");
+		return -1;
 	}
-	printf("Accept a client(%s)\r\n", inet_ntoa(client_addr.sin_addr));
-	/* 接收客户端的输入数据 */
-	memset(buf, 0, BUFFER_SIZE);
-	real_read = recv(client_fd, buf, BUFFER_SIZE, 0);
-	if (real_read < 0) {
-		perror("recv");
-		exit(1);
-	} else if (real_read == 0) {
-		printf("Peer exited\r\n");
-		exit(1);
-	} else {
-		printf("Receive s message from %s:%s", inet_ntoa(client_addr.sin_addr),
-				buf);
-		if (strncmp(buf, "quit", 4) == 0) {
-			exit(0);
+	/* 用实时信号代替SIGIO */
+	if (fcntl(fd, F_SETSIG, SIGRTMIN) < 0) {
+		perror("fcntl(F_SETSIG)");
+		return -1;
+	}
+	/* 获得套接字的状态标志位 */
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0) {
+		perror("fcntl(F_GETFL)");
+		return -1;
+	}
+	/* 设置成异步非阻塞访问模式 */
+	if (fcntl(fd, F_SETFL, flags | O_ASYNC | O_NONBLOCK) < 0) {
+		perror("fcntl(F_SETFL)");
+		return -1;
+	}
+	return 0;
+}
+
+/* 读取客户端的所有数据，客户端退出时关闭，收到quit返回1 */
+static int client_drain(int fd) {
+	int real_read;
+	while (1) {
+		real_read = recv(fd, buf, BUFFER_SIZE - 1, 0);
+		if (real_read < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			perror("recv");
+		} else if (real_read == 0) {
+			printf("Client %d(socket) exited\r\n", fd);
+		} else {
+			buf[real_read] = '\0';
+			msg_count++;
+			printf("Receive a message from %d(socket):%s", fd, buf);
+			if (strncmp(buf, "quit", 4) == 0)
+				return 1;
+			continue;
 		}
+		client_open[fd] = 0;
+		close(fd);
+		return 0;
 	}
-	close(client_fd);
+}
+
+/* 接收所有等待中的连接，收到quit返回1 */
+static int accept_drain(void) {
+	struct sockaddr_in client_addr;
+	socklen_t addr_len;
+	while (1) {
+		/* 接收客户端的连接请求 */
+		addr_len = sizeof(client_addr);
+		client_fd = accept(server_fd, (struct sockaddr*) &client_addr,
+				&addr_len);
+		if (client_fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept");
+			return 0;
+		}
+		if (client_fd >= MAX_CLIENT_FD || set_async(client_fd) < 0) {
+			close(client_fd);
+			continue;
+		}
+		client_open[client_fd] = 1;
+		conn_count++;
+		printf("Accept a client(%s) %d(socket)\r\n",
+				inet_ntoa(client_addr.sin_addr), client_fd);
+		/* 设置异步方式之前到达的数据不会产生信号，先读一次 */
+		if (client_drain(client_fd))
+			return 1;
+	}
+}
+
+/* 信号队列溢出时检查所有描述符，收到quit返回1 */
+static int drain_all(void) {
+	int fd;
+	if (accept_drain())
+		return 1;
+	for (fd = 0; fd < MAX_CLIENT_FD; fd++) {
+		if (client_open[fd] && client_drain(fd))
+			return 1;
+	}
+	return 0;
 }
 
 int main(int argc, char **argv) {
 	struct sockaddr_in server_addr;
+	struct signalfd_siginfo info[MAX_SIGINFO];
+	struct pollfd pfd;
+	sigset_t mask;
 	int real_write;
-	int flags;
+	int sig_fd;
+	int quit = 0;
+	int i, n;
 	int ret;
 	/* 参数检查 */
 	if (argc <= 1) {
@@ -89,6 +173,10 @@ int main(int argc, char **argv) {
 			perror("socket");
 			exit(1);
 		}
+		/* 允许重复使用本地地址与套接字进行绑定 */
+		int b_reuse = 1;
+		setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &b_reuse,
+				sizeof(b_reuse));
 		/* 套接字绑定地址信息 */
 		memset(&server_addr, 0, sizeof(server_addr));
 		server_addr.sin_family = AF_INET;
@@ -106,37 +194,99 @@ int main(int argc, char **argv) {
 			perror("listen");
 			exit(1);
 		}
+		/* 屏蔽通知信号，信号不再打断程序，而是留在队列中由signalfd读取 */
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGRTMIN);
+		sigaddset(&mask, SIGIO);
+		sigprocmask(SIG_BLOCK, &mask, NULL);
+		sig_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+		if (sig_fd < 0) {
+			perror("signalfd");
+			exit(1);
+		}
 		/* 将套接字设置为异步工作方式 */
-		/* 绑定套接字与当前进程 */
-		ret = fcntl(server_fd, F_SETOWN, getpid());
-		if (ret < 0) {
-			perror("fcntl(F_SETOWN)");
+		if (set_async(server_fd) < 0)
 			exit(1);
+		quit = accept_drain();
+		/* 处理别的任务，同时等待信号 */
+		pfd.fd = sig_fd;
+		pfd.events = POLLIN;
+		while (!quit) {
+			ret = poll(&pfd, 1, 1000);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				perror("poll");
+				exit(1);
+			} else if (ret == 0) {
+				printf("Server is working... %ld connections, %ld messages\r\n",
+						conn_count, msg_count);
+				continue;
+			}
+			/* 一次读取多个排队的信号 */
+			ret = read(sig_fd, info, sizeof(info));
+			if (ret < 0) {
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				perror("read");
+				exit(1);
+			}
+			n = ret / sizeof(struct signalfd_siginfo);
+			for (i = 0; i < n && !quit; i++) {
+				if (info[i].ssi_signo == SIGIO) {
+					/* 实时信号队列满了，有通知丢失 */
+					printf("Signal queue overflow\r\n");
+					quit = drain_all();
+				} else if (info[i].ssi_fd == server_fd) {
+					quit = accept_drain();
+				} else if (info[i].ssi_fd < MAX_CLIENT_FD
+						&& client_open[info[i].ssi_fd]) {
+					/* 描述符关闭后可能还有排队的信号，已关闭的不处理 */
+					quit = client_drain(info[i].ssi_fd);
+				}
+			}
 		}
-		/* 获得套接字的状态标志位 */
-		flags = fcntl(server_fd, F_GETFL);
-		if (flags < 0) {
-			perror("fcntl(F_GETFL)");
+		printf("%ld connections, %ld messages\r\n", conn_count, msg_count);
+		close(sig_fd);
+		close(server_fd);
+	}
+	/* 突发测试：同时建立多个连接，每个连接发送一条消息 */
+	else if (strncasecmp(argv[1], "b", 1) == 0) {
+		int conns = argc > 3 ? atoi(argv[3]) : BURST_CONNS;
+		int* fds;
+		if (argc <= 2 || conns <= 0) {
+			Usage(argv[0]);
 			exit(1);
 		}
-		/* 设置成异步访问模式 */
-		ret = fcntl(server_fd, F_SETFL, flags | O_ASYNC);
-		if (ret < 0) {
-			perror("fcntl(F_SETFL)");
+		memset(&server_addr, 0, sizeof(server_addr));
+		server_addr.sin_family = AF_INET;
+		server_addr.sin_port = htons(PORT);
+		ret = inet_aton(argv[2], &server_addr.sin_addr);
+		if (ret == 0) {
+			perror("inet_aton");
 			exit(1);
 		}
-		/* 注册SIGIO信号处理函数 */
-		signal(SIGIO, accept_async);
-		/* 处理别的任务 */
-		while (1) {
-			sleep(1);
-			printf("Server is working...\r\n");
-			/* 接收到quit字符串就退出 */
-			if (strncmp(buf, "quit", 4) == 0) {
-				break;
+		fds = malloc(conns * sizeof(int));
+		for (i = 0; i < conns; i++) {
+			fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+			if (fds[i] < 0
+					|| connect(fds[i], (struct sockaddr*) &server_addr,
+							sizeof(server_addr)) < 0) {
+				perror("connect");
+				exit(1);
 			}
 		}
-		close(server_fd);
+		for (i = 0; i < conns; i++) {
+			n = sprintf(buf, "hello %d\n", i);
+			if (send(fds[i], buf, n, 0) < 0) {
+				perror("send");
+				exit(1);
+			}
+		}
+		for (i = 0; i < conns; i++)
+			close(fds[i]);
+		free(fds);
+		printf("%d connections sent\r\n", conns);
 	}
 	/* 客户端 */
 	else if (strncasecmp(argv[1], "c", 1) == 0) {
@@ -6,139 +6,894 @@
  * 	要求：
  *  	网络编程之---IO多路复用(Select)
  *  	使用select多路复用实现单进程单线程并发服务器
+ *  	并用epoll实现同样的服务器，比较两者在大量连接时的性能
  *	********************************************************************
  *	1. 应用程序中同时处理多路输入流，若采用阻塞模式，将得不到预期的目的
  *	2. 若采用非阻塞模式，对多个输入进行轮询，太浪费CPU时间
  *	3. 若设置多个进程，分别处理一条数据通路，将产生进程间的同步与通信问题，复杂
  *	4. 比较好的方法是使用I/O多路复用
+ *	5. select每次调用都要把描述符集合拷入内核，返回后还要遍历所有描述符，
+ *	   开销与描述符数量成正比，而且描述符不能超过FD_SETSIZE(1024)
+ *	6. epoll在内核中保存关注的描述符，epoll_wait只返回就绪的描述符，开销与就绪数量成正比
+ *		a. 水平触发(LT)：只要描述符可读/可写，每次epoll_wait都会返回它
+ *		b. 边沿触发(ET)：只在状态变化时返回一次，必须一直读/写到EAGAIN为止
+ *	7. 所有套接字都是非阻塞的，send可能只发送一部分，剩下的数据保存在连接的
+ *	   发送缓冲区中，等套接字可写时再继续发送
+ *	8. 背压：客户端只发不收时，发送缓冲区会无限增长。超过高水位时暂停读取这个连接，
+ *	   可写事件把数据发到低水位以下再恢复读取。暂停期间内核接收缓冲区填满，
+ *	   TCP窗口关闭，客户端自己就发不出去了，其他连接不受影响
  *	********************************************************************
  */
 
+#define _GNU_SOURCE	//accept4、pthread_setaffinity_np
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #define PORT				5003	//端口号
-#define MAX_QUE_CONN_NUM	5		//最大同时支持连接服务器的数量
+#define MAX_QUE_CONN_NUM	4096	//监听队列长度
 #define BUFFER_SIZE			1024	//数据缓冲区大小
 #define TIME_OUT			10		//select超时时间
 #define MAX_SOCK_FD			FD_SETSIZE	//fd_set中最大元素数量
+#define MAX_REACTORS		64		//多线程模式最大线程数
+#define MAX_EVENTS			256		//epoll_wait一次返回的最大事件数
 #define SERVER_IDENT		"\t(From Server)"
+#define BENCH_MSG			"ping"	//性能测试客户端发送的消息
+#define BENCH_SECONDS		3		//性能测试每项持续时间
+#define BENCH_SAMPLES		4000000	//性能测试最多记录的延迟数量
+#define OUT_HIGH_WATER		(64 * 1024)	//发送缓冲区超过高水位时暂停读取
+#define OUT_LOW_WATER		(16 * 1024)	//发送缓冲区低于低水位时恢复读取
+#define HOG_CHUNK			(64 * 1024)	//慢消费者每次发送的数据量
+#define HOG_MAX_BYTES		(256 << 20)	//慢消费者最多发送的数据量，避免不限制时耗尽内存
 #define MAX(a,b)			((a>b)?(a):(b))
 
+/* 服务器工作模式 */
+#define MODE_SELECT			0
+#define MODE_EPOLL_LT		1
+#define MODE_EPOLL_ET		2
+
+/* 一个事件循环的状态，多线程模式下每个线程各有一个，线程之间不共享 */
+typedef struct {
+	int mode; //工作模式
+	int server_fd; //监听套接字
+	int epfd; //epoll实例
+	fd_set inset, outset; //select模式关注的读写描述符集合
+	int maxfd; //select模式最大的描述符
+	int idle_fd; //预留的描述符，描述符用完时用来拒绝连接
+	int cpu; //线程绑定的CPU，-1表示不绑定
+	pthread_t thread; //事件循环线程
+} reactor_t;
+
+/* 每个客户端连接的状态 */
+typedef struct {
+	reactor_t* r; //连接所属的事件循环
+	int fd; //客户端套接字
+	char* out; //发送缓冲区，保存还没有发送出去的数据
+	int out_off; //发送缓冲区中下一个要发送的位置
+	int out_len; //发送缓冲区中数据的结尾
+	int out_cap; //发送缓冲区大小
+	int writing; //正在等待套接字可写
+	int paused; //发送缓冲区超过高水位，暂停读取
+	int eof; //客户端已经关闭写，回复发送完后关闭连接
+} conn_t;
+
+static conn_t* conns[MAX_SOCK_FD]; //select模式用描述符查找连接，epoll模式保存在事件中
+static int verbose = 1; //为0时不打印每条消息，性能测试时服务端使用
+static int backpressure = 1; //为0时不限制发送缓冲区，性能测试时用来对照
+
 /* 程序使用说明 */
 void Usage(char* arg) {
-	printf("Usage:%s s/S\r\nUsage:%s c/C target_addr\r\n", arg, arg);
+	printf("Usage:%s s/S\r\n"
+			"Usage:%s e/E [lt]\r\n"
+			"Usage:%s m/M [threads]\r\n"
+			"Usage:%s c/C target_addr\r\n"
+			"Usage:%s l/L target_addr [conns] [threads]\r\n"
+			"Usage:%s b/B\r\n", arg, arg, arg, arg, arg, arg);
+	printf("Usage:%s w/W\r\n", arg);
+}
+
+/* 按连接的状态修改关注的事件：暂停时不关注可读，有数据没发完时关注可写 */
+static void conn_events(conn_t* c) {
+	reactor_t* r = c->r;
+	struct epoll_event ev;
+	if (r->mode == MODE_SELECT) {
+		if (c->paused)
+			FD_CLR(c->fd, &r->inset);
+		else
+			FD_SET(c->fd, &r->inset);
+		if (c->writing)
+			FD_SET(c->fd, &r->outset);
+		else
+			FD_CLR(c->fd, &r->outset);
+	} else if (r->mode == MODE_EPOLL_LT) {
+		/* 水平触发时一直关注可写会不停返回，只在有数据没发完时关注 */
+		ev.events = (c->paused ? 0 : EPOLLIN) | (c->writing ? EPOLLOUT : 0);
+		ev.data.ptr = c;
+		epoll_ctl(r->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	}
+	/*
+	 * 边沿触发注册时已经关注可读可写，只在状态变化时返回一次，不需要修改；
+	 * 暂停时不读，恢复时要主动读一次，已经到达的数据不会再通知
+	 */
+}
+
+/* 设置连接是否关注可写事件 */
+static void conn_watch(conn_t* c, int writing) {
+	if (c->writing == writing)
+		return;
+	c->writing = writing;
+	conn_events(c);
+}
+
+/* 暂停或恢复读取连接的数据 */
+static void conn_pause(conn_t* c, int paused) {
+	if (c->paused == paused)
+		return;
+	c->paused = paused;
+	conn_events(c);
+}
+
+static int conn_read(conn_t* c);
+
+/* 新的客户端连接 */
+static int conn_open(reactor_t* r, int fd) {
+	struct epoll_event ev;
+	conn_t* c;
+	if (r->mode == MODE_SELECT && fd >= MAX_SOCK_FD) {
+		printf("Too many connections, reject %d(socket)\r\n", fd);
+		close(fd);
+		return -1;
+	}
+	c = calloc(1, sizeof(conn_t));
+	c->r = r;
+	c->fd = fd;
+	if (r->mode == MODE_SELECT) {
+		conns[fd] = c;
+		FD_SET(fd, &r->inset);
+		r->maxfd = MAX(r->maxfd, fd);
+	} else {
+		ev.events = r->mode == MODE_EPOLL_ET ?
+		EPOLLIN | EPOLLOUT | EPOLLET :
+												EPOLLIN;
+		ev.data.ptr = c;
+		epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev);
+	}
+	if (verbose)
+		printf("New connection from %d(socket)\r\n", fd);
+	return 0;
+}
+
+/* 关闭连接并释放状态，关闭描述符时内核自动把它从epoll中删除 */
+static void conn_close(conn_t* c) {
+	reactor_t* r = c->r;
+	if (r->mode == MODE_SELECT) {
+		conns[c->fd] = NULL;
+		FD_CLR(c->fd, &r->inset);
+		FD_CLR(c->fd, &r->outset);
+		/* 暂停读取的连接只在可写集合中 */
+		while (r->maxfd > 0 && !FD_ISSET(r->maxfd, &r->inset)
+				&& !FD_ISSET(r->maxfd, &r->outset))
+			r->maxfd--;
+	}
+	close(c->fd);
+	free(c->out);
+	free(c);
+}
+
+/*
+ * 发送缓冲区中的数据，直到发完或套接字不可写，出错或连接关闭返回-1
+ * 暂停读取的连接降到低水位以下时恢复读取
+ */
+static int conn_flush(conn_t* c) {
+	int real_write;
+	while (c->out_off < c->out_len) {
+		real_write = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+				MSG_NOSIGNAL);
+		if (real_write < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			if (errno != ECONNRESET && errno != EPIPE)
+				perror("send");
+			return -1;
+		}
+		c->out_off += real_write;
+	}
+	if (c->out_off == c->out_len) {
+		c->out_off = c->out_len = 0;
+		conn_watch(c, 0);
+		if (c->eof)
+			return -1;
+	} else {
+		conn_watch(c, 1);
+	}
+	if (c->paused && !c->eof && c->out_len - c->out_off <= OUT_LOW_WATER) {
+		conn_pause(c, 0);
+		return conn_read(c);
+	}
+	return 0;
+}
+
+/* 把数据放入发送缓冲区，缓冲区之前没有数据时立即尝试发送 */
+static int conn_send(conn_t* c, const char* data, int len) {
+	if (c->out_len + len > c->out_cap) {
+		/* 先把已发送的部分移走，仍然放不下时扩大缓冲区 */
+		memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+		c->out_len -= c->out_off;
+		c->out_off = 0;
+		if (c->out_len + len > c->out_cap) {
+			c->out_cap = MAX(c->out_len + len, 2 * c->out_cap);
+			c->out = realloc(c->out, c->out_cap);
+		}
+	}
+	memcpy(c->out + c->out_len, data, len);
+	c->out_len += len;
+	if (!c->writing && conn_flush(c) < 0)
+		return -1;
+	/* 客户端接收得太慢，不再读取它的请求，直到回复发出去一部分 */
+	if (backpressure && c->out_len - c->out_off > OUT_HIGH_WATER)
+		conn_pause(c, 1);
+	return 0;
+}
+
+/*
+ * 读取客户端数据并回复，边沿触发时要一直读到EAGAIN或者暂停，连接关闭返回-1
+ * 边沿触发时暂停的连接仍然会报告可读事件，直接忽略
+ */
+static int conn_read(conn_t* c) {
+	char buf[BUFFER_SIZE + sizeof(SERVER_IDENT)];
+	int real_read;
+	if (c->paused)
+		return 0;
+	do {
+		real_read = recv(c->fd, buf, BUFFER_SIZE, 0);
+		if (real_read < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			if (errno != ECONNRESET)
+				perror("recv");
+			return -1;
+		} else if (real_read == 0) {
+			if (verbose)
+				printf("Client %d(socket) has left\r\n", c->fd);
+			/* 还有回复没发完时不再读取，等发送完再关闭 */
+			if (c->out_off < c->out_len) {
+				c->eof = 1;
+				conn_pause(c, 1);
+				return 0;
+			}
+			return -1;
+		}
+		buf[real_read] = '\0';
+		if (verbose)
+			printf("Receive a message from %d(socket):%s\r\n", c->fd, buf);
+		memcpy(buf + real_read, SERVER_IDENT, sizeof(SERVER_IDENT) - 1);
+		if (conn_send(c, buf, real_read + sizeof(SERVER_IDENT) - 1) < 0)
+			return -1;
+	} while (c->r->mode == MODE_EPOLL_ET && !c->paused);
+	return 0;
+}
+
+/* 接收所有等待中的连接，监听套接字是非阻塞的，没有连接时返回EAGAIN */
+static void server_accept(reactor_t* r) {
+	int client_fd;
+	while (1) {
+		client_fd = accept4(r->server_fd, NULL, NULL,
+		SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_fd >= 0) {
+			conn_open(r, client_fd);
+			continue;
+		}
+		if (errno == EINTR || errno == ECONNABORTED)
+			continue;
+		if (errno == EMFILE || errno == ENFILE) {
+			/* 描述符用完时连接一直留在监听队列中，水平触发会不停返回，
+			 * 用预留的描述符接收并立即关闭，告诉客户端服务器忙 */
+			if (r->idle_fd >= 0) {
+				close(r->idle_fd);
+				client_fd = accept(r->server_fd, NULL, NULL);
+				if (client_fd >= 0) {
+					close(client_fd);
+					printf("Too many open files, reject connection\r\n");
+				}
+			}
+			/* m模式下所有反应堆共用进程的描述符表，空出的位置可能被其他线程占用，
+			 * 预留描述符打不开时不再重试accept，等下一次事件再处理 */
+			r->idle_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+			if (r->idle_fd < 0)
+				return;
+			continue;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			perror("accept");
+		return;
+	}
+}
+
+/* 创建非阻塞的监听套接字，reuseport为1时多个套接字可以绑定同一端口，由内核分配连接 */
+static int server_listen(int port, int reuseport) {
+	struct sockaddr_in server_addr;
+	int server_fd;
+	int ret;
+	/* 创建流式套接字 */
+	server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server_fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	/* 允许重复使用本地地址与套接字进行绑定 */
+	int b_reuse = 1;
+	setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &b_reuse, sizeof(b_reuse));
+	if (reuseport
+			&& setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &b_reuse,
+					sizeof(b_reuse)) < 0) {
+		perror("setsockopt");
+		exit(1);
+	}
+	/* 套接字绑定地址信息 */
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(port);
+	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	ret = bind(server_fd, (struct sockaddr*) &server_addr, sizeof(server_addr));
+	if (ret < 0) {
+		perror("bind");
+		exit(1);
+	}
+	/* 设置监听队列最大长度 */
+	ret = listen(server_fd, MAX_QUE_CONN_NUM);
+	if (ret < 0) {
+		perror("listen");
+		exit(1);
+	}
+	return server_fd;
+}
+
+/* 初始化事件循环 */
+static void reactor_init(reactor_t* r, int server_fd, int mode) {
+	struct epoll_event ev;
+	memset(r, 0, sizeof(reactor_t));
+	r->mode = mode;
+	r->server_fd = server_fd;
+	r->epfd = -1;
+	r->cpu = -1;
+	/* 进程的描述符用完时用预留的描述符拒绝连接 */
+	r->idle_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (mode == MODE_SELECT) {
+		/* 构造读文件描述符集合 */
+		FD_ZERO(&r->inset);
+		FD_ZERO(&r->outset);
+		FD_SET(server_fd, &r->inset); //负责等待客户端连接
+		r->maxfd = server_fd;
+		return;
+	}
+	r->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (r->epfd < 0) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	/* 监听套接字的事件只需要在可读时处理，用空指针与连接区分 */
+	ev.events = mode == MODE_EPOLL_ET ? EPOLLIN | EPOLLET : EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(r->epfd, EPOLL_CTL_ADD, server_fd, &ev);
+}
+
+/* select多路复用服务器 */
+static void server_select(int server_fd) {
+	fd_set tmp_inset, tmp_outset;
+	struct timeval tv;
+	reactor_t r;
+	conn_t* c;
+	int ret;
+	int i;
+	reactor_init(&r, server_fd, MODE_SELECT);
+	/* 循环等待事件发生 */
+	while (1) {
+		/* 文件描述符集合备份，这样可以避免每次都进行初始化 */
+		tmp_inset = r.inset;
+		tmp_outset = r.outset;
+		tv.tv_sec = TIME_OUT;
+		tv.tv_usec = 0;
+		/* select多路复用，只需要检查到最大的描述符为止 */
+		ret = select(r.maxfd + 1, &tmp_inset, &tmp_outset, NULL, &tv);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("select");
+			exit(1);
+		} else if (ret == 0) {
+			if (verbose)
+				printf("Time-out\r\n");
+			continue;
+		}
+		/* 轮询每个描述符，maxfd可能在循环中变化 */
+		for (i = 0; i <= r.maxfd && ret > 0; i++) {
+			if (FD_ISSET(i, &tmp_inset)) {
+				ret--;
+				/* 有新的连接请求到来 */
+				if (i == server_fd) {
+					server_accept(&r);
+				}
+				/* 有新的数据发送过来 */
+				else if ((c = conns[i]) != NULL && conn_read(c) < 0) {
+					conn_close(c);
+					continue;
+				}
+			}
+			/* 套接字可写，继续发送没发完的数据 */
+			if (FD_ISSET(i, &tmp_outset)) {
+				ret--;
+				if ((c = conns[i]) != NULL && conn_flush(c) < 0)
+					conn_close(c);
+			}
+		}
+	}
+}
+
+/* epoll事件循环 */
+static void reactor_run(reactor_t* r) {
+	struct epoll_event events[MAX_EVENTS];
+	conn_t* c;
+	int n, i;
+	while (1) {
+		n = epoll_wait(r->epfd, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			exit(1);
+		}
+		/* 只需要处理就绪的描述符 */
+		for (i = 0; i < n; i++) {
+			c = events[i].data.ptr;
+			if (c == NULL) {
+				server_accept(r);
+				continue;
+			}
+			/* 出错或对端关闭时读操作会返回错误或0 */
+			if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+					&& conn_read(c) < 0) {
+				conn_close(c);
+				continue;
+			}
+			if ((events[i].events & EPOLLOUT) && conn_flush(c) < 0)
+				conn_close(c);
+		}
+	}
+}
+
+/* epoll多路复用服务器，et为1时使用边沿触发 */
+static void server_epoll(int server_fd, int et) {
+	reactor_t r;
+	reactor_init(&r, server_fd, et ? MODE_EPOLL_ET : MODE_EPOLL_LT);
+	reactor_run(&r);
+}
+
+/* 多线程模式的事件循环线程 */
+void* thrd_reactor(void* arg) {
+	reactor_t* r = arg;
+	cpu_set_t cpus;
+	/* 绑定到一个CPU上，连接的数据始终在同一个CPU的缓存中处理 */
+	if (r->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(r->cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+	reactor_run(r);
+	return NULL;
+}
+
+/*
+ * 多线程服务器，每个线程有自己的监听套接字和epoll实例，
+ * 内核按连接的地址和端口把新连接分配给其中一个监听套接字，
+ * 连接从建立到关闭都在同一个线程中处理，线程之间没有共享数据也不需要加锁
+ */
+static void server_multi(const int* server_fds, int threads) {
+	static reactor_t reactors[MAX_REACTORS];
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+	int ret;
+	for (i = 0; i < threads; i++) {
+		reactor_init(&reactors[i], server_fds[i], MODE_EPOLL_ET);
+		reactors[i].cpu = i % cpus;
+		ret = pthread_create(&reactors[i].thread, NULL, thrd_reactor,
+				&reactors[i]);
+		if (ret != 0) {
+			errno = ret;
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(reactors[i].thread, NULL);
+	}
+}
+
+/* 当前时间，单位微秒 */
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_float(const void* a, const void* b) {
+	float x = *(const float*) a, y = *(const float*) b;
+	return (x > y) - (x < y);
+}
+
+/* 负载生成线程的参数和结果 */
+typedef struct {
+	const struct sockaddr_in* addr; //服务器地址
+	int clients; //本线程的连接数量
+	pthread_barrier_t* barrier; //所有线程建立连接后同时开始
+	float* lat; //往返延迟记录，单位微秒
+	long samples; //最多记录的延迟数量
+	long count; //完成的消息数量
+	long failed; //被服务器断开的连接数量
+	double elapsed; //实际测试时间，单位微秒
+	pthread_t thread;
+} load_t;
+
+/*
+ * 负载生成线程：建立clients个连接，每个连接发送一条消息，
+ * 收到回复后立即发送下一条，持续BENCH_SECONDS秒
+ */
+void* thrd_load(void* arg) {
+	load_t* l = arg;
+	struct epoll_event ev, events[MAX_EVENTS];
+	int reply = strlen(BENCH_MSG) + strlen(SERVER_IDENT);
+	int* fds = malloc(l->clients * sizeof(int));
+	int* got = calloc(l->clients, sizeof(int)); //已收到的回复字节数
+	double* start = malloc(l->clients * sizeof(double));
+	double t0, t1, now;
+	char buf[BUFFER_SIZE];
+	int load_epfd, n, i, slot, ret;
+
+	load_epfd = epoll_create1(0);
+	/* 先建立所有连接，再同时开始收发 */
+	for (slot = 0; slot < l->clients; slot++) {
+		fds[slot] = socket(AF_INET, SOCK_STREAM, 0);
+		if (fds[slot] < 0
+				|| connect(fds[slot], (const struct sockaddr*) l->addr,
+						sizeof(*l->addr)) < 0) {
+			perror("connect");
+			exit(1);
+		}
+		fcntl(fds[slot], F_SETFL, O_NONBLOCK);
+		ev.events = EPOLLIN;
+		ev.data.u32 = slot;
+		epoll_ctl(load_epfd, EPOLL_CTL_ADD, fds[slot], &ev);
+	}
+	pthread_barrier_wait(l->barrier);
+	t0 = now_us();
+	for (slot = 0; slot < l->clients; slot++) {
+		start[slot] = now_us();
+		send(fds[slot], BENCH_MSG, strlen(BENCH_MSG), MSG_NOSIGNAL);
+	}
+	t1 = t0 + BENCH_SECONDS * 1e6;
+	while ((now = now_us()) < t1) {
+		n = epoll_wait(load_epfd, events, MAX_EVENTS, 100);
+		for (i = 0; i < n; i++) {
+			slot = events[i].data.u32;
+			ret = recv(fds[slot], buf, sizeof(buf), 0);
+			if (ret <= 0) {
+				if (ret < 0 && errno == EAGAIN)
+					continue;
+				/* 服务器关闭了连接 */
+				l->failed++;
+				epoll_ctl(load_epfd, EPOLL_CTL_DEL, fds[slot], NULL);
+				continue;
+			}
+			got[slot] += ret;
+			if (got[slot] < reply)
+				continue;
+			now = now_us();
+			if (l->count < l->samples)
+				l->lat[l->count] = now - start[slot];
+			l->count++;
+			got[slot] = 0;
+			start[slot] = now;
+			send(fds[slot], BENCH_MSG, strlen(BENCH_MSG), MSG_NOSIGNAL);
+		}
+	}
+	l->elapsed = now_us() - t0;
+	for (slot = 0; slot < l->clients; slot++)
+		close(fds[slot]);
+	close(load_epfd);
+	free(fds);
+	free(got);
+	free(start);
+	return NULL;
+}
+
+/*
+ * 负载生成器：用threads个线程向服务器建立共clients个连接，
+ * 统计每秒处理的消息数和往返延迟
+ */
+static void load_run(const char* name, const struct sockaddr_in* addr,
+		int clients, int threads) {
+	load_t* loads = calloc(threads, sizeof(load_t));
+	float* lat = malloc(BENCH_SAMPLES * sizeof(float));
+	pthread_barrier_t barrier;
+	double rate = 0;
+	long count = 0, failed = 0, n = 0;
+	int i;
+
+	pthread_barrier_init(&barrier, NULL, threads);
+	for (i = 0; i < threads; i++) {
+		loads[i].addr = addr;
+		loads[i].clients = clients / threads + (i < clients % threads);
+		loads[i].barrier = &barrier;
+		loads[i].samples = BENCH_SAMPLES / threads;
+		loads[i].lat = lat + i * loads[i].samples;
+		pthread_create(&loads[i].thread, NULL, thrd_load, &loads[i]);
+	}
+	/* 汇总各线程的结果，延迟记录移到一起后排序 */
+	for (i = 0; i < threads; i++) {
+		pthread_join(loads[i].thread, NULL);
+		rate += loads[i].count / (loads[i].elapsed / 1e6);
+		count = loads[i].count < loads[i].samples ?
+				loads[i].count : loads[i].samples;
+		memmove(lat + n, loads[i].lat, count * sizeof(float));
+		n += count;
+		failed += loads[i].failed;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	qsort(lat, n, sizeof(float), cmp_float);
+	if (n > 0) {
+		printf("%-12s %6d conns %9.0f msg/s  p50 %8.3f ms  p99 %8.3f ms"
+				"  max %8.3f ms%s\r\n", name, clients, rate,
+				lat[n / 2] / 1e3, lat[(int) (n * 0.99)] / 1e3,
+				lat[n - 1] / 1e3, failed ? "  (connections lost)" : "");
+	} else {
+		printf("%-12s %6d conns no reply\r\n", name, clients);
+	}
+	free(loads);
+	free(lat);
+}
+
+/* 慢消费者线程的参数和结果 */
+typedef struct {
+	const struct sockaddr_in* addr; //服务器地址
+	long sent; //服务器接收的字节数
+	pthread_t thread;
+} hog_t;
+
+/*
+ * 慢消费者：不停发送数据但从不读取回复，持续BENCH_SECONDS秒
+ * 没有背压时服务器为它保存所有的回复
+ */
+void* thrd_hog(void* arg) {
+	hog_t* h = arg;
+	static char buf[HOG_CHUNK];
+	struct pollfd pfd;
+	double t1;
+	int fd, ret;
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0
+			|| connect(fd, (const struct sockaddr*) h->addr, sizeof(*h->addr))
+					< 0) {
+		perror("connect");
+		exit(1);
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	memset(buf, 'x', sizeof(buf));
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+	t1 = now_us() + BENCH_SECONDS * 1e6;
+	while (now_us() < t1 && h->sent < HOG_MAX_BYTES) {
+		ret = send(fd, buf, sizeof(buf), MSG_NOSIGNAL);
+		if (ret > 0) {
+			h->sent += ret;
+		} else if (ret < 0 && errno == EAGAIN) {
+			poll(&pfd, 1, 100);
+		} else {
+			break;
+		}
+	}
+	/* 接收缓冲区中没有被服务器读取的数据不算 */
+	ioctl(fd, SIOCOUTQ, &ret);
+	h->sent -= ret;
+	close(fd);
+	return NULL;
+}
+
+/*
+ * 在子进程中以指定模式运行服务器，测试完成后杀死子进程
+ * threads大于0时使用多线程模式，load_threads是负载生成线程数，
+ * hog为1时同时运行一个慢消费者，最后报告服务器占用的最大内存
+ */
+static void bench_server(const char* name, int server_mode, int threads,
+		int clients, int load_threads, int hog) {
+	int server_fds[MAX_REACTORS];
+	struct sockaddr_in addr;
+	struct rusage usage;
+	hog_t h;
+	pid_t pid;
+	int i;
+	/* 父进程先创建监听套接字，子进程开始accept前的连接在监听队列中等待 */
+	for (i = 0; i < (threads > 0 ? threads : 1); i++)
+		server_fds[i] = server_listen(PORT, threads > 0);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		verbose = 0;
+		if (threads > 0)
+			server_multi(server_fds, threads);
+		else if (server_mode == MODE_SELECT)
+			server_select(server_fds[0]);
+		else
+			server_epoll(server_fds[0], server_mode == MODE_EPOLL_ET);
+		exit(0);
+	}
+	for (i = 0; i < (threads > 0 ? threads : 1); i++)
+		close(server_fds[i]);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (hog) {
+		memset(&h, 0, sizeof(h));
+		h.addr = &addr;
+		pthread_create(&h.thread, NULL, thrd_hog, &h);
+	}
+	load_run(name, &addr, clients, load_threads);
+	if (hog)
+		pthread_join(h.thread, NULL);
+	kill(pid, SIGKILL);
+	wait4(pid, NULL, 0, &usage);
+	if (hog)
+		printf("%-12s slow consumer sent %6.1f MB, server max rss %6.1f MB"
+				"\r\n", "", h.sent / 1e6, usage.ru_maxrss / 1024.0);
+}
+
+/* 提高描述符上限，客户端和服务器进程都要打开上万个套接字 */
+static int raise_nofile(void) {
+	struct rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+	return (int) rl.rlim_cur;
 }
 
 int main(int argc, char **argv) {
 	int server_fd, client_fd;
 	int maxfd;
-	struct sockaddr_in server_addr, client_addr;
+	struct sockaddr_in server_addr;
 	fd_set inset, tmp_inset;
-	socklen_t cin_size;
 	struct timeval tv;
 	char buf[BUFFER_SIZE];
 	int real_read, real_write;
-	int i;
 	int ret;
 	/*参数检查*/
 	if (argc <= 1) {
 		Usage(argv[0]);
 		exit(1);
 	}
-	/* 服务端 */
+	/* 服务端，select多路复用 */
 	if (strncasecmp(argv[1], "s", 1) == 0) {
-		/* 创建流式套接字 */
-		server_fd = socket(AF_INET, SOCK_STREAM, 0);
-		if (server_fd < 0) {
-			perror("socket");
+		server_fd = server_listen(PORT, 0);
+		printf("Listening...\r\n");
+		server_select(server_fd);
+		close(server_fd);
+	}
+	/* 服务端，epoll多路复用，默认边沿触发 */
+	else if (strncasecmp(argv[1], "e", 1) == 0) {
+		server_fd = server_listen(PORT, 0);
+		printf("Listening...\r\n");
+		server_epoll(server_fd, argc <= 2 || strcasecmp(argv[2], "lt") != 0);
+		close(server_fd);
+	}
+	/* 服务端，每个CPU一个epoll线程，默认线程数等于CPU数 */
+	else if (strncasecmp(argv[1], "m", 1) == 0) {
+		int server_fds[MAX_REACTORS];
+		int threads = argc > 2 ?
+				atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+		int i;
+		if (threads <= 0 || threads > MAX_REACTORS) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		raise_nofile();
+		for (i = 0; i < threads; i++)
+			server_fds[i] = server_listen(PORT, 1);
+		printf("Listening with %d threads...\r\n", threads);
+		server_multi(server_fds, threads);
+	}
+	/* 负载生成器，连接到正在运行的服务器 */
+	else if (strncasecmp(argv[1], "l", 1) == 0) {
+		int clients = argc > 3 ? atoi(argv[3]) : 1000;
+		int threads = argc > 4 ?
+				atoi(argv[4]) : sysconf(_SC_NPROCESSORS_ONLN);
+		if (argc <= 2 || clients <= 0 || threads <= 0 || threads > clients) {
+			Usage(argv[0]);
 			exit(1);
 		}
-		/* 套接字绑定地址信息 */
 		memset(&server_addr, 0, sizeof(server_addr));
 		server_addr.sin_family = AF_INET;
 		server_addr.sin_port = htons(PORT);
-		server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-		ret = bind(server_fd, (struct sockaddr*) &server_addr,
-				sizeof(server_addr));
-		if (ret < 0) {
-			perror("bind");
-			exit(1);
-		}
-		/* 设置监听队列最大长度 */
-		ret = listen(server_fd, MAX_QUE_CONN_NUM);
-		if (ret < 0) {
-			perror("listen");
+		ret = inet_aton(argv[2], &server_addr.sin_addr);
+		if (ret == 0) {
+			perror("inet_aton");
 			exit(1);
 		}
-		printf("Listening...\r\n");
-		/* 构造读文件描述符集合 */
-		FD_ZERO(&inset);
-		FD_SET(0, &inset);	//标准经盘输入
-		FD_SET(server_fd, &inset);	//负责等待客户端连接
-		/* 循环等待事件发生 */
-		while (1) {
-			/* 文件描述符集合备份，这样可以避免每次都进行初始化 */
-			tmp_inset = inset;
-			tv.tv_sec = TIME_OUT;
-			tv.tv_usec = 0;
-			/* select多路复用 */
-			ret = select(MAX_SOCK_FD, &tmp_inset, NULL, NULL, &tv);
-			if (ret < 0) {
-				perror("select");
-				exit(1);
-			} else if (ret == 0) {
-				printf("Time-out\r\n");
-				break;
+		raise_nofile();
+		load_run("load", &server_addr, clients, threads);
+	}
+	/*
+	 * 性能测试，分别用100、1000、10000个连接测试select和epoll，
+	 * 再用1000个连接测试多线程模式的线程数从1到CPU数的扩展性
+	 */
+	else if (strncasecmp(argv[1], "b", 1) == 0) {
+		static const int clients[] = { 100, 1000, 10000 };
+		int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		int limit = raise_nofile();
+		char name[32];
+		int i;
+		for (i = 0; i < sizeof(clients) / sizeof(clients[0]); i++) {
+			if (clients[i] > limit - 64) {
+				printf("open file limit %d, skip %d conns\r\n", limit,
+						clients[i]);
+				continue;
 			}
-			/* 轮询每个描述符 */
-			for (i = 0; i < MAX_SOCK_FD; i++) {
-				if (FD_ISSET(i, &tmp_inset)) {
-					/* 有新的连接请求到来 */
-					if (i == server_fd) {
-						cin_size = sizeof(client_addr);
-						/* 接收客户端的连接请求 */
-						client_fd = accept(i, (struct sockaddr*) &client_addr,
-								&cin_size);
-						if (client_fd < 0) {
-							perror("accept");
-							exit(1);
-						}
-						/* 将新连接的客户端套接字加入观察列表中 */
-						FD_SET(client_fd, &inset);
-						printf("New connection from %d(socket)\r\n", client_fd);
-					}
-					/* 有新的数据发送过来 */
-					else {
-						memset(buf, 0, BUFFER_SIZE);
-						real_read = recv(i, buf, BUFFER_SIZE, 0);
-						if (real_read < 0) {
-							perror("recv");
-						} else if (real_read == 0) {
-							printf("Client %d(socket) has left\r\n", i);
-							close(i);
-							FD_CLR(i, &inset);
-						} else {
-							printf("Receive a message from %d(socket):%s\r\n",
-									i, buf);
-							strncat(buf, SERVER_IDENT, sizeof(SERVER_IDENT));
-							real_write = send(i, buf, strlen(buf), 0);
-							if (real_write < 0) {
-								perror("send");
-							}
-						}
-					}
-				}
+			/* 服务器的描述符超过FD_SETSIZE时无法使用select */
+			if (clients[i] < MAX_SOCK_FD - 16)
+				bench_server("select", MODE_SELECT, 0, clients[i], 1, 0);
+			else
+				printf("%-12s %6d conns exceeds FD_SETSIZE %d\r\n", "select",
+						clients[i], MAX_SOCK_FD);
+			bench_server("epoll-lt", MODE_EPOLL_LT, 0, clients[i], 1, 0);
+			bench_server("epoll-et", MODE_EPOLL_ET, 0, clients[i], 1, 0);
+		}
+		for (i = 1; i <= cpus && i <= MAX_REACTORS; i *= 2) {
+			snprintf(name, sizeof(name), "reactor x%d", i);
+			bench_server(name, MODE_EPOLL_ET, i, 1000, cpus, 0);
+			/* 不是2的幂时最后再测一次全部CPU */
+			if (i < cpus && i * 2 > cpus) {
+				snprintf(name, sizeof(name), "reactor x%d", cpus);
+				bench_server(name, MODE_EPOLL_ET, cpus, 1000, cpus, 0);
 			}
 		}
-		close(server_fd);
+	}
+	/*
+	 * 背压测试：1000个正常连接加一个只发不收的慢消费者，
+	 * 分别在有背压和没有背压时测试select和epoll
+	 */
+	else if (strncasecmp(argv[1], "w", 1) == 0) {
+		raise_nofile();
+		for (backpressure = 1; backpressure >= 0; backpressure--) {
+			printf("backpressure %s, high water %d, low water %d\r\n",
+					backpressure ? "on" : "off", OUT_HIGH_WATER,
+					OUT_LOW_WATER);
+			bench_server("select", MODE_SELECT, 0, 1000, 1, 1);
+			bench_server("epoll-lt", MODE_EPOLL_LT, 0, 1000, 1, 1);
+			bench_server("epoll-et", MODE_EPOLL_ET, 0, 1000, 1, 1);
+		}
 	}
 	/* 客户端 */
 	else if (strncasecmp(argv[1], "c", 1) == 0) {
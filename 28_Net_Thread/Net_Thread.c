@@ -6,79 +6,430 @@
  *  要求：
  *  	网络编程之---多线程并发服务器
  *  	对每个连接来的客户端创建一个线程，单独与其进行通信
+ *  	或者预先创建固定数量的工作线程，由线程池处理连接
  *	********************************************************************
  *	1. 所谓并发服务器，就是指能够同时处理多个客户请求的服务器
  *	2. 实现并发服务器，主要有两种：
  *		a. 并发连接服务器：在accept函数监听到连接请求后，产生子进程/线程处理用户请求
  *		b. 单进程线程并发服务器：通过select函数，用多路复用I/O实现处理多个客户的连接
+ *	3. 每个连接一个线程时，连接越多线程创建销毁的开销越大，线程数和内存也没有上限
+ *	4. 线程池模式：每个工作线程有自己的epoll，主线程accept后把非阻塞套接字轮流交给工作线程，
+ *	   工作线程只处理有数据可读的连接，空闲的连接不占用线程，线程数是固定的
+ *	5. 线程之间不能共享收发缓冲区，每次收发的缓冲区都在处理它的线程栈上
  *	********************************************************************
  */
 
 #include <arpa/inet.h>
 #include <asm-generic/socket.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #define PORT				5004	//端口号
-#define MAX_QUE_CONN_NUM	5		//最大同时支持连接服务器的数量
+#define MAX_QUE_CONN_NUM	4096	//内核监听队列长度，并发连接多时太小会丢弃SYN导致1秒重传
 #define BUFFER_SIZE			1024	//数据缓冲区大小
+#define WORKER_NUM			8		//线程池默认工作线程数量
+#define WORKER_EVENTS		64		//工作线程一次epoll_wait最多处理的事件数
+#define THREAD_STACK_SIZE	(64 * 1024)	//通信线程栈大小，线程多时减少内存占用
+#define BENCH_CLIENTS		10000	//性能测试默认并发客户端数量
+#define BENCH_CONNS			50000	//性能测试每种模式默认的连接总数
+#define BENCH_MSG			"ping"	//性能测试每个连接发送的消息
 #define MAX(a,b)			((a>b)?(a):(b))
 
-char buf[BUFFER_SIZE];
-int real_read, real_write;
+static int verbose = 1; //为0时不打印每条消息，性能测试时服务端使用
 
 /* 程序使用说明 */
 void Usage(char* arg) {
-	printf("Usage:%s s/S\r\nUsage:%s c/C target_addr\r\n", arg, arg);
+	printf("Usage:%s s/S\r\n"
+			"Usage:%s p/P [workers]\r\n"
+			"Usage:%s c/C target_addr\r\n"
+			"Usage:%s b/B [clients] [conns] [workers]\r\n", arg, arg, arg, arg);
 }
 
-/* 通信子线程 */
+/*
+ * 读取客户端的一次输入并回复，缓冲区是局部变量，各线程互不影响
+ * 返回0继续通信，返回-1时连接应该关闭；非阻塞套接字暂时没有数据时返回0
+ */
+static int client_recv(int client_fd) {
+	char buf[BUFFER_SIZE];
+	int real_read, real_write;
+	/* 留出追加"OK"和结束符的空间 */
+	real_read = recv(client_fd, buf, BUFFER_SIZE - 3, 0);
+	if (real_read < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return 0;
+	} else if (real_read < 0 && errno != ECONNRESET) {
+		perror("recv");
+		return -1;
+	} else if (real_read <= 0) {
+		if (verbose)
+			printf("Client %d has exited\r\n", client_fd);
+		return -1;
+	}
+	buf[real_read] = '\0';
+	if (verbose)
+		printf("Receive from client %d:%s\r\n", client_fd, buf);
+	if (strncmp(buf, "quit", 4) == 0) {
+		if (verbose)
+			printf("client %d(socket) has exited\r\n", client_fd);
+		return -1;
+	}
+	memcpy(buf + real_read, "OK", 3);
+	/* 非阻塞套接字发送缓冲区满说明客户端不读回复，断开它而不是让工作线程等待 */
+	real_write = send(client_fd, buf, real_read + 2, MSG_NOSIGNAL);
+	if (real_write != real_read + 2) {
+		if (real_write < 0 && errno != EAGAIN)
+			perror("send");
+		return -1;
+	}
+	return 0;
+}
+
+/* 与一个客户端通信直到其退出，阻塞的套接字 */
+static void client_serve(int client_fd) {
+	while (client_recv(client_fd) == 0)
+		;
+	close(client_fd);
+}
+
+/* 通信子线程，每个连接一个 */
 void* thrd_accept(void* arg) {
-	int* parg = (int*) arg;
-	/* 一定要用一个局部变量保存传递过来的数据，直接操作指针arg达不到并发服务器的效果 */
-	int client_fd = *parg;
-	/* 循环读取客户端输入数据 */
+	/* 套接字描述符按值传递，不会被主线程下一次accept覆盖 */
+	client_serve((int) (intptr_t) arg);
+	return NULL;
+}
+
+/*
+ * 线程池工作线程，参数是自己的epoll描述符，主线程把连接加入其中
+ * 每次只处理有数据的连接，一个客户端空闲时不会挡住其他客户端
+ */
+void* thrd_worker(void* arg) {
+	int epfd = (int) (intptr_t) arg;
+	struct epoll_event events[WORKER_EVENTS];
+	int n, i;
+	while (1) {
+		n = epoll_wait(epfd, events, WORKER_EVENTS, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			perror("epoll_wait");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			/* 关闭套接字时自动从epoll中删除 */
+			if (client_recv(events[i].data.fd) < 0)
+				close(events[i].data.fd);
+		}
+	}
+	return NULL;
+}
+
+/* 创建监听套接字 */
+static int server_listen(int port) {
+	struct sockaddr_in server_addr;
+	int server_fd;
+	int ret;
+	/* 创建流式套接字 */
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (server_fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	/* 允许重复使用本地地址与套接字进行绑定 */
+	int b_reuse = 1;
+	setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &b_reuse, sizeof(b_reuse));
+	/* 套接字绑定地址信息 */
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(port);
+	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	ret = bind(server_fd, (struct sockaddr*) &server_addr, sizeof(server_addr));
+	if (ret < 0) {
+		perror("bind");
+		exit(1);
+	}
+	/* 设置监听队列最大长度 */
+	ret = listen(server_fd, MAX_QUE_CONN_NUM);
+	if (ret < 0) {
+		perror("listen");
+		exit(1);
+	}
+	return server_fd;
+}
+
+/* 接收一个连接，被信号打断或客户端在accept前断开时重试 */
+static int server_accept(int server_fd) {
+	struct sockaddr_in client_addr;
+	socklen_t cin_size;
+	int client_fd;
+	do {
+		cin_size = sizeof(client_addr);
+		client_fd = accept(server_fd, (struct sockaddr*) &client_addr,
+				&cin_size);
+	} while (client_fd < 0 && (errno == EINTR || errno == ECONNABORTED));
+	if (client_fd < 0) {
+		perror("accept");
+		exit(1);
+	}
+	if (verbose)
+		printf("New client %d(socket)\r\n", client_fd);
+	return client_fd;
+}
+
+/* 每个连接来的客户端都创建一个线程 */
+static void server_thread(int server_fd) {
+	pthread_attr_t attr;
+	pthread_t trd_id;
+	int client_fd;
+	int ret;
+	/* 线程结束后自动回收资源，否则每个连接都会泄漏一个线程的栈 */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
 	while (1) {
-		memset(buf, 0, BUFFER_SIZE);
-		real_read = recv(client_fd, buf, BUFFER_SIZE, 0);
-		if (real_read < 0) {
-			perror("recv");
-			break;
-		} else if (real_read == 0) {
-			printf("Client %d has exited", client_fd);
-			break;
-		} else {
-			printf("Receive from client %d:%s\r\n", client_fd, buf);
-			if (strncmp(buf, "quit", 4) == 0) {
-				printf("client %d(socket) has exited\r\n", client_fd);
-				break;
+		client_fd = server_accept(server_fd);
+		/* 创建一个新线程，将套接字描述符的值作为参数传入 */
+		ret = pthread_create(&trd_id, &attr, thrd_accept,
+				(void*) (intptr_t) client_fd);
+		if (ret != 0) {
+			/* 线程数达到上限时拒绝这个连接，服务器继续运行 */
+			errno = ret;
+			perror("pthread_create");
+			close(client_fd);
+		}
+	}
+}
+
+/* 固定数量的工作线程处理连接，主线程只负责accept并轮流分给工作线程 */
+static void server_pool(int server_fd, int workers) {
+	pthread_attr_t attr;
+	pthread_t trd_id;
+	struct epoll_event ev;
+	int* epfds = malloc(workers * sizeof(int));
+	int client_fd;
+	int i;
+	int ret;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+	for (i = 0; i < workers; i++) {
+		epfds[i] = epoll_create1(0);
+		if (epfds[i] < 0) {
+			perror("epoll_create1");
+			exit(1);
+		}
+		ret = pthread_create(&trd_id, &attr, thrd_worker,
+				(void*) (intptr_t) epfds[i]);
+		if (ret != 0) {
+			errno = ret;
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0;; i = (i + 1) % workers) {
+		client_fd = server_accept(server_fd);
+		/* 工作线程不能阻塞在某一个连接上 */
+		fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+		ev.events = EPOLLIN;
+		ev.data.fd = client_fd;
+		if (epoll_ctl(epfds[i], EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+			perror("epoll_ctl");
+			close(client_fd);
+		}
+	}
+}
+
+/* 当前时间，单位微秒 */
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void* a, const void* b) {
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* 性能测试客户端发起一个非阻塞连接，成功返回套接字 */
+static int bench_connect(int epfd, const struct sockaddr_in* addr, int slot) {
+	struct epoll_event ev;
+	struct linger lg = { 1, 0 };
+	int fd;
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	/* 关闭时直接复位连接，客户端不进入TIME_WAIT，连续测试时不会耗尽本地端口 */
+	setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+	if (connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) < 0
+			&& errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+	/* 连接建立后可写，先等待EPOLLOUT再发送 */
+	ev.events = EPOLLOUT;
+	ev.data.u32 = slot;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	return fd;
+}
+
+/*
+ * 性能测试：单线程用epoll维持clients个并发连接，每个连接发送一条消息，
+ * 收到回显后关闭并立即发起下一个连接，共conns个连接，
+ * 统计每秒完成的连接数和从connect到收到回显的延迟
+ */
+static void bench_run(const char* name, const struct sockaddr_in* addr,
+		int clients, int conns) {
+	struct epoll_event events[256];
+	int* fds = malloc(clients * sizeof(int));
+	int* got = calloc(clients, sizeof(int)); //已收到的回显字节数，-1表示等待连接
+	double* start = malloc(clients * sizeof(double));
+	double* lat = malloc(conns * sizeof(double));
+	int reply = strlen(BENCH_MSG) + 2; //回显数据带"OK"后缀
+	int launched = 0, active = 0, done = 0, failed = 0;
+	double t0, elapsed;
+	char buf[BUFFER_SIZE];
+	int epfd, n, i, slot, err;
+	socklen_t len;
+
+	epfd = epoll_create1(0);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	t0 = now_us();
+	for (slot = 0; slot < clients && launched < conns; slot++) {
+		launched++;
+		start[slot] = now_us();
+		got[slot] = -1;
+		fds[slot] = bench_connect(epfd, addr, slot);
+		if (fds[slot] < 0)
+			failed++;
+		else
+			active++;
+	}
+	while (active > 0) {
+		n = epoll_wait(epfd, events, 256, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			perror("epoll_wait");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			slot = events[i].data.u32;
+			if (got[slot] < 0) {
+				/* 连接完成，检查结果后发送消息 */
+				len = sizeof(err);
+				getsockopt(fds[slot], SOL_SOCKET, SO_ERROR, &err, &len);
+				if (err != 0 || send(fds[slot], BENCH_MSG, reply - 2,
+				MSG_NOSIGNAL) != reply - 2) {
+					failed++;
+				} else {
+					struct epoll_event ev = { .events = EPOLLIN, .data.u32 =
+							slot };
+					epoll_ctl(epfd, EPOLL_CTL_MOD, fds[slot], &ev);
+					got[slot] = 0;
+					continue;
+				}
+			} else {
+				err = recv(fds[slot], buf, sizeof(buf), 0);
+				if (err < 0 && errno == EAGAIN)
+					continue;
+				if (err <= 0) {
+					failed++;
+				} else if ((got[slot] += err) < reply) {
+					continue;
+				} else {
+					lat[done++] = now_us() - start[slot];
+				}
 			}
-			strcat(buf, "OK");
-			real_write = send(client_fd, buf, strlen(buf), 0);
-			if (real_write < 0) {
-				perror("send");
-				break;
+			/* 这个连接结束，同一位置发起下一个连接 */
+			close(fds[slot]);
+			active--;
+			while (launched < conns) {
+				launched++;
+				start[slot] = now_us();
+				got[slot] = -1;
+				fds[slot] = bench_connect(epfd, addr, slot);
+				if (fds[slot] >= 0) {
+					active++;
+					break;
+				}
+				failed++;
 			}
 		}
+	}
+	elapsed = now_us() - t0;
+	close(epfd);
 
+	qsort(lat, done, sizeof(double), cmp_double);
+	if (done > 0) {
+		printf("%-22s %6d conns %6d failed %9.0f conn/s  "
+				"p50 %8.2f ms  p99 %8.2f ms  max %8.2f ms\r\n", name, done,
+				failed, done / (elapsed / 1e6), lat[done / 2] / 1e3,
+				lat[(int) (done * 0.99)] / 1e3, lat[done - 1] / 1e3);
+	} else {
+		printf("%-22s all %d connections failed\r\n", name, failed);
 	}
-	close(client_fd);
-	pthread_exit(NULL);
+	free(fds);
+	free(got);
+	free(start);
+	free(lat);
+}
+
+/* 在子进程中运行服务器，测试完成后杀死子进程 */
+static void bench_server(const char* name, int workers, int clients,
+		int conns) {
+	struct sockaddr_in addr;
+	int server_fd;
+	pid_t pid;
+	/* 父进程先创建监听套接字，子进程开始accept前的连接在监听队列中等待 */
+	server_fd = server_listen(PORT);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		verbose = 0;
+		if (workers > 0)
+			server_pool(server_fd, workers);
+		else
+			server_thread(server_fd);
+		exit(0);
+	}
+	close(server_fd);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bench_run(name, &addr, clients, conns);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
 }
 
 int main(int argc, char **argv) {
 	int server_fd, client_fd;
-	struct sockaddr_in server_addr, client_addr;
-	socklen_t cin_size;
+	struct sockaddr_in server_addr;
 	fd_set inset, tmp_inset;
-	pthread_t trd_id;
+	char buf[BUFFER_SIZE];
+	int real_read, real_write;
 	int max_fd = -1;
 	int ret;
 	/*参数检查*/
@@ -86,55 +437,48 @@ int main(int argc, char **argv) {
 		Usage(argv[0]);
 		exit(1);
 	}
-	/* 服务端 */
+	/* 服务端，每个连接一个线程 */
 	if (strncasecmp(argv[1], "s", 1) == 0) {
-		/* 创建流式套接字 */
-		server_fd = socket(AF_INET, SOCK_STREAM, 0);
-		if (server_fd < 0) {
-			perror("socket");
-			exit(1);
-		}
-		/* 允许重复使用本地地址与套接字进行绑定 */
-		int b_reuse = 1;
-		setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &b_reuse,
-				sizeof(b_reuse));
-		/* 套接字绑定地址信息 */
-		memset(&server_addr, 0, sizeof(server_addr));
-		server_addr.sin_family = AF_INET;
-		server_addr.sin_port = htons(PORT);
-		server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-		ret = bind(server_fd, (struct sockaddr*) &server_addr,
-				sizeof(server_addr));
-		if (ret < 0) {
-			perror("bind");
+		server_fd = server_listen(PORT);
+		printf("Listening...\r\n");
+		server_thread(server_fd);
+		close(server_fd);
+	}
+	/* 服务端，固定数量的工作线程 */
+	else if (strncasecmp(argv[1], "p", 1) == 0) {
+		int workers = argc > 2 ? atoi(argv[2]) : WORKER_NUM;
+		if (workers <= 0) {
+			Usage(argv[0]);
 			exit(1);
 		}
-		/* 设置监听队列最大长度 */
-		ret = listen(server_fd, MAX_QUE_CONN_NUM);
-		if (ret < 0) {
-			perror("listen");
+		server_fd = server_listen(PORT);
+		printf("Listening with %d workers...\r\n", workers);
+		server_pool(server_fd, workers);
+		close(server_fd);
+	}
+	/* 性能测试，依次测试两种服务器 */
+	else if (strncasecmp(argv[1], "b", 1) == 0) {
+		int clients = argc > 2 ? atoi(argv[2]) : BENCH_CLIENTS;
+		int conns = argc > 3 ? atoi(argv[3]) : BENCH_CONNS;
+		int workers = argc > 4 ? atoi(argv[4]) : WORKER_NUM;
+		struct rlimit rl;
+		if (clients <= 0 || conns <= 0 || workers <= 0) {
+			Usage(argv[0]);
 			exit(1);
 		}
-		printf("Listening...\r\n");
-		/* 对每个连接来的客户端都将创建一个线程 */
-		while (1) {
-			cin_size = sizeof(client_addr);
-			client_fd = accept(server_fd, (struct sockaddr*) &client_addr,
-					&cin_size);
-			if (client_fd < 0) {
-				perror("accept");
-				exit(1);
-			}
-			printf("New client %d(socket)\r\n", client_fd);
-			/* 创建一个新线程，将套接字描述符作为参数传入 */
-			ret = pthread_create(&trd_id, NULL, thrd_accept,
-					(void*) &client_fd);
-			if (ret != 0) {
-				perror("pthread_create");
-				exit(ret);
-			}
+		/* 客户端和服务器进程都要打开clients个套接字，尽量提高描述符上限 */
+		getrlimit(RLIMIT_NOFILE, &rl);
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if (clients > (int) rl.rlim_cur - 64) {
+			clients = (int) rl.rlim_cur - 64;
+			printf("open file limit %d, use %d clients\r\n", (int) rl.rlim_cur,
+					clients);
 		}
-		close(server_fd);
+		printf("%d concurrent clients, %d connections\r\n", clients, conns);
+		bench_server("thread-per-connection", 0, clients, conns);
+		snprintf(buf, sizeof(buf), "pool(%d workers)", workers);
+		bench_server(buf, workers, clients, conns);
 	}
 	/* 客户端 */
 	else if (strncasecmp(argv[1], "c", 1) == 0) {
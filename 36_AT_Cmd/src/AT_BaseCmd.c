@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include "AT_BaseCmd.h"
 #include "ATcmd.h"
+#include "ATsession.h"
 
 /**
  * @brief  Execution commad of AT.
@@ -27,9 +28,9 @@ void at_exeCmdNull(tATNode* pNode) {
 void at_setupCmdE(tATNode* pNode, const char *pPara) {
 	at_debug("at_setupCmdE:%d\r\n", *pPara - '0');
 	if (*pPara == '0') {
-		echoFlag = 0;
+		at_getSession()->echo = 0;
 	} else if (*pPara == '1') {
-		echoFlag = 1;
+		at_getSession()->echo = 1;
 	} else {
 		at_backError();
 		return;
@@ -54,10 +55,10 @@ void at_exeCmdRst(tATNode* pNode) {
  * @retval None
  */
 void at_exeCmdGmr(tATNode* pNode) {
-	char temp[64];
 	at_debug("at_exeCmdGmr\r\n");
-	sprintf(temp, "-AT_VERSION:%02X-", AT_VERSION);
-	at_response(temp);
+	at_outPutStr("-AT_VERSION:");
+	at_outPutHex(AT_VERSION, 2);
+	at_outPutChar('-');
 	at_backOk();
 }
 
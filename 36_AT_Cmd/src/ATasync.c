@@ -0,0 +1,115 @@
+/*
+ * ATasync.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "ATasync.h"
+
+static pthread_mutex_t at_asyncLock = PTHREAD_MUTEX_INITIALIZER;
+static tATToken *at_doneHead = NULL;	//completed tokens, FIFO
+static tATToken *at_doneTail = NULL;
+static int at_asyncFd = -1;
+
+int at_asyncInit(void) {
+	if (at_asyncFd < 0) {
+		at_asyncFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+	return at_asyncFd;
+}
+
+tATToken* at_defer(void) {
+	tATSession *pSession = at_getSession();
+	tATToken *pToken = (tATToken*) calloc(1, sizeof(tATToken));
+
+	if (pToken == NULL) {
+		at_backError();
+		return NULL;
+	}
+	pToken->session = pSession;
+	pSession->pending = pToken;
+	return pToken;
+}
+
+void at_complete(tATToken *pToken, const char *pInfo, uint8_t ok) {
+	uint64_t one = 1;
+
+	pToken->info = pInfo ? strdup(pInfo) : NULL;
+	pToken->ok = ok;
+	pToken->pNext = NULL;
+	pthread_mutex_lock(&at_asyncLock);
+	if (at_doneTail) {
+		at_doneTail->pNext = pToken;
+	} else {
+		at_doneHead = pToken;
+	}
+	at_doneTail = pToken;
+	pthread_mutex_unlock(&at_asyncLock);
+	if (write(at_asyncFd, &one, sizeof(one)) < 0) {
+		/* counter is already non-zero, dispatch will run anyway */
+	}
+}
+
+int at_asyncDispatch(void (*resumed)(tATSession *pSession)) {
+	tATToken *pToken, *pList;
+	tATSession *pSession;
+	uint64_t count;
+	int n = 0;
+
+	if (read(at_asyncFd, &count, sizeof(count)) < 0) {
+		/* nothing signaled, queue is checked anyway */
+	}
+	pthread_mutex_lock(&at_asyncLock);
+	pList = at_doneHead;
+	at_doneHead = at_doneTail = NULL;
+	pthread_mutex_unlock(&at_asyncLock);
+
+	while ((pToken = pList) != NULL) {
+		pList = pToken->pNext;
+		pSession = pToken->session;
+		if (pSession != NULL) {
+			tATSession *pPrev = at_sessionSelect(pSession);
+			tATOutput *pPrevOut = at_outSelect(&pSession->out);
+			if (pToken->info) {
+				at_outPutStr(pToken->info);
+			}
+			pSession->pending = NULL;
+			if (pToken->ok) {
+				at_backOk();
+			} else {
+				at_backError();
+			}
+			at_outSelect(pPrevOut);
+			at_sessionSelect(pPrev);
+			at_sessionInput(pSession, NULL, 0); /* queued input */
+			if (resumed) {
+				resumed(pSession);
+			}
+		}
+		free(pToken->info);
+		free(pToken);
+		n++;
+	}
+	return n;
+}
+
+void at_asyncCancel(tATSession *pSession) {
+	tATToken *pToken;
+
+	pthread_mutex_lock(&at_asyncLock);
+	if (pSession->pending) {
+		pSession->pending->session = NULL;
+		pSession->pending = NULL;
+	}
+	for (pToken = at_doneHead; pToken; pToken = pToken->pNext) {
+		if (pToken->session == pSession) {
+			pToken->session = NULL;
+		}
+	}
+	pthread_mutex_unlock(&at_asyncLock);
+}
@@ -0,0 +1,65 @@
+/*
+ * ATasync.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#ifndef ATASYNC_H_
+#define ATASYNC_H_
+
+#include <stdint.h>
+#include "ATsession.h"
+
+/*
+ * Completion token of a deferred command. A handler that can not finish
+ * at once calls at_defer instead of at_backOk/at_backError and hands the
+ * token to whatever does the slow work.
+ */
+typedef struct ATToken {
+	struct ATToken *pNext;	//completed queue
+	tATSession *session;	//NULL when session was closed meanwhile
+	char *info;	//information lines printed before final result code
+	uint8_t ok;	//final result code, 1: OK, 0: ERROR
+} tATToken;
+
+/**
+ * @brief  Create completion notification, must be called before at_defer.
+ * @retval file descriptor readable when tokens are completed, -1: failure
+ */
+int at_asyncInit(void);
+
+/**
+ * @brief  Defer current command, the session stops executing input until
+ *         the token is completed. Called from a command handler.
+ * @retval token, NULL when out of memory (ERROR is sent then)
+ */
+tATToken* at_defer(void);
+
+/**
+ * @brief  Complete deferred command, may be called from any thread.
+ * @param  pToken: token from at_defer, must not be used after this call
+ * @param  pInfo: information lines printed before final result code, may be NULL
+ * @param  ok: 1: OK, 0: ERROR
+ * @retval None
+ */
+void at_complete(tATToken *pToken, const char *pInfo, uint8_t ok);
+
+/**
+ * @brief  Send final result codes of completed tokens and continue executing
+ *         queued input of their sessions. Called by the thread owning the
+ *         sessions when the at_asyncInit descriptor is readable.
+ * @param  resumed: called for each session whose command completed, it may be
+ *         deferred again by queued input or have unsent responses, may be NULL
+ * @retval number of tokens handled
+ */
+int at_asyncDispatch(void (*resumed)(tATSession *pSession));
+
+/**
+ * @brief  Forget deferred command of a session that is going to be freed.
+ * @param  pSession: session
+ * @retval None
+ */
+void at_asyncCancel(tATSession *pSession);
+
+#endif /* ATASYNC_H_ */
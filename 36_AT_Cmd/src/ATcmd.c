@@ -1,12 +1,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include "ATcmd.h"
-#include "LinkList.h"
 #include "AT_BaseCmd.h"
+#include "ATsession.h"
 
 #define AT_BASICCMDNUM   	4
+#define AT_CMD_ARENA_SIZE	64	//initial capacity of command table, doubled when full
+#define AT_CMD_INDEX_SIZE	(AT_CMD_ARENA_SIZE * 2)	//initial size of hash index
 
-static tLinkList *at_linkList = NULL;
+static tATNode *at_cmdArena = NULL;	//registered commands, contiguous
+static uint32_t at_cmdArenaSize = 0;	//capacity of at_cmdArena
+static uint32_t at_cmdCount = 0;	//commands in at_cmdArena
+static uint8_t at_cmdFrozen = 0;	//no more registration after at_freeze
+static int32_t at_nullIndex = -1;	//"AT" without command name
+static uint32_t *at_cmdTable = NULL;	//open addressing hash index kept by at_regCommand, arena index + 1, 0: empty
+static uint32_t at_cmdTableSize = 0;	//power of 2, at least twice the command count
 static at_funcationType at_basicfun[AT_BASICCMDNUM] =
 		{ { NULL, 0, NULL, NULL,
 		NULL, at_exeCmdNull }, { "E", 1, NULL, NULL, at_setupCmdE, NULL }, {
@@ -14,53 +22,178 @@ static at_funcationType at_basicfun[AT_BASICCMDNUM] =
 				NULL, NULL, NULL, at_exeCmdRst }, { "+GMR", 4, NULL, NULL, NULL,
 				at_exeCmdGmr } };
 
-uint8_t echoFlag = 1;
 void (*system_restart)(void) = NULL;
 
 /**
- * @brief  Get the length of commad.
+ * @brief  Hash one byte of command name into hash value (FNV-1a).
+ */
+#define AT_HASH_INIT		2166136261u
+#define AT_HASH_STEP(h, c)	(((h) ^ (uint8_t) (c)) * 16777619u)
+
+/**
+ * @brief  Get the length of commad and hash its name in the same pass.
  * @param  pCmd: point to received command
+ * @param  pHash: hash of command name
  * @retval the length of command, 'A'and'T' excluded.
  *   @arg -1: failure
  */
-static int8_t at_getCmdLen(const char *pCmd) {
-	uint8_t n, i;
-	n = 0;
-	i = 128;
-	while (i--) {
-		if ((*pCmd == '\r') || (*pCmd == '=') || (*pCmd == '?')
+static int8_t at_getCmdLen(const char *pCmd, uint32_t *pHash) {
+	uint32_t h = AT_HASH_INIT;
+	int8_t n;
+
+	for (n = 0; n < INT8_MAX; n++, pCmd++) {
+		if ((*pCmd == '\r') || (*pCmd == '\n') || (*pCmd == '\0')
+				|| (*pCmd == '=') || (*pCmd == '?')
 				|| ((*pCmd >= '0') && (*pCmd <= '9'))) {
+			*pHash = h;
 			return n;
-		} else {
-			pCmd++;
-			n++;
 		}
+		h = AT_HASH_STEP(h, *pCmd);
 	}
 	return -1;
 }
 
+/**
+ * @brief  Put one command into hash index, the first registered one wins.
+ * @param  index: index of command in at_cmdArena
+ * @retval None
+ */
+static void at_indexInsert(uint32_t index) {
+	const tATNode *pNew = &at_cmdArena[index];
+	const tATNode *pNode;
+	uint32_t i = pNew->hash & (at_cmdTableSize - 1);
+
+	while (at_cmdTable[i] != 0) {
+		pNode = &at_cmdArena[at_cmdTable[i] - 1];
+		if (pNode->hash == pNew->hash
+				&& pNode->fun.at_cmdLen == pNew->fun.at_cmdLen
+				&& strncmp(pNode->name, pNew->name, pNode->fun.at_cmdLen) == 0) {
+			return;
+		}
+		i = (i + 1) & (at_cmdTableSize - 1);
+	}
+	at_cmdTable[i] = index + 1;
+}
+
+/**
+ * @brief  Resize hash index so that it holds count commands at no more than
+ *         half load, commands already in at_cmdArena are put into it again.
+ * @param  count: number of commands the index must hold
+ * @retval 0: success, -1: out of memory
+ */
+static int at_indexResize(uint32_t count) {
+	uint32_t *pTable, i, size = at_cmdTableSize ? at_cmdTableSize : AT_CMD_INDEX_SIZE;
+
+	while (size < count * 2) {
+		size *= 2;
+	}
+	if (size == at_cmdTableSize) {
+		return 0;
+	}
+	pTable = (uint32_t*) calloc(size, sizeof(uint32_t));
+	if (pTable == NULL) {
+		return -1;
+	}
+	free(at_cmdTable);
+	at_cmdTable = pTable;
+	at_cmdTableSize = size;
+	for (i = 0; i < at_cmdCount; i++) {
+		if (at_cmdArena[i].fun.at_cmdLen > 0) {
+			at_indexInsert(i);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief  Resize command table, pointers into it are fixed up.
+ * @param  size: new capacity, not less than at_cmdCount
+ * @retval 0: success, -1: out of memory
+ */
+static int at_arenaResize(uint32_t size) {
+	tATNode *pArena = (tATNode*) realloc(at_cmdArena, size * sizeof(tATNode));
+	uint32_t i;
+
+	if (pArena == NULL) {
+		return -1;
+	}
+	at_cmdArena = pArena;
+	at_cmdArenaSize = size;
+	for (i = 0; i < at_cmdCount; i++) {
+		pArena[i].at_fun = &pArena[i].fun;
+		pArena[i].fun.at_cmdName = pArena[i].name;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Copy command into command table and hash index.
+ * @param  pFun: command
+ * @retval 0: success, -1: frozen, name too long or out of memory
+ */
+static int at_addCommand(const at_funcationType *pFun) {
+	tATNode *pNode;
+	uint32_t h;
+	int8_t i;
+
+	if (at_cmdFrozen || pFun->at_cmdLen < 0
+			|| pFun->at_cmdLen >= AT_CMD_NAME_SIZE) {
+		return -1;
+	}
+	if (at_cmdCount == at_cmdArenaSize
+			&& at_arenaResize(
+					at_cmdArenaSize ? at_cmdArenaSize * 2 : AT_CMD_ARENA_SIZE)
+					< 0) {
+		return -1;
+	}
+	if (pFun->at_cmdLen && (at_cmdCount + 1) * 2 > at_cmdTableSize
+			&& at_indexResize(at_cmdCount + 1) < 0) {
+		return -1;
+	}
+	pNode = &at_cmdArena[at_cmdCount];
+	pNode->fun = *pFun;
+	/* copy and hash name in one pass, index growth and lookups use the hash */
+	for (i = 0, h = AT_HASH_INIT; i < pFun->at_cmdLen; i++) {
+		pNode->name[i] = pFun->at_cmdName[i];
+		h = AT_HASH_STEP(h, pNode->name[i]);
+	}
+	pNode->name[i] = '\0';
+	pNode->hash = h;
+	pNode->fun.at_cmdName = pNode->name;
+	pNode->at_fun = &pNode->fun;
+	at_cmdCount++;
+	if (pFun->at_cmdLen) {
+		at_indexInsert(at_cmdCount - 1);
+	} else if (at_nullIndex < 0) {
+		at_nullIndex = at_cmdCount - 1;
+	}
+	return 0;
+}
+
 /**
  * @brief  Query and localization one commad.
  * @param  cmdLen: received length of command
+ * @param  hash: hash of received command name
  * @param  pCmd: point to received command
  * @retval the node address searched or NULL
  * 	@arg NULL: failure
  */
-static tATNode* at_cmdSearch(int8_t cmdLen, const char *pCmd) {
-	int16_t i;
-	tATNode* pNode = (tATNode*) at_linkList->pHead;
+static tATNode* at_cmdSearch(int8_t cmdLen, uint32_t hash, const char *pCmd) {
+	uint32_t i;
+	tATNode* pNode;
+
 	if (cmdLen == 0) {
-		return pNode;
-	} else if (cmdLen > 0) {
-		pNode = (tATNode*) pNode->pNext;
-		for (i = 1; i < at_linkList->SumOfNode; i++) {
-			if (cmdLen == pNode->at_fun->at_cmdLen) {
-				if (strncmp((const char*) pCmd,
-						(const char*) pNode->at_fun->at_cmdName, cmdLen) == 0) {
-					return pNode;
-				}
-			}
-			pNode = (tATNode*) pNode->pNext;
+		return at_nullIndex < 0 ? NULL : &at_cmdArena[at_nullIndex];
+	}
+	if (cmdLen < 0 || at_cmdTable == NULL) {
+		return NULL;
+	}
+	for (i = hash & (at_cmdTableSize - 1); at_cmdTable[i] != 0;
+			i = (i + 1) & (at_cmdTableSize - 1)) {
+		pNode = &at_cmdArena[at_cmdTable[i] - 1];
+		if (hash == pNode->hash && cmdLen == pNode->fun.at_cmdLen
+				&& strncmp(pCmd, pNode->name, cmdLen) == 0) {
+			return pNode;
 		}
 	}
 	return NULL;
@@ -72,15 +205,12 @@ static tATNode* at_cmdSearch(int8_t cmdLen, const char *pCmd) {
  * @retval None
  */
 void at_cmdProcess(const char *pAtRcvData) {
-	uint8_t cmdLen;
+	int8_t cmdLen;
+	uint32_t hash = 0;
 	tATNode *pNode = NULL;
 
-	cmdLen = at_getCmdLen(pAtRcvData);
-	if (cmdLen != -1) {
-		pNode = at_cmdSearch(cmdLen, pAtRcvData);
-	} else {
-		pNode = NULL;
-	}
+	cmdLen = at_getCmdLen(pAtRcvData, &hash);
+	pNode = at_cmdSearch(cmdLen, hash, pAtRcvData);
 	if (pNode != NULL) {
 		pAtRcvData += cmdLen;
 		if (*pAtRcvData == '\r') {
@@ -115,6 +245,26 @@ void at_cmdProcess(const char *pAtRcvData) {
 	} else {
 		at_backError();
 	}
+	at_outFlush(); /* handler without final result code */
+}
+
+/**
+ * @brief  Final result code, write buffered response together with it.
+ *         A line of concatenated commands gets one final result code,
+ *         OK only after its last command.
+ * @retval None
+ */
+void at_backOk(void) {
+	if (!at_getSession()->chained) {
+		at_outPutData("\r\nOK\r\n", 6);
+	}
+	at_outFlush();
+}
+
+void at_backError(void) {
+	at_getSession()->failed = 1; /* rest of the line is not executed */
+	at_outPutData("\r\nERROR\r\n", 9);
+	at_outFlush();
 }
 
 /**
@@ -127,29 +277,54 @@ void at_regCallback(void (*sys_restart)(void)) {
 }
 
 /**
- * @brief  register user command
+ * @brief  register user command, the descriptor is copied
  * @param  new_atcmd: point to a user command
+ * @retval 0: success, -1: frozen, name too long or out of memory
+ */
+int at_regCommand(const at_funcationType *new_atcmd) {
+	return at_addCommand(new_atcmd);
+}
+
+/**
+ * @brief  Make room for count more commands at once, so that registering
+ *         them does not grow the command table and its index step by step.
+ * @param  count: number of commands about to be registered
+ * @retval 0: success, -1: frozen or out of memory
+ */
+int at_reserve(uint32_t count) {
+	if (at_cmdFrozen) {
+		return -1;
+	}
+	if (at_cmdCount + count > at_cmdArenaSize
+			&& at_arenaResize(at_cmdCount + count) < 0) {
+		return -1;
+	}
+	return at_indexResize(at_cmdCount + count);
+}
+
+/**
+ * @brief  Refuse further registration, the table is read-only from now on
+ *         and may be shared by threads. The table is not shrunk, moving it
+ *         costs more than the unused tail, use at_reserve for an exact size.
  * @retval None
  */
-void at_regCommand(at_funcationType *new_atcmd) {
-	tATNode* pNode = (tATNode*) malloc(sizeof(tATNode));
-	pNode->at_fun = new_atcmd;
-	pNode->pNext = NULL;
-	at_linkList->addListNode(at_linkList, (tLinkListNode*) pNode);
+void at_freeze(void) {
+	at_cmdFrozen = 1;
 }
 
 void at_init(void) {
 	int i = 0;
-	tATNode* pNode = NULL;
-	at_linkList = singleListInit();
 	for (i = 0; i < AT_BASICCMDNUM; i++) {
-		pNode = (tATNode*) malloc(sizeof(tATNode));
-		pNode->pNext = NULL;
-		pNode->at_fun = &at_basicfun[i];
-		at_linkList->addListNode(at_linkList, (tLinkListNode*) pNode);
+		at_addCommand(&at_basicfun[i]);
 	}
 }
 
 void at_destory() {
-	at_linkList->delLinkList(at_linkList);
+	free(at_cmdArena);
+	free(at_cmdTable);
+	at_cmdArena = NULL;
+	at_cmdTable = NULL;
+	at_cmdArenaSize = at_cmdCount = at_cmdTableSize = 0;
+	at_nullIndex = -1;
+	at_cmdFrozen = 0;
 }
@@ -10,23 +10,25 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include "AToutput.h"
 
 //ToDo
+#ifndef AT_NO_DEBUG
 #define AT_DEBUG
+#endif
 #ifdef AT_DEBUG
 #define at_debug(fmt,args...)		printf(fmt,##args)
 #else
 #define at_debug(fmt,args...)
 #endif
 
-//ToDo
-#define at_response(fmt,args...)	printf(fmt,##args)
+//responses are buffered, at_backOk/at_backError write them out
+#define at_response(fmt,args...)	at_outPrintf(fmt,##args)
 
 #define AT_VERSION_main   	0x00
 #define AT_VERSION_sub    	0x01
 #define AT_VERSION   		(AT_VERSION_main << 8 | AT_VERSION_sub)
 
-extern uint8_t echoFlag;	//whether to open echo
 extern void (*system_restart)(void);
 
 struct ATNode;
@@ -39,17 +41,26 @@ typedef struct {
 	void (*at_exeCmd)(struct ATNode*);
 } at_funcationType;
 
-typedef struct LinkListNode tLinkListNode;
+#define AT_CMD_NAME_SIZE	24	//longest command name, trailing '\0' included
+
+/*
+ * Registered command, descriptor and name are copied into the
+ * contiguous command table, at_fun points to the copy.
+ */
 typedef struct ATNode {
-	tLinkListNode *pNext;
 	at_funcationType *at_fun;
+	at_funcationType fun;
+	char name[AT_CMD_NAME_SIZE];
+	uint32_t hash;	//hash of name, compared before the name itself
 } tATNode;
 
-#define at_backOk()        	at_response("\r\nOK\r\n")
-#define at_backError()     	at_response("\r\nERROR\r\n")
+void at_backOk(void);
+void at_backError(void);
 
 void at_init(void);
-void at_regCommand(at_funcationType *new_atcmd);
+int at_regCommand(const at_funcationType *new_atcmd);
+int at_reserve(uint32_t count);
+void at_freeze(void);
 void at_cmdProcess(const char *pAtRcvData);
 void at_regCallback(void (*sys_restart)(void));
 void at_destory(void);
@@ -0,0 +1,303 @@
+/*
+ * AToutput.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "AToutput.h"
+
+/* each thread dispatching commands has its own selection and stdout buffer */
+static __thread tATOutput at_stdOutput = { .writev = at_outWriteFd, .arg =
+		(void*) (intptr_t) STDOUT_FILENO };
+static __thread tATOutput *at_curOutput = NULL;	//NULL: at_stdOutput
+
+/**
+ * @brief  Response buffer selected by calling thread.
+ */
+static inline tATOutput* at_outCurrent(void) {
+	return at_curOutput ? at_curOutput : &at_stdOutput;
+}
+
+void at_outInit(tATOutput *pOut, at_writevFunc writev, void *arg) {
+	pOut->len = 0;
+	pOut->writev = writev;
+	pOut->arg = arg;
+	pOut->writes = 0;
+	pOut->pend = NULL;
+	pOut->pendOff = pOut->pendLen = pOut->pendSize = 0;
+	pOut->error = 0;
+}
+
+void at_outFree(tATOutput *pOut) {
+	free(pOut->pend);
+	pOut->pend = NULL;
+	pOut->pendOff = pOut->pendLen = pOut->pendSize = 0;
+}
+
+tATOutput* at_outSelect(tATOutput *pOut) {
+	tATOutput *pPrev = at_curOutput;
+	at_curOutput = pOut;
+	return pPrev;
+}
+
+ssize_t at_outWriteFd(void *arg, const struct iovec *iov, int iovcnt) {
+	int fd = (int) (intptr_t) arg;
+	struct iovec vec[2];
+	ssize_t n, total = 0;
+	int i;
+
+	if (iovcnt > 2) {
+		iovcnt = 2;
+	}
+	memcpy(vec, iov, iovcnt * sizeof(struct iovec));
+	for (i = 0; i < iovcnt;) {
+		n = writev(fd, &vec[i], iovcnt - i);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) { /* non-blocking fd is full, caller keeps the rest */
+				return total;
+			}
+			return -1;
+		}
+		total += n;
+		while (i < iovcnt && (size_t) n >= vec[i].iov_len) {
+			n -= vec[i++].iov_len;
+		}
+		if (i < iovcnt) {
+			vec[i].iov_base = (char*) vec[i].iov_base + n;
+			vec[i].iov_len -= n;
+		}
+	}
+	return total;
+}
+
+/**
+ * @brief  Keep the part of iov the transport did not take.
+ * @param  pOut: response buffer
+ * @param  iov: data
+ * @param  cnt: number of iov
+ * @param  skip: bytes of iov already written
+ * @retval 0: success, -1: more than AT_OUTPUT_PENDING_MAX unsent bytes
+ */
+static int at_outKeep(tATOutput *pOut, const struct iovec *iov, int cnt,
+		size_t skip) {
+	uint32_t need = pOut->pendLen, size;
+	char *pNew;
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		need += iov[i].iov_len;
+	}
+	need -= skip;
+	if (need == pOut->pendLen) {
+		return 0;
+	}
+	if (need > AT_OUTPUT_PENDING_MAX) { /* peer does not read, give up */
+		return -1;
+	}
+	if (pOut->pendOff) { /* move unsent bytes to the front */
+		memmove(pOut->pend, pOut->pend + pOut->pendOff, pOut->pendLen);
+		pOut->pendOff = 0;
+	}
+	if (need > pOut->pendSize) {
+		for (size = pOut->pendSize ? pOut->pendSize : AT_OUTPUT_SIZE;
+				size < need; size *= 2)
+			;
+		pNew = (char*) realloc(pOut->pend, size);
+		if (pNew == NULL) {
+			return -1;
+		}
+		pOut->pend = pNew;
+		pOut->pendSize = size;
+	}
+	for (i = 0; i < cnt; i++) {
+		if (skip >= iov[i].iov_len) {
+			skip -= iov[i].iov_len;
+			continue;
+		}
+		memcpy(pOut->pend + pOut->pendLen, (char*) iov[i].iov_base + skip,
+				iov[i].iov_len - skip);
+		pOut->pendLen += iov[i].iov_len - skip;
+		skip = 0;
+	}
+	return 0;
+}
+
+int at_outResume(tATOutput *pOut) {
+	struct iovec iov;
+	ssize_t n;
+
+	if (pOut->pendLen == 0) {
+		return 0;
+	}
+	iov.iov_base = pOut->pend + pOut->pendOff;
+	iov.iov_len = pOut->pendLen;
+	pOut->writes++;
+	n = pOut->writev(pOut->arg, &iov, 1);
+	if (n < 0) {
+		pOut->error = 1;
+		return -1;
+	}
+	pOut->pendOff += n;
+	pOut->pendLen -= n;
+	if (pOut->pendLen == 0) {
+		pOut->pendOff = 0;
+	}
+	return pOut->pendLen ? 1 : 0;
+}
+
+/**
+ * @brief  Write buffer and extra data with one writev, keep what the
+ *         transport does not take.
+ * @param  pOut: response buffer
+ * @param  pData: extra data, may be NULL
+ * @param  len: length of extra data
+ * @retval 0: success, -1: transport error or too many unsent bytes
+ */
+static int at_outWrite(tATOutput *pOut, const char *pData, uint32_t len) {
+	struct iovec iov[2];
+	int cnt = 0, ret;
+	ssize_t n;
+
+	if (pOut->len) {
+		iov[cnt].iov_base = pOut->buf;
+		iov[cnt++].iov_len = pOut->len;
+	}
+	if (len) {
+		iov[cnt].iov_base = (void*) pData;
+		iov[cnt++].iov_len = len;
+	}
+	if (cnt == 0 || pOut->error) {
+		pOut->len = 0;
+		return pOut->error ? -1 : 0;
+	}
+	if (pOut->pendLen) { /* earlier bytes still wait for transport, keep order */
+		ret = at_outKeep(pOut, iov, cnt, 0);
+		pOut->len = 0;
+		pOut->error = ret < 0;
+		return ret;
+	}
+	if (pOut == &at_stdOutput) { /* keep order with at_debug printf */
+		fflush(stdout);
+	}
+	pOut->writes++;
+	n = pOut->writev(pOut->arg, iov, cnt);
+	ret = n < 0 ? -1 : at_outKeep(pOut, iov, cnt, n);
+	pOut->len = 0;
+	pOut->error = ret < 0;
+	return ret;
+}
+
+int at_outFlush(void) {
+	return at_outWrite(at_outCurrent(), NULL, 0);
+}
+
+void at_outPutData(const char *pData, uint32_t len) {
+	tATOutput *pOut = at_outCurrent();
+
+	if (len <= AT_OUTPUT_SIZE - pOut->len) {
+		memcpy(&pOut->buf[pOut->len], pData, len);
+		pOut->len += len;
+	} else {
+		at_outWrite(pOut, pData, len);
+	}
+}
+
+void at_outPutStr(const char *pStr) {
+	at_outPutData(pStr, strlen(pStr));
+}
+
+void at_outPutChar(char ch) {
+	tATOutput *pOut = at_outCurrent();
+
+	if (pOut->len == AT_OUTPUT_SIZE) {
+		at_outWrite(pOut, NULL, 0);
+	}
+	pOut->buf[pOut->len++] = ch;
+}
+
+void at_outPutUint(uint32_t value) {
+	char temp[10];
+	int i = sizeof(temp);
+
+	do {
+		temp[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	at_outPutData(&temp[i], sizeof(temp) - i);
+}
+
+void at_outPutInt(int32_t value) {
+	if (value < 0) {
+		at_outPutChar('-');
+		at_outPutUint(-(uint32_t) value);
+	} else {
+		at_outPutUint(value);
+	}
+}
+
+void at_outPutHex(uint32_t value, uint8_t width) {
+	static const char hex[] = "0123456789ABCDEF";
+	char temp[8];
+	int i = sizeof(temp);
+
+	if (width > sizeof(temp)) {
+		width = sizeof(temp);
+	}
+	do {
+		temp[--i] = hex[value & 0xF];
+		value >>= 4;
+	} while (value || sizeof(temp) - i < width);
+	at_outPutData(&temp[i], sizeof(temp) - i);
+}
+
+void at_outLineInt(const char *pName, int32_t value) {
+	at_outPutStr(pName);
+	at_outPutData(": ", 2);
+	at_outPutInt(value);
+	at_outPutData("\r\n", 2);
+}
+
+void at_outLineStr(const char *pName, const char *pValue) {
+	at_outPutStr(pName);
+	at_outPutData(": ", 2);
+	at_outPutStr(pValue);
+	at_outPutData("\r\n", 2);
+}
+
+void at_outPrintf(const char *fmt, ...) {
+	tATOutput *pOut = at_outCurrent();
+	uint32_t space = AT_OUTPUT_SIZE - pOut->len;
+	va_list args;
+	char *pTemp;
+	int n;
+
+	va_start(args, fmt);
+	n = vsnprintf(&pOut->buf[pOut->len], space, fmt, args);
+	va_end(args);
+	if (n < 0) {
+		return;
+	}
+	if ((uint32_t) n < space) {
+		pOut->len += n;
+		return;
+	}
+	/* does not fit, format to heap and write together with buffer */
+	pTemp = (char*) malloc(n + 1);
+	if (pTemp == NULL) {
+		return;
+	}
+	va_start(args, fmt);
+	vsnprintf(pTemp, n + 1, fmt, args);
+	va_end(args);
+	at_outPutData(pTemp, n);
+	free(pTemp);
+}
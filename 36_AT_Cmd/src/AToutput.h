@@ -0,0 +1,128 @@
+/*
+ * AToutput.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#ifndef ATOUTPUT_H_
+#define ATOUTPUT_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define AT_OUTPUT_SIZE		1024	//response bytes coalesced before a write
+#define AT_OUTPUT_PENDING_MAX	(64 * 1024)	//unsent bytes kept for a slow peer
+
+/*
+ * Write data of iov to transport. A non-blocking transport may write
+ * less than all of it, the rest is kept by the response buffer.
+ * @retval bytes written, -1 on error
+ */
+typedef ssize_t (*at_writevFunc)(void *arg, const struct iovec *iov,
+		int iovcnt);
+
+/*
+ * Response buffer of one session. Information lines and the final
+ * result code are collected here and go out with a single writev.
+ */
+typedef struct ATOutput {
+	char buf[AT_OUTPUT_SIZE];
+	uint16_t len;
+	at_writevFunc writev;
+	void *arg;
+	uint32_t writes;	//number of writev calls, for statistics
+	char *pend;	//bytes the transport did not take yet, in order
+	uint32_t pendOff;	//first unsent byte in pend
+	uint32_t pendLen;	//number of unsent bytes
+	uint32_t pendSize;	//capacity of pend
+	uint8_t error;	//transport failed or AT_OUTPUT_PENDING_MAX exceeded, output is dropped
+} tATOutput;
+
+/**
+ * @brief  Init response buffer.
+ * @param  pOut: response buffer
+ * @param  writev: transport write function
+ * @param  arg: argument of writev, file descriptor for at_outWriteFd
+ * @retval None
+ */
+void at_outInit(tATOutput *pOut, at_writevFunc writev, void *arg);
+
+/**
+ * @brief  Free unsent bytes of response buffer.
+ * @param  pOut: response buffer
+ * @retval None
+ */
+void at_outFree(tATOutput *pOut);
+
+/**
+ * @brief  Select response buffer of following responses of calling thread,
+ *         threads dispatching commands at the same time do not mix them.
+ * @param  pOut: response buffer, NULL for stdout
+ * @retval previous response buffer
+ */
+tATOutput* at_outSelect(tATOutput *pOut);
+
+/**
+ * @brief  Transport write function for file descriptors, returns early
+ *         instead of waiting when a non-blocking descriptor is full.
+ * @param  arg: file descriptor, cast with (void*)(intptr_t)
+ * @param  iov: data
+ * @param  iovcnt: number of iov
+ * @retval bytes written, -1 on error
+ */
+ssize_t at_outWriteFd(void *arg, const struct iovec *iov, int iovcnt);
+
+/**
+ * @brief  Write buffered responses to transport, what it does not take
+ *         is kept until at_outResume.
+ * @retval 0: success, -1: transport error or too many unsent bytes
+ */
+int at_outFlush(void);
+
+/**
+ * @brief  Number of bytes waiting for transport to become writable.
+ */
+#define at_outPending(pOut)	((pOut)->pendLen)
+
+/**
+ * @brief  Write unsent bytes again, when transport is writable.
+ * @param  pOut: response buffer
+ * @retval 0: all sent, 1: some still unsent, -1: transport error
+ */
+int at_outResume(tATOutput *pOut);
+
+/**
+ * @brief  Format response with printf style, slow path.
+ */
+void at_outPrintf(const char *fmt, ...)
+		__attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief  Append bytes to response.
+ * @param  pData: data
+ * @param  len: length of data, written at once with buffer if it does not fit
+ * @retval None
+ */
+void at_outPutData(const char *pData, uint32_t len);
+void at_outPutStr(const char *pStr);
+void at_outPutChar(char ch);
+void at_outPutInt(int32_t value);
+void at_outPutUint(uint32_t value);
+
+/**
+ * @brief  Append upper case hex number.
+ * @param  value: number
+ * @param  width: minimal number of digits, padded with '0'
+ * @retval None
+ */
+void at_outPutHex(uint32_t value, uint8_t width);
+
+/**
+ * @brief  Append one information line "<name>: <value>\r\n", e.g. "+CSQ: 21".
+ */
+void at_outLineInt(const char *pName, int32_t value);
+void at_outLineStr(const char *pName, const char *pValue);
+
+#endif /* ATOUTPUT_H_ */
@@ -0,0 +1,279 @@
+/*
+ * ATserver.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "ATserver.h"
+
+int at_serverInit(tATServer *pServer) {
+	struct epoll_event ev;
+
+	memset(pServer, 0, sizeof(tATServer));
+	pServer->epfd = epoll_create1(EPOLL_CLOEXEC);
+	pServer->asyncFd = at_asyncInit();
+	if (pServer->epfd < 0 || pServer->asyncFd < 0) {
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.ptr = &pServer->asyncFd;
+	return epoll_ctl(pServer->epfd, EPOLL_CTL_ADD, pServer->asyncFd, &ev);
+}
+
+/**
+ * @brief  Watch what a client can do next: wait for writable while
+ *         responses are unsent, stop reading while a deferred command has
+ *         filled the ring, otherwise read.
+ * @param  pSession: session of client
+ * @retval None
+ */
+static void at_serverArm(tATSession *pSession) {
+	tATServer *pServer = (tATServer*) pSession->user;
+	struct epoll_event ev;
+
+	if (at_outPending(&pSession->out) || pSession->out.error) { /* no more input until output is sent */
+		ev.events = EPOLLOUT;
+	} else if (pSession->pending && at_streamFree(&pSession->stream) == 0) {
+		ev.events = 0; /* leave input in socket buffer */
+	} else {
+		ev.events = EPOLLIN | EPOLLRDHUP;
+	}
+	if (ev.events == pSession->events) {
+		return;
+	}
+	pSession->events = ev.events;
+	ev.data.ptr = pSession;
+	epoll_ctl(pServer->epfd, EPOLL_CTL_MOD, pSession->fd, &ev);
+}
+
+/**
+ * @brief  Register listening socket in epoll.
+ * @param  pServer: server
+ * @param  fd: listening socket
+ * @retval 0: success, -1: failure
+ */
+static int at_serverAddListen(tATServer *pServer, int fd) {
+	struct epoll_event ev;
+
+	if (pServer->listenCount >= AT_SERVER_MAX_LISTEN || listen(fd, 128) < 0) {
+		close(fd);
+		return -1;
+	}
+	pServer->listenFd[pServer->listenCount] = fd;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &pServer->listenFd[pServer->listenCount];
+	if (epoll_ctl(pServer->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		close(fd);
+		return -1;
+	}
+	pServer->listenCount++;
+	return 0;
+}
+
+int at_serverListenTcp(tATServer *pServer, uint16_t port) {
+	struct sockaddr_in addr;
+	int on = 1;
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return at_serverAddListen(pServer, fd);
+}
+
+int at_serverListenUnix(tATServer *pServer, const char *pPath) {
+	struct sockaddr_un addr;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, pPath, sizeof(addr.sun_path) - 1);
+	unlink(pPath);
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return at_serverAddListen(pServer, fd);
+}
+
+/**
+ * @brief  Accept all pending clients of one listening socket.
+ * @param  pServer: server
+ * @param  listenFd: listening socket
+ * @retval None
+ */
+static void at_serverAccept(tATServer *pServer, int listenFd) {
+	struct epoll_event ev;
+	tATSession *pSession;
+	int fd, on = 1;
+
+	while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC))
+			>= 0) {
+		/* responses are already coalesced, send them at once */
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		pSession = (tATSession*) malloc(sizeof(tATSession));
+		if (pSession == NULL) {
+			close(fd);
+			continue;
+		}
+		at_sessionInit(pSession, at_outWriteFd, (void*) (intptr_t) fd);
+		pSession->fd = fd;
+		pSession->user = pServer;
+		pSession->events = ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.ptr = pSession;
+		if (epoll_ctl(pServer->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			close(fd);
+			free(pSession);
+			continue;
+		}
+		pServer->sessions++;
+	}
+}
+
+/**
+ * @brief  Close client connection and free its session.
+ * @param  pServer: server
+ * @param  pSession: session
+ * @retval None
+ */
+static void at_serverClose(tATServer *pServer, tATSession *pSession) {
+	at_asyncCancel(pSession);
+	epoll_ctl(pServer->epfd, EPOLL_CTL_DEL, pSession->fd, NULL);
+	close(pSession->fd);
+	at_outFree(&pSession->out);
+	free(pSession);
+	pServer->sessions--;
+}
+
+/**
+ * @brief  Read and execute what a client has sent, at most
+ *         AT_SERVER_READ_BUDGET bytes so that one busy client can not hold
+ *         the loop, the rest is read on the next wakeup.
+ * @param  pServer: server
+ * @param  pSession: session
+ * @retval None
+ */
+static void at_serverRead(tATServer *pServer, tATSession *pSession) {
+	char buf[AT_STREAM_RING_SIZE];
+	uint32_t size, budget = AT_SERVER_READ_BUDGET;
+	ssize_t n;
+
+	while (budget) {
+		/* while deferred, read only what can be queued in the ring */
+		size = pSession->pending ? at_streamFree(&pSession->stream) : sizeof(buf);
+		if (size > budget) {
+			size = budget;
+		}
+		if (size == 0 || at_outPending(&pSession->out)) {
+			break;
+		}
+		n = read(pSession->fd, buf, size);
+		if (n > 0) {
+			budget -= n;
+			at_sessionInput(pSession, buf, n);
+			if (pSession->out.error) { /* peer stopped reading responses */
+				at_serverClose(pServer, pSession);
+				return;
+			}
+			continue;
+		}
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && errno == EAGAIN) {
+			break;
+		}
+		at_serverClose(pServer, pSession); /* closed by client or error */
+		return;
+	}
+	at_serverArm(pSession);
+}
+
+/**
+ * @brief  Client is writable again, send unsent responses.
+ * @param  pServer: server
+ * @param  pSession: session
+ * @retval 0: session is still open, -1: closed
+ */
+static int at_serverWrite(tATServer *pServer, tATSession *pSession) {
+	if (at_outResume(&pSession->out) < 0 || pSession->out.error) {
+		at_serverClose(pServer, pSession);
+		return -1;
+	}
+	at_serverArm(pSession);
+	return 0;
+}
+
+/**
+ * @brief  Deferred command of a session is completed, its final result
+ *         may still be unsent, watch it again.
+ * @param  pSession: session
+ * @retval None
+ */
+static void at_serverResumed(tATSession *pSession) {
+	at_serverArm(pSession);
+}
+
+int at_serverRun(tATServer *pServer) {
+	struct epoll_event events[AT_SERVER_MAX_EVENTS];
+	int i, n;
+	void *ptr;
+
+	pServer->running = 1;
+	while (pServer->running) {
+		n = epoll_wait(pServer->epfd, events, AT_SERVER_MAX_EVENTS, 500);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		for (i = 0; i < n; i++) {
+			ptr = events[i].data.ptr;
+			if (ptr == &pServer->asyncFd) {
+				at_asyncDispatch(at_serverResumed);
+			} else if (ptr >= (void*) pServer->listenFd
+					&& ptr < (void*) &pServer->listenFd[AT_SERVER_MAX_LISTEN]) {
+				at_serverAccept(pServer, *(int*) ptr);
+			} else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+				/* reported even when nothing is armed, e.g. while a
+				 * deferred command has filled the ring: reading would
+				 * find no room and the event would come back at once */
+				at_serverClose(pServer, (tATSession*) ptr);
+			} else if (!(events[i].events & EPOLLOUT)
+					|| at_serverWrite(pServer, (tATSession*) ptr) == 0) {
+				if (events[i].events & ~EPOLLOUT) {
+					at_serverRead(pServer, (tATSession*) ptr);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+void at_serverStop(tATServer *pServer) {
+	pServer->running = 0;
+}
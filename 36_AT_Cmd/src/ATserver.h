@@ -0,0 +1,70 @@
+/*
+ * ATserver.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#ifndef ATSERVER_H_
+#define ATSERVER_H_
+
+#include <stdint.h>
+#include "ATsession.h"
+#include "ATasync.h"
+
+#define AT_SERVER_MAX_LISTEN	2
+#define AT_SERVER_MAX_EVENTS	64
+#define AT_SERVER_READ_BUDGET	4096	//bytes read from one client per wakeup
+
+/*
+ * Serve the registered AT command set to many TCP or UNIX-domain
+ * clients from one epoll thread, one tATSession per connection.
+ */
+typedef struct ATServer {
+	int epfd;
+	int listenFd[AT_SERVER_MAX_LISTEN];
+	int listenCount;
+	int asyncFd;	//completion of deferred commands
+	int sessions;	//number of connected clients
+	volatile uint8_t running;
+} tATServer;
+
+/**
+ * @brief  Init server, command set must be registered before at_serverRun.
+ * @param  pServer: server
+ * @retval 0: success, -1: failure
+ */
+int at_serverInit(tATServer *pServer);
+
+/**
+ * @brief  Listen on TCP port of all interfaces.
+ * @param  pServer: server
+ * @param  port: TCP port
+ * @retval 0: success, -1: failure
+ */
+int at_serverListenTcp(tATServer *pServer, uint16_t port);
+
+/**
+ * @brief  Listen on UNIX-domain stream socket, old socket file is removed.
+ * @param  pServer: server
+ * @param  pPath: socket file
+ * @retval 0: success, -1: failure
+ */
+int at_serverListenUnix(tATServer *pServer, const char *pPath);
+
+/**
+ * @brief  Accept clients and execute their commands until at_serverStop.
+ *         Deferred commands are completed in this thread too.
+ * @param  pServer: server
+ * @retval 0: stopped, -1: epoll failure
+ */
+int at_serverRun(tATServer *pServer);
+
+/**
+ * @brief  Ask at_serverRun to return, may be called from signal handler.
+ * @param  pServer: server
+ * @retval None
+ */
+void at_serverStop(tATServer *pServer);
+
+#endif /* ATSERVER_H_ */
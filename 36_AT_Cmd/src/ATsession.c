@@ -0,0 +1,55 @@
+/*
+ * ATsession.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <string.h>
+#include <unistd.h>
+#include "ATsession.h"
+
+/* like the response buffer, current session is selected per thread */
+static __thread tATSession at_console = { .out = { .writev = at_outWriteFd,
+		.arg = (void*) (intptr_t) STDOUT_FILENO }, .echo = 1, .fd = -1 };
+static __thread tATSession *at_curSession = NULL;	//NULL: at_console
+
+void at_sessionInit(tATSession *pSession, at_writevFunc writev, void *arg) {
+	memset(pSession, 0, sizeof(tATSession));
+	at_streamInit(&pSession->stream);
+	at_outInit(&pSession->out, writev, arg);
+	pSession->echo = 1;
+	pSession->fd = -1;
+}
+
+uint32_t at_sessionInput(tATSession *pSession, const char *pData,
+		uint32_t len) {
+	tATSession *pPrev = at_sessionSelect(pSession);
+	tATOutput *pPrevOut = at_outSelect(&pSession->out);
+	uint32_t n, total = 0;
+
+	do { /* ring may be smaller than received data */
+		if (len) {
+			n = at_streamWrite(&pSession->stream, pData, len);
+			pData += n;
+			len -= n;
+			total += n;
+		}
+		at_streamProcess(&pSession->stream);
+	} while (len && !pSession->pending);
+	if (len) { /* deferred, queue what still fits */
+		total += at_streamWrite(&pSession->stream, pData, len);
+	}
+	at_outSelect(pPrevOut);
+	at_sessionSelect(pPrev);
+	return total;
+}
+
+tATSession* at_getSession(void) {
+	return at_curSession ? at_curSession : &at_console;
+}
+
+tATSession* at_sessionSelect(tATSession *pSession) {
+	tATSession *pPrev = at_curSession;
+	at_curSession = pSession;
+	return pPrev;
+}
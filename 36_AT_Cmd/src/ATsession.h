@@ -0,0 +1,70 @@
+/*
+ * ATsession.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#ifndef ATSESSION_H_
+#define ATSESSION_H_
+
+#include <stdint.h>
+#include "ATcmd.h"
+#include "AToutput.h"
+#include "ATstream.h"
+
+struct ATToken;
+
+/*
+ * State of one AT console. The command table registered with
+ * at_regCommand is shared read-only by all sessions.
+ */
+typedef struct ATSession {
+	tATStream stream;	//input line assembler
+	tATOutput out;	//response buffer and transport
+	uint8_t echo;	//whether to open echo, set by ATE
+	struct ATToken *pending;	//deferred command, input waits until it completes
+	uint8_t chained;	//more commands of the line follow, OK of current one is not sent
+	uint8_t failed;	//a command of the line returned ERROR, the rest is skipped
+	int fd;	//transport descriptor, -1 when not used
+	uint32_t events;	//epoll events armed for fd, used by ATserver
+	void *user;	//user data
+} tATSession;
+
+/**
+ * @brief  Init session, echo is on.
+ * @param  pSession: session
+ * @param  writev: transport write function
+ * @param  arg: argument of writev
+ * @retval None
+ */
+void at_sessionInit(tATSession *pSession, at_writevFunc writev, void *arg);
+
+/**
+ * @brief  Feed received bytes to session and execute complete lines,
+ *         responses go to the session transport. While a command is
+ *         deferred bytes are only queued, as many as the ring holds.
+ * @param  pSession: session
+ * @param  pData: received bytes, may be NULL to execute queued input
+ * @param  len: number of bytes
+ * @retval number of bytes accepted
+ */
+uint32_t at_sessionInput(tATSession *pSession, const char *pData, uint32_t len);
+
+/**
+ * @brief  Session of the command being executed by calling thread, a console
+ *         session with stdout output when at_cmdProcess is called directly.
+ * @retval current session
+ */
+tATSession* at_getSession(void);
+
+/**
+ * @brief  Select session of following commands and final result codes of
+ *         calling thread, its response buffer is selected with at_outSelect
+ *         separately.
+ * @param  pSession: session, NULL for console session
+ * @retval previous session, NULL for console session
+ */
+tATSession* at_sessionSelect(tATSession *pSession);
+
+#endif /* ATSESSION_H_ */
@@ -0,0 +1,157 @@
+/*
+ * ATstream.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <string.h>
+#include "ATstream.h"
+#include "ATsession.h"
+
+#define AT_STREAM_MASK		(AT_STREAM_RING_SIZE - 1)
+
+/**
+ * @brief  Execute one line, commands may be concatenated with ';'.
+ *         Only the last command sends OK, the first ERROR ends the line.
+ *         When a command is deferred the rest waits in pStream->resume.
+ * @param  pStream: stream
+ * @param  index: first command in pStream->last
+ * @retval None
+ */
+static void at_streamExecute(tATStream *pStream, uint16_t index) {
+	tATSession *pSession = at_getSession();
+	char cmd[AT_STREAM_LINE_SIZE + 1];
+	const char *pBody = &pStream->last[index];
+	const char *pStart = pBody;
+	uint8_t quoted = 0, executed = index > 0;
+	uint16_t len;
+
+	pStream->resume = 0;
+	if (index == 0) {
+		pSession->failed = 0;
+	} else if (pSession->failed) { /* deferred command completed with ERROR */
+		pSession->chained = 0;
+		return;
+	}
+	for (;; pBody++) {
+		if (*pBody == '"') {
+			quoted = !quoted;
+		} else if ((*pBody == ';' && !quoted) || *pBody == '\0') {
+			len = pBody - pStart;
+			/* "AT" alone is a command, empty pieces around ';' are not */
+			if (len || (*pBody == '\0' && !executed)) {
+				memcpy(cmd, pStart, len);
+				cmd[len] = '\r';
+				cmd[len + 1] = '\0';
+				/* a non-empty command follows unless only ';' are left */
+				pSession->chained = pBody[strspn(pBody, ";")] != '\0';
+				at_cmdProcess(cmd);
+				executed = 1;
+				if (pSession->failed) {
+					break;
+				}
+				if (pSession->pending && pSession->chained) {
+					pStream->resume = pBody + 1 - pStream->last;
+					return;
+				}
+			}
+			if (*pBody == '\0') {
+				break;
+			}
+			pStart = pBody + 1;
+		}
+	}
+	pSession->chained = 0;
+}
+
+/**
+ * @brief  A complete line is received, check prefix and execute it.
+ * @param  pStream: stream
+ * @retval 1: line executed, 0: empty line ignored
+ */
+static int at_streamLine(tATStream *pStream) {
+	char *pLine = pStream->line;
+
+	pLine[pStream->lineLen] = '\0';
+	if (pStream->lineLen == 0 && !pStream->overflow) {
+		return 0;
+	}
+	if (pStream->overflow || (pLine[0] != 'A' && pLine[0] != 'a')
+			|| (pLine[1] != 'T' && pLine[1] != 't')) {
+		at_backError();
+		return 1;
+	}
+	strcpy(pStream->last, pLine + 2);
+	pStream->lastValid = 1;
+	at_streamExecute(pStream, 0);
+	return 1;
+}
+
+void at_streamInit(tATStream *pStream) {
+	memset(pStream, 0, sizeof(tATStream));
+}
+
+uint32_t at_streamWrite(tATStream *pStream, const char *pData, uint32_t len) {
+	uint32_t in = pStream->in;
+	uint32_t n = AT_STREAM_RING_SIZE - (in - pStream->out);
+	uint32_t first;
+
+	if (len > n) {
+		len = n;
+	}
+	first = AT_STREAM_RING_SIZE - (in & AT_STREAM_MASK);
+	if (first > len) {
+		first = len;
+	}
+	memcpy(&pStream->ring[in & AT_STREAM_MASK], pData, first);
+	memcpy(pStream->ring, pData + first, len - first);
+	__sync_synchronize(); /* data must be visible before index */
+	pStream->in = in + len;
+	return len;
+}
+
+int at_streamProcess(tATStream *pStream) {
+	int lines = 0;
+	char ch;
+
+	if (pStream->resume && !at_getSession()->pending) {
+		at_streamExecute(pStream, pStream->resume);
+	}
+	while (pStream->out != pStream->in && !at_getSession()->pending) {
+		ch = pStream->ring[pStream->out & AT_STREAM_MASK];
+		pStream->out++; /* free the byte for writer before executing */
+		if (at_getSession()->echo) { /* echo is buffered with the response */
+			at_outPutChar(ch);
+		}
+		if (ch == '\n' && pStream->lastCR) {
+			pStream->lastCR = 0;
+			continue;
+		}
+		pStream->lastCR = (ch == '\r');
+		if (ch == '\r' || ch == '\n') {
+			lines += at_streamLine(pStream);
+			pStream->lineLen = 0;
+			pStream->overflow = 0;
+		} else if (ch == '\b') {
+			if (pStream->lineLen) {
+				pStream->lineLen--;
+			}
+		} else if (ch == '/' && pStream->lineLen == 1
+				&& (pStream->line[0] == 'A' || pStream->line[0] == 'a')) {
+			/* "A/" repeats last line at once, no '\r' needed */
+			if (pStream->lastValid) {
+				at_streamExecute(pStream, 0);
+			} else { /* nothing to repeat yet */
+				at_backError();
+			}
+			lines++;
+			pStream->lineLen = 0;
+		} else if (pStream->lineLen < AT_STREAM_LINE_SIZE - 1) {
+			pStream->line[pStream->lineLen++] = ch;
+		} else {
+			pStream->overflow = 1;
+		}
+	}
+	at_outFlush(); /* echo of incomplete line */
+	return lines;
+}
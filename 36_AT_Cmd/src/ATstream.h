@@ -0,0 +1,62 @@
+/*
+ * ATstream.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+
+#ifndef ATSTREAM_H_
+#define ATSTREAM_H_
+
+#include <stdint.h>
+#include "ATcmd.h"
+
+#define AT_STREAM_RING_SIZE		512	//must be power of 2
+#define AT_STREAM_LINE_SIZE		256	//longest command line, "AT" excluded
+
+/*
+ * Assemble command lines from a byte stream (UART, socket...).
+ * One writer and one reader may run at the same time, so the next
+ * line can be received while the current one is executing.
+ */
+typedef struct ATStream {
+	char ring[AT_STREAM_RING_SIZE];
+	volatile uint32_t in;	//written by at_streamWrite
+	volatile uint32_t out;	//written by at_streamProcess
+	char line[AT_STREAM_LINE_SIZE];	//line being assembled
+	uint16_t lineLen;
+	uint8_t overflow;	//line longer than AT_STREAM_LINE_SIZE, discard it
+	uint8_t lastCR;	//last byte was '\r', ignore following '\n'
+	char last[AT_STREAM_LINE_SIZE];	//last executed line for "A/"
+	uint8_t lastValid;	//last holds a line, "A/" is an error before the first one
+	uint16_t resume;	//index of commands in last waiting for a deferred one, 0: none
+} tATStream;
+
+#define at_streamFree(pStream)	(AT_STREAM_RING_SIZE - ((pStream)->in - (pStream)->out))
+
+/**
+ * @brief  Reset stream state.
+ * @param  pStream: stream to init
+ * @retval None
+ */
+void at_streamInit(tATStream *pStream);
+
+/**
+ * @brief  Put received bytes into stream, may be called from receive thread.
+ * @param  pStream: stream
+ * @param  pData: received bytes
+ * @param  len: number of bytes
+ * @retval number of bytes accepted, less than len when ring is full
+ */
+uint32_t at_streamWrite(tATStream *pStream, const char *pData, uint32_t len);
+
+/**
+ * @brief  Echo received bytes and execute every complete command line.
+ *         Stops while a command of current session is deferred, the rest
+ *         of input stays in ring and is executed after at_complete.
+ * @param  pStream: stream
+ * @retval number of command lines executed
+ */
+int at_streamProcess(tATStream *pStream);
+
+#endif /* ATSTREAM_H_ */
@@ -0,0 +1,55 @@
+/*
+ * DList.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include "DList.h"
+
+tDListNode* dlist_find(const tDList *pList,
+		int (*match)(const tDListNode *pNode, void *args), void *args) {
+	const tDListNode *pNode;
+
+	for (pNode = pList->head.pNext; pNode != &pList->head;
+			pNode = pNode->pNext) {
+		if (match(pNode, args) == 0) {
+			return (tDListNode*) pNode;
+		}
+	}
+	return NULL;
+}
+
+tDListNode* dlist_at(const tDList *pList, int32_t m) {
+	const tDListNode *pNode = &pList->head;
+
+	if (m == 0 || (uint32_t) (m > 0 ? m : -m) > pList->count) {
+		return NULL;
+	}
+	if (m > 0) {
+		while (m--) {
+			pNode = pNode->pNext;
+		}
+	} else {
+		while (m++) {
+			pNode = pNode->pPrev;
+		}
+	}
+	return (tDListNode*) pNode;
+}
+
+int dlist_check(const tDList *pList) {
+	const tDListNode *pNode = &pList->head;
+	uint32_t n = 0;
+
+	/* a cycle not through head never comes back, stop after count + 1 steps */
+	do {
+		if (pNode->pNext == NULL || pNode->pNext->pPrev != pNode) {
+			return -1;
+		}
+		pNode = pNode->pNext;
+		if (pNode != &pList->head && ++n > pList->count) {
+			return -1;
+		}
+	} while (pNode != &pList->head);
+	return n == pList->count ? 0 : -1;
+}
@@ -0,0 +1,163 @@
+/*
+ * DList.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#ifndef DLIST_H_
+#define DLIST_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+/*
+ * Intrusive Doubly Linked List Node, embedded in user struct
+ */
+typedef struct DListNode {
+	struct DListNode *pNext;
+	struct DListNode *pPrev;
+} tDListNode;
+
+/*
+ * Intrusive Doubly Linked List, circular with head as sentinel
+ */
+typedef struct DList {
+	tDListNode head;
+	uint32_t count;
+} tDList;
+
+/*
+ * Get the user struct from its embedded node
+ */
+#define dlist_entry(pNode, type, member) \
+	((type*) ((char*) (pNode) - offsetof(type, member)))
+
+/*
+ * Walk list from head to tail, pNode must not be removed in the loop body
+ */
+#define dlist_forEach(pList, pNode) \
+	for ((pNode) = (pList)->head.pNext; (pNode) != &(pList)->head; \
+			(pNode) = (pNode)->pNext)
+
+/*
+ * Walk list from head to tail, pNode may be removed, pTemp is scratch
+ */
+#define dlist_forEachSafe(pList, pNode, pTemp) \
+	for ((pNode) = (pList)->head.pNext, (pTemp) = (pNode)->pNext; \
+			(pNode) != &(pList)->head; (pNode) = (pTemp), (pTemp) = (pNode)->pNext)
+
+/**
+ * @brief  Check links and count, for debugging
+ * @param  pList: point to list
+ * @retval 0: list is consistent
+ *   @arg -1: broken link, cycle not through head, or wrong count
+ */
+int dlist_check(const tDList *pList);
+
+/*
+ * Full consistency check costs O(n), only done with LIST_DEBUG defined,
+ * the same switch turns on circle checks of tLinkList
+ */
+#ifdef LIST_DEBUG
+#define DLIST_CHECK(pList)	assert(dlist_check(pList) == 0)
+#else
+#define DLIST_CHECK(pList)
+#endif
+
+/**
+ * @brief  Init an empty list
+ * @param  pList: point to list
+ */
+static inline void dlist_init(tDList *pList) {
+	pList->head.pNext = pList->head.pPrev = &pList->head;
+	pList->count = 0;
+}
+
+/**
+ * @brief  Insert node after pos, O(1)
+ * @param  pList: point to list
+ * @param  pPos: node in list or &pList->head
+ * @param  pNode: node to insert, must not be in any list
+ */
+static inline void dlist_insertAfter(tDList *pList, tDListNode *pPos,
+		tDListNode *pNode) {
+	assert(pPos->pNext->pPrev == pPos);
+	pNode->pPrev = pPos;
+	pNode->pNext = pPos->pNext;
+	pPos->pNext->pPrev = pNode;
+	pPos->pNext = pNode;
+	pList->count++;
+	DLIST_CHECK(pList);
+}
+
+static inline void dlist_pushFront(tDList *pList, tDListNode *pNode) {
+	dlist_insertAfter(pList, &pList->head, pNode);
+}
+
+static inline void dlist_pushBack(tDList *pList, tDListNode *pNode) {
+	dlist_insertAfter(pList, pList->head.pPrev, pNode);
+}
+
+/**
+ * @brief  Unlink node from list, O(1), the node is not freed
+ * @param  pList: point to list
+ * @param  pNode: node in list
+ */
+static inline void dlist_remove(tDList *pList, tDListNode *pNode) {
+	assert(pNode->pNext->pPrev == pNode && pNode->pPrev->pNext == pNode);
+	pNode->pPrev->pNext = pNode->pNext;
+	pNode->pNext->pPrev = pNode->pPrev;
+	pNode->pNext = pNode->pPrev = NULL;
+	pList->count--;
+	DLIST_CHECK(pList);
+}
+
+/**
+ * @brief  First node, or NULL when list is empty
+ */
+static inline tDListNode* dlist_first(const tDList *pList) {
+	return pList->head.pNext == &pList->head ? NULL : pList->head.pNext;
+}
+
+/**
+ * @brief  Last node, or NULL when list is empty
+ */
+static inline tDListNode* dlist_last(const tDList *pList) {
+	return pList->head.pPrev == &pList->head ? NULL : pList->head.pPrev;
+}
+
+/**
+ * @brief  Next node, or NULL at the end of list
+ */
+static inline tDListNode* dlist_next(const tDList *pList,
+		const tDListNode *pNode) {
+	return pNode->pNext == &pList->head ? NULL : pNode->pNext;
+}
+
+/**
+ * @brief  Previous node, or NULL at the start of list
+ */
+static inline tDListNode* dlist_prev(const tDList *pList,
+		const tDListNode *pNode) {
+	return pNode->pPrev == &pList->head ? NULL : pNode->pPrev;
+}
+
+/**
+ * @brief  Search node by condition given by user
+ * @param  pList: point to list
+ * @param  match: return 0 for the wanted node
+ * @param  args: argument transferd to match
+ * @retval pointer of the first matched node or NULL
+ */
+tDListNode* dlist_find(const tDList *pList,
+		int (*match)(const tDListNode *pNode, void *args), void *args);
+
+/**
+ * @brief  No.M node from head (m > 0) or from tail (m < 0), O(|m|)
+ * @param  pList: point to list
+ * @param  m: order number
+ * @retval pointer of the node or NULL
+ */
+tDListNode* dlist_at(const tDList *pList, int32_t m);
+
+#endif /* DLIST_H_ */
@@ -9,6 +9,17 @@
 
 #include <stdlib.h>
 
+//finding the circle walks the whole list, so search, next node and delete
+//node only look for it with LIST_DEBUG defined and otherwise stop at the NULL
+//tail; print, delete list and cross check always look for it
+#ifdef LIST_DEBUG
+#define CIRCLE_NODE(pList)	_CheckCircle(pList)
+#else
+#define CIRCLE_NODE(pList)	NULL
+#endif
+
+static tLinkListNode* _CheckCircle(tLinkList* pList);
+
 /**
  * @brief  add a node to the end of linklist
  * @param  pList: point to LinkList Object
@@ -48,7 +59,7 @@ static tLinkListNode* _SearchList(tLinkList *pList,
 	if (pList == NULL || SearchCondition == NULL) {
 		return NULL;
 	}
-	circleNode = pList->checkCircle(pList);
+	circleNode = CIRCLE_NODE(pList);
 	pNode = pList->pHead;
 	while (pNode != circleNode) {
 		if (SearchCondition(pNode, args) == 0) {
@@ -86,7 +97,7 @@ static tLinkListNode* _GetListNextNode(tLinkList *pList,
 	if (pList == NULL || pListNode == NULL) {
 		return NULL;
 	}
-	circleNode = pList->checkCircle(pList);
+	circleNode = CIRCLE_NODE(pList);
 	pNode = pList->pHead;
 	while (pNode != circleNode) {
 		if (pNode == pListNode) {
@@ -161,7 +172,7 @@ static int _DeleteListNode(tLinkList *pList,
 	if (pList == NULL || pList->SumOfNode == 0 || DeleteCondition == NULL) {
 		return -1;
 	}
-	circleNode = pList->checkCircle(pList);
+	circleNode = CIRCLE_NODE(pList);
 	pNode = pList->pHead;
 	if (DeleteCondition(pNode, args) == 0) {
 		//delete the head
@@ -305,6 +316,7 @@ static tLinkListNode* _SearchNodeMInverse(tLinkList* pList, uint32_t m) {
 static tLinkListNode* _CheckCircle(tLinkList* pList) {
 	tLinkListNode *pNode = NULL;
 	tLinkListNode *qNode = NULL;
+	uint8_t meet = 0;
 	if (pList == NULL) {
 		return NULL;
 	}
@@ -313,10 +325,12 @@ static tLinkListNode* _CheckCircle(tLinkList* pList) {
 		pNode = pNode->pNext;
 		qNode = qNode->pNext->pNext;
 		if (pNode == qNode) {
+			meet = 1;
 			break;
 		}
 	}
-	if (pNode == qNode && pNode != NULL) {
+	//a single node list starts with pNode == qNode too, only meeting means circle
+	if (meet) {
 		qNode = pList->pHead;
 		while (pNode != qNode) {
 			pNode = pNode->pNext;
@@ -380,16 +394,12 @@ static int _DeleteList(tLinkList *pList) {
 	pNode = pList->pHead;
 	pTemp = pNode;
 	while (pNode != circleNode) {
-		if (pNode == NULL) {
-			return 0;
-		}
 		pTemp = pNode;
 		pNode = pNode->pNext;
 		free(pTemp);
 	}
-	if (circleNode == NULL) {
-		return 0;
-	} else {
+	//the list object itself is freed in both cases
+	if (circleNode != NULL) {
 		pNode = pNode->pNext;
 		while (pNode != circleNode) {
 			pTemp = pNode;
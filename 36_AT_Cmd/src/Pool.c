@@ -0,0 +1,81 @@
+/*
+ * Pool.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <stdlib.h>
+#include "Pool.h"
+
+/* chunk header keeps blocks aligned for any type */
+#define POOL_HEADER		(sizeof(max_align_t))
+#define POOL_ALIGN(n)	(((n) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+void pool_init(tPool *pPool, size_t blockSize, uint32_t blocksPerChunk) {
+	if (blockSize < sizeof(void*)) {
+		blockSize = sizeof(void*);
+	}
+	pPool->blockSize = POOL_ALIGN(blockSize);
+	pPool->blocksPerChunk = blocksPerChunk ? blocksPerChunk : 1;
+	pPool->pFree = NULL;
+	pPool->pChunks = NULL;
+	pPool->used = 0;
+}
+
+/**
+ * @brief  Allocate a new chunk and put its blocks to free list
+ * @param  pPool: point to pool
+ * @retval 0: success, -1: out of memory
+ */
+static int pool_grow(tPool *pPool) {
+	char *pChunk = (char*) malloc(
+			POOL_HEADER + pPool->blockSize * pPool->blocksPerChunk);
+	char *pBlock;
+	uint32_t i;
+
+	if (pChunk == NULL) {
+		return -1;
+	}
+	*(void**) pChunk = pPool->pChunks;
+	pPool->pChunks = pChunk;
+	/* link blocks in address order, so new nodes are sequential in memory */
+	pBlock = pChunk + POOL_HEADER + pPool->blockSize * pPool->blocksPerChunk;
+	for (i = 0; i < pPool->blocksPerChunk; i++) {
+		pBlock -= pPool->blockSize;
+		*(void**) pBlock = pPool->pFree;
+		pPool->pFree = pBlock;
+	}
+	return 0;
+}
+
+void* pool_alloc(tPool *pPool) {
+	void *pBlock;
+
+	if (pPool->pFree == NULL && pool_grow(pPool) < 0) {
+		return NULL;
+	}
+	pBlock = pPool->pFree;
+	pPool->pFree = *(void**) pBlock;
+	pPool->used++;
+	return pBlock;
+}
+
+void pool_free(tPool *pPool, void *pBlock) {
+	if (pBlock == NULL) {
+		return;
+	}
+	*(void**) pBlock = pPool->pFree;
+	pPool->pFree = pBlock;
+	pPool->used--;
+}
+
+void pool_destroy(tPool *pPool) {
+	void *pChunk;
+
+	while ((pChunk = pPool->pChunks) != NULL) {
+		pPool->pChunks = *(void**) pChunk;
+		free(pChunk);
+	}
+	pPool->pFree = NULL;
+	pPool->used = 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Pool.h
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#ifndef POOL_H_
+#define POOL_H_
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed size block allocator, grows by chunks of blocks.
+ * Alloc and free are O(1), destroy frees all chunks at once.
+ */
+typedef struct Pool {
+	size_t blockSize;
+	uint32_t blocksPerChunk;
+	void *pFree;	//free blocks, linked through their first word
+	void *pChunks;	//allocated chunks, linked through their first word
+	uint32_t used;	//blocks in use
+} tPool;
+
+/**
+ * @brief  Init pool
+ * @param  pPool: point to pool
+ * @param  blockSize: size of one block, at least a pointer
+ * @param  blocksPerChunk: blocks allocated at once when pool is empty
+ */
+void pool_init(tPool *pPool, size_t blockSize, uint32_t blocksPerChunk);
+
+/**
+ * @brief  Get a block
+ * @param  pPool: point to pool
+ * @retval pointer of the block, NULL when out of memory
+ */
+void* pool_alloc(tPool *pPool);
+
+/**
+ * @brief  Give back a block got from the same pool
+ * @param  pPool: point to pool
+ * @param  pBlock: block, may be NULL
+ */
+void pool_free(tPool *pPool, void *pBlock);
+
+/**
+ * @brief  Free all chunks, every block of pool becomes invalid
+ * @param  pPool: point to pool
+ */
+void pool_destroy(tPool *pPool);
+
+#endif /* POOL_H_ */
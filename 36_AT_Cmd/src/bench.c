@@ -0,0 +1,228 @@
+/*
+ * bench.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ATcmd.h"
+#include "LinkList.h"
+
+#define BENCH_MAX_CMDS		4096
+#define BENCH_LOOKUPS		1000000
+#define BENCH_RESPONSES		200000
+#define BENCH_REGISTERS		100
+
+static at_funcationType benchFun[BENCH_MAX_CMDS];
+static char benchName[BENCH_MAX_CMDS][8];
+static char benchLine[BENCH_MAX_CMDS][10];
+static volatile uint32_t benchHits;
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void at_exeCmdBench(tATNode* pNode) {
+	benchHits++;
+}
+
+/* command node of the old list based registration */
+typedef struct BenchNode {
+	tLinkListNode *pNext;
+	at_funcationType *at_fun;
+} tBenchNode;
+
+/**
+ * @brief  Scan list the way at_cmdSearch did before hash index, as reference.
+ * @param  pList: list of registered commands
+ * @param  cmdLen: received length of command
+ * @param  pCmd: point to received command
+ * @retval the node address searched or NULL
+ */
+static tBenchNode* bench_listSearch(tLinkList *pList, int8_t cmdLen,
+		const char *pCmd) {
+	tBenchNode* pNode = (tBenchNode*) pList->pHead;
+	int i;
+
+	for (i = 0; i < pList->SumOfNode; i++) {
+		if (cmdLen == pNode->at_fun->at_cmdLen) {
+			if (strncmp(pCmd, pNode->at_fun->at_cmdName, cmdLen) == 0) {
+				return pNode;
+			}
+		}
+		pNode = (tBenchNode*) pNode->pNext;
+	}
+	return NULL;
+}
+
+/**
+ * @brief  Register n user commands into command table and freeze it.
+ * @param  n: number of user commands
+ * @param  reserve: 1: size the table with at_reserve first
+ * @retval None
+ */
+static void bench_register(int n, int reserve) {
+	int i;
+
+	at_init();
+	if (reserve) {
+		at_reserve(n);
+	}
+	for (i = 0; i < n; i++) {
+		at_regCommand(&benchFun[i]);
+	}
+	at_freeze();
+}
+
+/**
+ * @brief  Register n user commands into a list the way it was done before.
+ * @param  n: number of user commands
+ * @retval the list
+ */
+static tLinkList* bench_listRegister(int n) {
+	tLinkList *pList = singleListInit();
+	tBenchNode *pNode;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		pNode = (tBenchNode*) malloc(sizeof(tBenchNode));
+		pNode->pNext = NULL;
+		pNode->at_fun = &benchFun[i];
+		pList->addListNode(pList, (tLinkListNode*) pNode);
+	}
+	return pList;
+}
+
+/**
+ * @brief  Dispatch cost of hash index and of list scan with n user commands,
+ *         and the cost of registering and destroying them, averaged.
+ * @param  n: number of registered user commands
+ * @retval None
+ */
+static void bench_run(int n) {
+	tLinkList *pList;
+	tBenchNode *pNode;
+	double start, hash, scan, regArena, regReserved, regList;
+	uint32_t i, k;
+
+	start = Now();
+	for (i = 0; i < BENCH_REGISTERS; i++) {
+		bench_register(n, 0);
+		at_destory();
+	}
+	regArena = (Now() - start) / BENCH_REGISTERS;
+	start = Now();
+	for (i = 0; i < BENCH_REGISTERS; i++) {
+		bench_register(n, 1);
+		at_destory();
+	}
+	regReserved = (Now() - start) / BENCH_REGISTERS;
+	start = Now();
+	for (i = 0; i < BENCH_REGISTERS; i++) {
+		pList = bench_listRegister(n);
+		pList->delLinkList(pList);
+	}
+	regList = (Now() - start) / BENCH_REGISTERS;
+
+	bench_register(n, 1);
+	pList = bench_listRegister(n);
+
+	benchHits = 0;
+	start = Now();
+	for (i = 0, k = 0; i < BENCH_LOOKUPS; i++) {
+		at_cmdProcess(benchLine[k]);
+		k = (k + 7919) % n; /* visit all commands in scattered order */
+	}
+	hash = Now() - start;
+	if (benchHits != BENCH_LOOKUPS) {
+		printf("dispatch missed %u commands\r\n", BENCH_LOOKUPS - benchHits);
+	}
+
+	start = Now();
+	for (i = 0, k = 0; i < BENCH_LOOKUPS; i++) {
+		pNode = bench_listSearch(pList, 6, benchLine[k]);
+		pNode->at_fun->at_exeCmd(NULL);
+		k = (k + 7919) % n;
+	}
+	scan = Now() - start;
+
+	at_destory();
+	pList->delLinkList(pList);
+
+	printf("%5d commands: hash %5.1f ns/cmd, list %8.1f ns/cmd, "
+			"register+destroy arena %6.1f us, reserved %6.1f us, list %6.1f us\r\n",
+			n, hash * 1e9 / BENCH_LOOKUPS, scan * 1e9 / BENCH_LOOKUPS,
+			regArena * 1e6, regReserved * 1e6, regList * 1e6);
+}
+
+/**
+ * @brief  Response of three information lines and OK: printf per fragment
+ *         to the transport as before, and through response buffer.
+ * @retval None
+ */
+static void bench_output(void) {
+	int fd = open("/dev/null", O_WRONLY);
+	tATOutput out;
+	double start, direct, buffered;
+	int i;
+
+	start = Now();
+	for (i = 0; i < BENCH_RESPONSES; i++) {
+		dprintf(fd, "+CSQ: %d,%d\r\n", 21, 0);
+		dprintf(fd, "+CREG: %d,%d\r\n", 0, 1);
+		dprintf(fd, "+COPS: %d,%d,\"%s\"\r\n", 0, 0, "CHINA MOBILE");
+		dprintf(fd, "\r\nOK\r\n");
+	}
+	direct = Now() - start;
+
+	at_outInit(&out, at_outWriteFd, (void*) (intptr_t) fd);
+	at_outSelect(&out);
+	start = Now();
+	for (i = 0; i < BENCH_RESPONSES; i++) {
+		at_outPutStr("+CSQ: ");
+		at_outPutInt(21);
+		at_outPutChar(',');
+		at_outPutInt(0);
+		at_outPutData("\r\n", 2);
+		at_outPutStr("+CREG: ");
+		at_outPutInt(0);
+		at_outPutChar(',');
+		at_outPutInt(1);
+		at_outPutData("\r\n", 2);
+		at_outLineStr("+COPS", "0,0,\"CHINA MOBILE\"");
+		at_backOk();
+	}
+	buffered = Now() - start;
+	at_outSelect(NULL);
+	close(fd);
+
+	printf("response printf %.1f ns, buffered %.1f ns, %u writes\r\n",
+			direct * 1e9 / BENCH_RESPONSES, buffered * 1e9 / BENCH_RESPONSES,
+			out.writes);
+}
+
+int main(void) {
+	int i, n;
+
+	/* digits end the command name, so names are made of letters only */
+	for (i = 0; i < BENCH_MAX_CMDS; i++) {
+		sprintf(benchName[i], "+X%c%c%c%c", 'A' + i / 17576 % 26,
+				'A' + i / 676 % 26, 'A' + i / 26 % 26, 'A' + i % 26);
+		sprintf(benchLine[i], "%s\r\n", benchName[i]);
+		benchFun[i].at_cmdName = benchName[i];
+		benchFun[i].at_cmdLen = 6;
+		benchFun[i].at_exeCmd = at_exeCmdBench;
+	}
+	for (n = 4; n <= BENCH_MAX_CMDS; n *= 4) {
+		bench_run(n);
+	}
+	bench_output();
+	return EXIT_SUCCESS;
+}
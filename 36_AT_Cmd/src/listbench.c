@@ -0,0 +1,136 @@
+/*
+ * listbench.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "LinkList.h"
+#include "DList.h"
+#include "Pool.h"
+
+#define BENCH_SEARCHES		1000
+
+typedef struct Node {
+	tLinkListNode *pNext;
+	int data;
+} tNode;
+
+typedef struct Item {
+	tDListNode node;
+	int data;
+} tItem;
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int MatchOld(tLinkListNode *pNode, void *args) {
+	return ((tNode*) pNode)->data == *(int*) args ? 0 : -1;
+}
+
+static int MatchNew(const tDListNode *pNode, void *args) {
+	return dlist_entry(pNode, tItem, node)->data == *(int*) args ? 0 : -1;
+}
+
+/**
+ * @brief  Same operations on tLinkList and on tDList with tPool
+ * @param  n: number of nodes
+ */
+static void bench_run(int n) {
+	tLinkList *pOld = singleListInit();
+	tLinkListNode *pOldNode;
+	tNode *pNode;
+	tDList list;
+	tDListNode *pDNode;
+	tPool pool;
+	tItem **items = (tItem**) malloc(n * sizeof(tItem*));
+	double t[2][4], start;
+	volatile long sum = 0;
+	int i, key;
+
+	/* build */
+	start = Now();
+	for (i = 0; i < n; i++) {
+		pNode = (tNode*) malloc(sizeof(tNode));
+		pNode->pNext = NULL;
+		pNode->data = i;
+		pOld->addListNode(pOld, (tLinkListNode*) pNode);
+	}
+	t[0][0] = (Now() - start) / n;
+	dlist_init(&list);
+	pool_init(&pool, sizeof(tItem), 256);
+	start = Now();
+	for (i = 0; i < n; i++) {
+		items[i] = (tItem*) pool_alloc(&pool);
+		items[i]->data = i;
+		dlist_pushBack(&list, &items[i]->node);
+	}
+	t[1][0] = (Now() - start) / n;
+
+	/* search by key */
+	start = Now();
+	for (i = 0; i < BENCH_SEARCHES; i++) {
+		key = (i * 7919) % n;
+		sum += ((tNode*) pOld->searchList(pOld, MatchOld, &key))->data;
+	}
+	t[0][1] = (Now() - start) / BENCH_SEARCHES;
+	start = Now();
+	for (i = 0; i < BENCH_SEARCHES; i++) {
+		key = (i * 7919) % n;
+		sum += dlist_entry(dlist_find(&list, MatchNew, &key), tItem, node)->data;
+	}
+	t[1][1] = (Now() - start) / BENCH_SEARCHES;
+
+	/* walk with next */
+	start = Now();
+	for (pOldNode = pOld->pHead; pOldNode;
+			pOldNode = pOld->getListNextNode(pOld, pOldNode)) {
+		sum += ((tNode*) pOldNode)->data;
+	}
+	t[0][2] = (Now() - start) / n;
+	start = Now();
+	for (pDNode = dlist_first(&list); pDNode;
+			pDNode = dlist_next(&list, pDNode)) {
+		sum += dlist_entry(pDNode, tItem, node)->data;
+	}
+	t[1][2] = (Now() - start) / n;
+
+	/* remove all in scattered order */
+	start = Now();
+	for (i = 0; i < n; i++) {
+		key = (int) (((long) i * 7919) % n);
+		pOld->delListNode(pOld, MatchOld, &key);
+	}
+	t[0][3] = (Now() - start) / n;
+	start = Now();
+	for (i = 0; i < n; i++) {
+		key = (int) (((long) i * 7919) % n);
+		dlist_remove(&list, &items[key]->node);
+		pool_free(&pool, items[key]);
+	}
+	t[1][3] = (Now() - start) / n;
+
+	printf("%6d nodes   add    search      next    remove  (ns/op)\r\n", n);
+	for (i = 0; i < 2; i++) {
+		printf("%-12s %5.1f %9.1f %9.1f %9.1f\r\n",
+				i ? "  DList+Pool" : "  LinkList", t[i][0] * 1e9,
+				t[i][1] * 1e9, t[i][2] * 1e9, t[i][3] * 1e9);
+	}
+	pOld->delLinkList(pOld);
+	pool_destroy(&pool);
+	free(items);
+}
+
+int main(void) {
+	int n;
+
+	for (n = 100; n <= 10000; n *= 10) {
+		bench_run(n);
+	}
+	return EXIT_SUCCESS;
+}
@@ -6,7 +6,9 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ATcmd.h"
+#include "ATstream.h"
 
 static void sys_restart() {
 	at_debug("Now will restart...\r\n");
@@ -26,16 +28,21 @@ int main() {
 	at_cmdProcess("E0\r\n");
 	at_cmdProcess("+RST\r\n");
 
-	at_funcationType *newCmd = (at_funcationType*) malloc(
-			sizeof(at_funcationType));
-	newCmd->at_cmdName = "+WHO";
-	newCmd->at_cmdLen = 4;
-	newCmd->at_exeCmd = NULL;
-	newCmd->at_testCmd = NULL;
-	newCmd->at_setupCmd = NULL;
-	newCmd->at_queryCmd = at_queryCmdWho;
-	at_regCommand(newCmd);
+	/* descriptor is copied into command table, no need to keep it */
+	at_funcationType newCmd = { "+WHO", 4, NULL, at_queryCmdWho, NULL, NULL };
+	at_regCommand(&newCmd);
+	at_freeze();
 	at_cmdProcess("+WHO?\r\n");
+
+	/* bytes may arrive in any pieces, lines are executed when complete */
+	static tATStream stream;
+	const char *rx[] = { "ATE1\r\nAT+G", "MR;+WHO?\r", "\nA/", "at+XX\r" };
+	int i;
+	at_streamInit(&stream);
+	for (i = 0; i < sizeof(rx) / sizeof(rx[0]); i++) {
+		at_streamWrite(&stream, rx[i], strlen(rx[i]));
+		at_streamProcess(&stream);
+	}
 	at_destory();
 	return 0;
 }
@@ -0,0 +1,223 @@
+/*
+ * server.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ATcmd.h"
+#include "ATserver.h"
+
+#define CLIENT_MAX_CONNS	1024
+
+static tATServer server;
+
+/* one emulated device of load test, waits for OK before next command */
+typedef struct Client {
+	int fd;
+	int sent;
+	uint8_t match;	//bytes of "OK\r\n" matched so far
+} tClient;
+
+static tClient clients[CLIENT_MAX_CONNS];
+
+static void sys_restart() {
+}
+
+/* AT+SLOW=<ms> completes after ms in another thread */
+typedef struct SlowJob {
+	tATToken *pToken;
+	int ms;
+} tSlowJob;
+
+static void* slow_work(void *arg) {
+	tSlowJob *pJob = (tSlowJob*) arg;
+	usleep(pJob->ms * 1000);
+	at_complete(pJob->pToken, "+SLOW: done\r\n", 1);
+	free(pJob);
+	return NULL;
+}
+
+static void at_setupCmdSlow(tATNode* pNode, const char *pPara) {
+	tSlowJob *pJob;
+	pthread_t tid;
+
+	if (*pPara != '=' || (pJob = (tSlowJob*) malloc(sizeof(tSlowJob))) == NULL) {
+		at_backError();
+		return;
+	}
+	pJob->ms = atoi(pPara + 1);
+	pJob->pToken = at_defer();
+	if (pJob->pToken == NULL) {
+		free(pJob);
+		return;
+	}
+	if (pthread_create(&tid, NULL, slow_work, pJob) != 0) {
+		at_complete(pJob->pToken, NULL, 0);
+		free(pJob);
+		return;
+	}
+	pthread_detach(tid);
+}
+
+static at_funcationType slowCmd = { "+SLOW", 5, NULL, NULL, at_setupCmdSlow,
+NULL };
+
+static void stop(int sig) {
+	at_serverStop(&server);
+}
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Usage(char *arg) {
+	printf("Usage:%s t/T port\r\n", arg);
+	printf("Usage:%s u/U path\r\n", arg);
+	printf("Usage:%s c/C port connections commands\r\n", arg);
+}
+
+/**
+ * @brief  Count final result codes in received data.
+ * @param  pClient: connection
+ * @param  pData: received data
+ * @param  len: length of data
+ * @retval number of "OK\r\n" received
+ */
+static int client_countOk(tClient *pClient, const char *pData, ssize_t len) {
+	static const char ok[] = "OK\r\n";
+	int count = 0;
+
+	while (len-- > 0) {
+		if (*pData == ok[pClient->match]) {
+			if (++pClient->match == 4) {
+				pClient->match = 0;
+				count++;
+			}
+		} else {
+			pClient->match = (*pData == 'O');
+		}
+		pData++;
+	}
+	return count;
+}
+
+/**
+ * @brief  Many connections each send commands one at a time.
+ * @param  port: server TCP port
+ * @param  conns: number of connections
+ * @param  count: commands per connection
+ * @retval None
+ */
+static void client_run(uint16_t port, int conns, int count) {
+	struct sockaddr_in addr;
+	struct epoll_event ev, events[64];
+	char buf[1024];
+	int epfd = epoll_create1(0);
+	int i, j, n, done = 0, total = conns * count;
+	double start;
+	ssize_t len;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	start = Now();
+	for (i = 0; i < conns; i++) {
+		clients[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(clients[i].fd, (struct sockaddr*) &addr, sizeof(addr))
+				< 0) {
+			perror("connect");
+			exit(1);
+		}
+		ev.events = EPOLLIN;
+		ev.data.ptr = &clients[i];
+		epoll_ctl(epfd, EPOLL_CTL_ADD, clients[i].fd, &ev);
+		write(clients[i].fd, "ATE0\r", 5);
+		clients[i].sent = 1;
+	}
+	while (done < total) {
+		n = epoll_wait(epfd, events, 64, 5000);
+		if (n <= 0) {
+			printf("timeout, %d of %d commands done\r\n", done, total);
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			tClient *pClient = (tClient*) events[i].data.ptr;
+			len = read(pClient->fd, buf, sizeof(buf));
+			if (len <= 0) {
+				perror("read");
+				exit(1);
+			}
+			for (j = client_countOk(pClient, buf, len); j > 0; j--) {
+				done++;
+				if (pClient->sent < count) {
+					write(pClient->fd, "AT+GMR\r", 7);
+					pClient->sent++;
+				}
+			}
+		}
+	}
+	start = Now() - start;
+	printf("%d connections, %d commands, %.3f s, %.0f cmd/s\r\n", conns, done,
+			start, done / start);
+	for (i = 0; i < conns; i++) {
+		close(clients[i].fd);
+	}
+	close(epfd);
+}
+
+int main(int argc, char **argv) {
+	int ret;
+
+	if (argc < 3) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	if (!strncasecmp(argv[1], "c", 1)) {
+		if (argc < 5 || atoi(argv[3]) <= 0 || atoi(argv[3]) > CLIENT_MAX_CONNS) {
+			Usage(argv[0]);
+			exit(1);
+		}
+		client_run(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+		return 0;
+	}
+
+	at_init();
+	at_regCallback(sys_restart);
+	at_regCommand(&slowCmd);
+	at_freeze(); /* shared read-only by all sessions */
+	if (at_serverInit(&server) < 0) {
+		perror("at_serverInit");
+		exit(1);
+	}
+	if (!strncasecmp(argv[1], "t", 1)) {
+		ret = at_serverListenTcp(&server, atoi(argv[2]));
+	} else if (!strncasecmp(argv[1], "u", 1)) {
+		ret = at_serverListenUnix(&server, argv[2]);
+	} else {
+		Usage(argv[0]);
+		exit(1);
+	}
+	if (ret < 0) {
+		perror("listen");
+		exit(1);
+	}
+	signal(SIGINT, stop);
+	signal(SIGPIPE, SIG_IGN);
+	at_serverRun(&server);
+	at_destory();
+	return 0;
+}
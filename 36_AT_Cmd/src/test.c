@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "ATcmd.h"
 #include "LinkList.h"
 
 typedef struct Node {
@@ -52,6 +54,71 @@ static void PrintStrategy(tLinkListNode *pNode) {
 	printf("%d\n", childNode->data);
 }
 
+static int atRan = 0;	//which test command handler ran last
+
+static void at_exeCmdFirst(tATNode *pNode) {
+	atRan = 1;
+	at_backOk();
+}
+
+static void at_exeCmdSecond(tATNode *pNode) {
+	atRan = 2;
+	at_backOk();
+}
+
+static void at_exeCmdLate(tATNode *pNode) {
+	atRan = 3;
+	at_backOk();
+}
+
+/**
+ * @brief  Dispatch one command line and check which handler ran.
+ * @param  pLine: command line without "AT"
+ * @param  expect: handler expected to run, 0: none
+ * @retval 0: as expected, 1: failure
+ */
+static int AtCheck(const char *pLine, int expect) {
+	atRan = 0;
+	at_cmdProcess(pLine);
+	printf("AT%.*s -> %d, expect %d%s\n", (int) strcspn(pLine, "\r"), pLine,
+			atRan, expect, atRan == expect ? "" : "  FAILED");
+	return atRan != expect;
+}
+
+/**
+ * @brief  Commands are found through hash index before and after at_freeze,
+ *         the first of commands with the same name wins.
+ * @retval number of failures
+ */
+static int AtTest(void) {
+	static const at_funcationType first = { "+TST", 4, NULL, NULL, NULL,
+			at_exeCmdFirst };
+	static const at_funcationType second = { "+TST", 4, NULL, NULL, NULL,
+			at_exeCmdSecond };
+	static const at_funcationType other = { "+TSX", 4, NULL, NULL, NULL,
+			at_exeCmdSecond };
+	static const at_funcationType late = { "+LATE", 5, NULL, NULL, NULL,
+			at_exeCmdLate };
+	int i, failed = 0;
+
+	at_init();
+	at_regCommand(&first);
+	for (i = 0; i < 200; i++) { /* grow table and index past initial size */
+		at_regCommand(&second);
+	}
+	at_regCommand(&other);
+	failed += AtCheck("+TST\r", 1); /* before at_freeze */
+	failed += AtCheck("+TSX\r", 2);
+	at_freeze();
+	failed += AtCheck("+TST\r", 1); /* read-only table */
+	failed += AtCheck("+TSX\r", 2);
+	failed += AtCheck("+TSY\r", 0);
+	failed += at_regCommand(&late) == 0;
+	failed += AtCheck("+LATE\r", 0);
+	at_destory();
+	return failed;
+}
+
 int main(void) {
 	int i = 0;
 	tLinkList *list = singleListInit();
@@ -118,5 +185,7 @@ int main(void) {
 	list->delLinkList(list);
 	pNode = NULL;
 	list = NULL;
-	return EXIT_SUCCESS;
+
+	printf("--------------------------\n");
+	return AtTest() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
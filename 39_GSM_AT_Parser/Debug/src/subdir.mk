@@ -7,21 +7,33 @@ C_SRCS += \
 ../src/Buffer.c \
 ../src/GSM_AT_Parser.c \
 ../src/gsm_ll.c \
+../src/gsm_manager.c \
+../src/gsm_sim.c \
+../src/gsm_stats.c \
 ../src/gsm_sys.c \
+../src/gsm_urc.c \
 ../src/main.c 
 
 OBJS += \
 ./src/Buffer.o \
 ./src/GSM_AT_Parser.o \
 ./src/gsm_ll.o \
+./src/gsm_manager.o \
+./src/gsm_sim.o \
+./src/gsm_stats.o \
 ./src/gsm_sys.o \
+./src/gsm_urc.o \
 ./src/main.o 
 
 C_DEPS += \
 ./src/Buffer.d \
 ./src/GSM_AT_Parser.d \
 ./src/gsm_ll.d \
+./src/gsm_manager.d \
+./src/gsm_sim.d \
+./src/gsm_stats.d \
 ./src/gsm_sys.d \
+./src/gsm_urc.d \
 ./src/main.d 
 
 
@@ -192,6 +192,38 @@ uint32_t BUFFER_Read(BUFFER_t* Buffer, void* Data, uint32_t count) {
 	return (i + count); /* Return number of elements stored in memory */
 }
 
+uint32_t BUFFER_GetLinearBlock(BUFFER_t* Buffer, const uint8_t** Data) {
+	uint32_t full, linear;
+
+	if (Buffer == NULL) {
+		return 0;
+	}
+	if (Buffer->Out >= Buffer->Size) { /* Check output pointer */
+		Buffer->Out = 0;
+	}
+	full = BUFFER_GetFull(Buffer);
+	linear = Buffer->Size - Buffer->Out; /* Elements till end of buffer */
+	if (linear > full) {
+		linear = full;
+	}
+	*Data = &Buffer->Buffer[Buffer->Out];
+	return linear;
+}
+
+uint32_t BUFFER_Skip(BUFFER_t* Buffer, uint32_t count) {
+	uint32_t full;
+
+	if (Buffer == NULL) {
+		return 0;
+	}
+	full = BUFFER_GetFull(Buffer);
+	if (count > full) {
+		count = full;
+	}
+	Buffer->Out = (Buffer->Out + count) % Buffer->Size; /* Move output pointer */
+	return count;
+}
+
 int32_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element) {
 	uint32_t Num, Out, retval = 0;
 
@@ -110,6 +110,22 @@ uint32_t BUFFER_WriteToTop(BUFFER_t* Buffer, const void* Data, uint32_t count);
  */
 uint32_t BUFFER_Read(BUFFER_t* Buffer, void* Data, uint32_t count);
 
+/**
+ * 获取从读取指针开始可以连续访问的数据，不移动读取指针
+ * @param  Buffer Buffer_t对象指针
+ * @param  Data   返回连续数据的起始地址
+ * @return        连续数据的大小，环形缓冲区回绕时小于已经利用的内存大小
+ */
+uint32_t BUFFER_GetLinearBlock(BUFFER_t* Buffer, const uint8_t** Data);
+
+/**
+ * 丢弃Buffer中的数据，一般在直接访问连续数据之后调用
+ * @param  Buffer Buffer_t对象指针
+ * @param  count  要丢弃的数据大小
+ * @return        实际丢弃的数据大小
+ */
+uint32_t BUFFER_Skip(BUFFER_t* Buffer, uint32_t count);
+
 /**
  * 在Buffer中寻找元素
  * @param  Buffer  Buffet_t对象指针
@@ -8,27 +8,16 @@
  ============================================================================
  */
 #include "GSM_AT_Parser.h"
+#include "Buffer.h"
 #include "pt/pt.h"
 #include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-typedef struct {
-	uint8_t Length;
-	uint8_t Data[128];
-} Received_t;
-
-#define RECEIVED_ADD(c)   	do { Received.Data[Received.Length++] = (c); Received.Data[Received.Length] = 0; } while (0)
-#define RECEIVED_RESET()    do { Received.Length = 0; Received.Data[0] = 0; } while (0)
-#define RECEIVED_LENGTH()   Received.Length
-
-typedef struct {
-	volatile const void* CPtr1;
-	volatile const void* CPtr2;
-	volatile const void* CPtr3;
-	volatile void* Ptr1;
-	volatile void* Ptr2;
-	volatile void* Ptr3;
-	volatile uint32_t UI;
-} Pointers_t;
+#define RECEIVED_ADD(c)   	do { if (GSM->Received.Length < sizeof(GSM->Received.Data) - 1) { GSM->Received.Data[GSM->Received.Length++] = (c); GSM->Received.Data[GSM->Received.Length] = 0; } } while (0)
+#define RECEIVED_RESET()    do { GSM->Received.Length = 0; GSM->Received.Data[0] = 0; } while (0)
+#define RECEIVED_LENGTH()   GSM->Received.Length
 
 #define CHARISNUM(x)          	((x) >= '0' && (x) <= '9')
 #define CHARISHEXNUM(x)         (((x) >= '0' && (x) <= '9') || ((x) >= 'a' && (x) <= 'f') || ((x) >= 'A' && (x) <= 'F'))
@@ -176,75 +165,48 @@ typedef struct {
 #define CMD_OP_COPS_SET                     ((uint16_t)0x0822)
 #define CMD_IS_ACTIVE_OP(p)                 ((p)->ActiveCmd >= 0x0800 && (p)->ActiveCmd < 0x0900)
 
-#define __IS_BUSY(p)                        ((p)->ActiveCmd != CMD_IDLE || (p)->Flags.F.Call_Idle != 0)
+#define __IS_BUSY(p)                        (GSM_CMDQueue_Count(&(p)->CmdQueue) >= GSM_CMD_QUEUE_SIZE)
 #define __IS_READY(p)                       (!__IS_BUSY(p))
 #define __CHECK_BUSY(p)                     do { if (__IS_BUSY(p)) { __RETURN(p, gsmBUSY); } } while (0)
 #define __CHECK_INPUTS(c)                   do { if (!(c)) { __RETURN(GSM, gsmPARERROR); } } while (0)
 
-#if GSM_RTOS == 1
-#define __IDLE(GSM)                         do {    \
-    if (GSM_SYS_Release((GSM_RTOS_SYNC_t *)&(GSM)->Sync)) { \
-    }                                           \
-    (GSM)->ActiveCmd = CMD_IDLE;                \
-    __RESET_THREADS(GSM);                       \
-    if (!(GSM)->Flags.F.IsBlocking) {           \
-        (GSM)->Flags.F.Call_Idle = 1;           \
-    }                                           \
-    memset((void *)&Pointers, 0x00, sizeof(Pointers));  \
-} while (0)
+#if GSM_RTOS
+#define __LOCK(GSM)                         GSM_SYS_Request((GSM_RTOS_SYNC_t *)&(GSM)->Sync)
+#define __UNLOCK(GSM)                       GSM_SYS_Release((GSM_RTOS_SYNC_t *)&(GSM)->Sync)
 #else
+#define __LOCK(GSM)
+#define __UNLOCK(GSM)
+#endif
+
+#define __RESET_THREADS(GSM)                do { PT_INIT(&(GSM)->PT_CMD); } while (0)
+
 #define __IDLE(GSM)                         do {    \
     (GSM)->ActiveCmd = CMD_IDLE;                \
     __RESET_THREADS(GSM);                       \
-    if (!(GSM)->Flags.F.IsBlocking) {           \
+    if (!GSM_CMDQueue_Count(&(GSM)->CmdQueue)) {\
         (GSM)->Flags.F.Call_Idle = 1;           \
     }                                           \
-    memset((void *)&Pointers, 0x00, sizeof(Pointers));  \
+    memset((void *)&(GSM)->Pointers, 0x00, sizeof((GSM)->Pointers));  \
 } while (0)
-#endif
 
-#if GSM_RTOS
-#define __ACTIVE_CMD(GSM, cmd)              do {\
-    if (GSM_SYS_Request((GSM_RTOS_SYNC_t *)&(GSM)->Sync)) { \
-        return gsmTIMEOUT;                      \
-    }                                           \
-    if ((GSM)->ActiveCmd == CMD_IDLE) {         \
-        (GSM)->ActiveCmdStart = (GSM)->Time;    \
-    }                                           \
-    (GSM)->ActiveCmd = (cmd);                   \
-} while (0)
-#else
 #define __ACTIVE_CMD(GSM, cmd)        do {      \
     if ((GSM)->ActiveCmd == CMD_IDLE) {         \
         (GSM)->ActiveCmdStart = (GSM)->Time;    \
     }                                           \
     (GSM)->ActiveCmd = (cmd);                   \
 } while (0)
-#endif
 
 #define __CMD_SAVE(GSM)                       (GSM)->ActiveCmdSaved = (GSM)->ActiveCmd
 #define __CMD_RESTORE(GSM)                    (GSM)->ActiveCmd = (GSM)->ActiveCmdSaved
 
+#define __CMD_HEAD(GSM)                       (&(GSM)->CmdQueue.Items[(GSM)->CmdQueue.Out & (GSM_CMD_QUEUE_SIZE - 1)])
+#define __CMD_TAIL(GSM)                       (&(GSM)->CmdQueue.Items[(GSM)->CmdQueue.In & (GSM_CMD_QUEUE_SIZE - 1)])
+#define __CMD_IS_TIMEOUT(GSM)                 ((uint32_t)((GSM)->Time - (GSM)->ActiveCmdStart) > (GSM)->ActiveCmdTimeout)
+
 #define __RETURN(GSM, val)                      do { (GSM)->RetVal = (val); return (val); } while (0)
-#define __RETURN_BLOCKING(GSM, b, mt) do {      \
-    GSM_Result_t res;                           \
-    (GSM)->ActiveCmdTimeout = mt;               \
-    if (!(b)) {                                 \
-        (GSM)->Flags.F.IsBlocking = 0;          \
-        __RETURN(GSM, gsmOK);                   \
-    }                                           \
-    (GSM)->Flags.F.IsBlocking = 1;              \
-    res = GSM_WaitReady(GSM, mt);               \
-    if (res == gsmTIMEOUT) {                    \
-        return gsmTIMEOUT;                      \
-    }                                           \
-    res = (GSM)->ActiveResult;                  \
-    (GSM)->ActiveResult = gsmOK;                \
-    return res;                                 \
-} while (0)
 
 #define __RST_EVENTS_RESP(p)                    do { (p)->Events.Value = 0; } while (0)
-#define __CALL_CALLBACK(p, evt)                 (p)->Callback(evt, (GSM_EventParams_t *)&(p)->CallbackParams)
+#define __CALL_CALLBACK(p, evt)                 (p)->Callback((p), evt, (GSM_EventParams_t *)&(p)->CallbackParams)
 
 #define GSM_EXECUTE_SIM_READY_CHECK(GSM)  \
 if ((GSM)->CPIN != GSM_CPIN_Ready) {                        /* SIM must be ready to call */     \
@@ -285,3 +247,1292 @@ if ((GSM)->NetworkStatus != GSM_NetworkStatus_RegisteredHome && \
         PT_EXIT(pt);                                        /* Stop execution */                \
     }                                                                                           \
 }
+
+/* 命令名字与命令代码的对应表，用于根据AT字符串识别命令 */
+typedef struct {
+	const char* Name; //AT之后的命令名字
+	uint16_t Cmd; //命令代码
+} CMD_Name_t;
+
+static const CMD_Name_t CMD_Names[] = {
+	{ "", CMD_GEN_AT },
+	{ "E0", CMD_GEN_ATE0 },
+	{ "E1", CMD_GEN_ATE1 },
+	{ "&F", CMD_GEN_FACTORY_SETTINGS },
+	{ "+CMEE", CMD_GEN_ERROR_NUMERIC },
+	{ "+CFUN", CMD_GEN_CFUN },
+	{ "+CLCC", CMD_GEN_CALL_CLCC },
+	{ "+CNMI", CMD_GEN_SMSNOTIFY },
+	{ "+CPIN", CMD_PIN },
+	{ "+CMGF", CMD_SMS_CMGF },
+	{ "+CMGS", CMD_SMS_CMGS },
+	{ "+CMGR", CMD_SMS_CMGR },
+	{ "+CMGD", CMD_SMS_CMGD },
+	{ "+CMGDA", CMD_SMS_MASSDELETE },
+	{ "+CMGL", CMD_SMS_LIST },
+	{ "A", CMD_CALL_ANSWER },
+	{ "H", CMD_CALL_HANGUP },
+	{ "D", CMD_CALL_VOICE },
+	{ "+CGMM", CMD_INFO_CGMM },
+	{ "+CGMI", CMD_INFO_CGMI },
+	{ "+CGMR", CMD_INFO_CGMR },
+	{ "+CNUM", CMD_INFO_CNUM },
+	{ "+CGSN", CMD_INFO_CGSN },
+	{ "+GMR", CMD_INFO_GMR },
+	{ "+CBC", CMD_INFO_CBC },
+	{ "+CSQ", CMD_INFO_CSQ },
+	{ "+CPBW", CMD_PB_ADD },
+	{ "+CPBR", CMD_PB_GET },
+	{ "+CPBF", CMD_PB_SEARCH },
+	{ "+CCLK", CMD_DATETIME_GET },
+	{ "+CIPSHUT", CMD_GPRS_CIPSHUT },
+	{ "+CGATT", CMD_GPRS_CGATT },
+	{ "+CGACT", CMD_GPRS_CGACT },
+	{ "+SAPBR", CMD_GPRS_SAPBR },
+	{ "+CIICR", CMD_GPRS_CIICR },
+	{ "+CIFSR", CMD_GPRS_CIFSR },
+	{ "+CSTT", CMD_GPRS_CSTT },
+	{ "+CIPMUX", CMD_GPRS_CIPMUX },
+	{ "+CIPSTATUS", CMD_GPRS_CIPSTATUS },
+	{ "+CIPSTART", CMD_GPRS_CIPSTART },
+	{ "+CIPSEND", CMD_GPRS_CIPSEND },
+	{ "+CIPCLOSE", CMD_GPRS_CIPCLOSE },
+	{ "+CIPRXGET", CMD_GPRS_CIPRXGET },
+	{ "+CIPSSL", CMD_GPRS_CIPSSL },
+	{ "+CIPGSMLOC", CMD_GPRS_CIPGSMLOC },
+	{ "+HTTPINIT", CMD_GPRS_HTTPINIT },
+	{ "+HTTPPARA", CMD_GPRS_HTTPPARA },
+	{ "+HTTPDATA", CMD_GPRS_HTTPDATA },
+	{ "+HTTPACTION", CMD_GPRS_HTTPACTION },
+	{ "+HTTPREAD", CMD_GPRS_HTTPREAD },
+	{ "+HTTPTERM", CMD_GPRS_HTTPTERM },
+	{ "+HTTPSSL", CMD_GPRS_HTTPSSL },
+	{ "+CREG", CMD_GPRS_CREG },
+	{ "+FTPCID", CMD_GPRS_FTPCID },
+	{ "+FTPSERV", CMD_GPRS_FTPSERV },
+	{ "+FTPPORT", CMD_GPRS_FTPPORT },
+	{ "+FTPUN", CMD_GPRS_FTPUN },
+	{ "+FTPPW", CMD_GPRS_FTPPW },
+	{ "+FTPPUTNAME", CMD_GPRS_FTPPUTNAME },
+	{ "+FTPPUTPATH", CMD_GPRS_FTPPUTPATH },
+	{ "+FTPPUT", CMD_GPRS_FTPPUT },
+	{ "+FTPGETPATH", CMD_GPRS_FTPGETPATH },
+	{ "+FTPGETNAME", CMD_GPRS_FTPGETNAME },
+	{ "+FTPGET", CMD_GPRS_FTPGET },
+	{ "+FTPPUTOPT", CMD_GPRS_FTPPUTOPT },
+	{ "+FTPQUIT", CMD_GPRS_FTPQUIT },
+	{ "+FTPMODE", CMD_GPRS_FTPMODE },
+	{ "+FTPSSL", CMD_GPRS_FTPSSL },
+	{ "+COPS", CMD_OP_COPS_READ },
+};
+
+/**
+ * 将字符串(只包含十进制数字)转换成整数
+ * @param  ptr 带转换的字符串
+ * @param  cnt 总共转换了多少个字符
+ * @return     返回转换后的数字
+ */
+static int32_t ParseNumber(const char* ptr, uint8_t* cnt) {
+	uint8_t minus = 0, i = 0;
+	int32_t sum = 0;
+
+	if (*ptr == '-') { //判断是否是负数
+		minus = 1;
+		ptr++;
+		i++;
+	}
+	while (CHARISNUM(*ptr)) { /* Parse number */
+		sum = 10 * sum + CHARTONUM(*ptr);
+		ptr++;
+		i++;
+	}
+	if (cnt != NULL) { /* Save number of characters used for number */
+		*cnt = i;
+	}
+	if (minus) { /* Minus detected */
+		return -sum;
+	}
+	return sum; /* Return number */
+}
+
+/**
+ * 根据AT命令字符串得到命令代码
+ * @param  AT AT命令字符串，如"AT+CSQ"
+ * @return    命令代码，未知命令返回CMD_GEN_AT
+ */
+static uint16_t CMD_Lookup(const char* AT) {
+	uint8_t len = 0, i;
+
+	if (strncasecmp(AT, "AT", 2) != 0) {
+		return CMD_GEN_AT;
+	}
+	AT += 2;
+	/* 命令名字到'='，'?'或者字符串结尾为止 */
+	while (AT[len] && AT[len] != '=' && AT[len] != '?') {
+		len++;
+	}
+	for (i = 0; i < sizeof(CMD_Names) / sizeof(CMD_Names[0]); i++) {
+		if (strlen(CMD_Names[i].Name) == len
+				&& strncasecmp(AT, CMD_Names[i].Name, len) == 0) {
+			return CMD_Names[i].Cmd;
+		}
+	}
+	if (*AT == 'D' || *AT == 'd') { /* ATD<number>; */
+		return CMD_CALL_VOICE;
+	}
+	return CMD_GEN_AT;
+}
+
+const char* GSM_CMD_Name(uint16_t Cmd) {
+	uint8_t i;
+
+	for (i = 0; i < sizeof(CMD_Names) / sizeof(CMD_Names[0]); i++) {
+		if (CMD_Names[i].Cmd == Cmd) {
+			return CMD_Names[i].Name;
+		}
+	}
+	if (Cmd == CMD_CALL_VOICE) {
+		return "D";
+	}
+	return NULL;
+}
+
+/**
+ * 获取队列尾部的空闲命令项，填写完成后调用CMD_Commit使其生效
+ * @param  GSM GSM工作结构体指针
+ * @return     空闲命令项，队列满返回NULL
+ */
+static GSM_CMD_t* CMD_Alloc(GSM_t* GSM) {
+	GSM_CMD_t* cmd;
+
+	if (__IS_BUSY(GSM)) {
+		return NULL;
+	}
+	cmd = __CMD_TAIL(GSM);
+	memset(cmd, 0x00, sizeof(GSM_CMD_t));
+	cmd->Timeout = GSM_CMD_TIMEOUT;
+	return cmd;
+}
+
+/**
+ * 使CMD_Alloc得到的命令项生效，并通知GSM_Update所在的线程
+ * @param GSM GSM工作结构体指针
+ */
+static void CMD_Commit(GSM_t* GSM) {
+	GSM->CmdQueue.In++;
+	if (GSM->Callback) {
+		__CALL_CALLBACK(GSM, gsmEventCmdQueued);
+	}
+}
+
+/**
+ * 将中间返回行保存到当前命令的Resp缓存中
+ * @param GSM GSM工作结构体指针
+ * @param cmd 当前命令
+ */
+static void CMD_SaveResp(GSM_t* GSM, GSM_CMD_t* cmd) {
+	uint16_t len = RECEIVED_LENGTH(), avail;
+
+	if (cmd->Resp == NULL || cmd->RespLength + 1 >= cmd->RespSize) {
+		return;
+	}
+	avail = cmd->RespSize - cmd->RespLength - 1; /* 保留结尾的0 */
+	if (len + 1 > avail) { /* 缓存不够，截断 */
+		len = avail - 1;
+	}
+	memcpy(&cmd->Resp[cmd->RespLength], GSM->Received.Data, len);
+	cmd->RespLength += len;
+	cmd->Resp[cmd->RespLength++] = '\n';
+	cmd->Resp[cmd->RespLength] = 0;
+}
+
+/**
+ * 把队首命令的Data写入发送队列，发送队列满时记下位置，下次继续
+ * @param  GSM GSM工作结构体指针
+ * @param  cmd 当前命令
+ * @return     全部写入返回1，否则返回0
+ */
+static uint8_t CMD_SendData(GSM_t* GSM, GSM_CMD_t* cmd) {
+	if (GSM->TxSent < cmd->DataLen) {
+		GSM->TxSent += UART_SEND(cmd->Data + GSM->TxSent,
+				cmd->DataLen - GSM->TxSent);
+		if (GSM->TxSent < cmd->DataLen) {
+			return 0;
+		}
+	}
+	if (cmd->Cmd == CMD_SMS_CMGS && GSM->TxSent == cmd->DataLen) {
+		if (UART_SEND_CH("\x1A") == 0) { /* Ctrl+Z结束短信 */
+			return 0;
+		}
+		GSM->TxSent++;
+	}
+	return 1;
+}
+
+/**
+ * 队首命令执行完成，调用回调并出队
+ * @param GSM    GSM工作结构体指针
+ * @param result 执行结果
+ */
+static void CMD_Complete(GSM_t* GSM, GSM_Result_t result) {
+	GSM_CMD_t* cmd = __CMD_HEAD(GSM);
+
+#if GSM_STATS
+	if (GSM->Stats != NULL) {
+		uint64_t now = GSM_Stats_Now();
+		GSM_Stats_Record(GSM->Stats, cmd->Cmd,
+				GSM->StatsFirstByte ?
+						(uint32_t) (GSM->StatsFirstByte - GSM->StatsIssued) :
+						GSM_STATS_NO_DATA, (uint32_t) (now - GSM->StatsIssued),
+				result == gsmOK ? 0 : result == gsmERROR ? 1 : 2,
+				GSM->StatsResumes);
+	}
+#endif /* GSM_STATS */
+	GSM->ActiveResult = result;
+	if (cmd->Callback) {
+		cmd->Callback(GSM, result, cmd);
+	}
+	GSM->RawRemaining = 0; /* 超时时可能还在原始数据模式 */
+	GSM->CmdQueue.Out++; /* 出队，空出位置 */
+	__IDLE(GSM);
+#if GSM_RTOS
+	GSM_SYS_EventSignal((GSM_RTOS_EVENT_t *) &GSM->CmdDone); /* 唤醒GSM_CMD_Execute和GSM_WaitReady */
+#endif
+}
+
+/**
+ * 从数据长度头中解析后面跟随的原始数据字节数
+ * @param  str  长度头，如"+HTTPREAD: 1024"
+ * @param  type 行类型
+ * @return      原始数据字节数，不是数据长度头返回0
+ */
+static uint32_t RAW_ParseLength(const char* str, uint8_t type) {
+	int32_t num[4];
+	uint8_t cnt, n = 0;
+
+	str = strchr(str, ':');
+	while (str && n < 4) {
+		str++;
+		while (*str == ' ') {
+			str++;
+		}
+		num[n++] = ParseNumber(str, &cnt);
+		str = strchr(str + cnt, ',');
+	}
+	if (type == GSM_URC_HTTPREAD && n >= 1) { /* +HTTPREAD: <data_len> */
+		return num[0] > 0 ? num[0] : 0;
+	}
+	if (n < 2 || num[0] != 2) { /* 模式1是有数据可读的通知 */
+		return 0;
+	}
+	if (type == GSM_URC_FTPGET) { /* +FTPGET: 2,<cnflength> */
+		return num[1] > 0 ? num[1] : 0;
+	}
+	/* +CIPRXGET: 2,[<id>,]<reqlength>,<cnflength> */
+	num[0] = n == 4 ? num[2] : num[1];
+	return num[0] > 0 ? num[0] : 0;
+}
+
+/**
+ * 统计搬运到接收目标的原始数据，更新速率并调用进度回调
+ * @param GSM    GSM工作结构体指针
+ * @param sink   接收目标
+ * @param stored 保存下来的字节数
+ * @param total  收到的字节数
+ */
+static void RAW_Account(GSM_t* GSM, GSM_Sink_t* sink, uint32_t stored,
+		uint32_t total) {
+	uint32_t elapsed;
+
+	sink->Length += stored;
+	sink->Dropped += total - stored;
+	GSM->RawRemaining -= total;
+	GSM->ActiveCmdStart = GSM->Time; /* 收到数据，重新计算超时 */
+	elapsed = GSM->Time - sink->StartTime;
+	if (elapsed > 0) {
+		sink->BytesPerSecond = (uint32_t) ((uint64_t) (sink->Length
+				+ sink->Dropped) * 1000 / elapsed);
+	}
+	if (sink->Progress) {
+		sink->Progress(GSM, sink);
+	}
+}
+
+/**
+ * 原始数据模式下把环形缓存中连续的一块数据直接搬运到接收目标
+ * @param  GSM GSM工作结构体指针
+ * @return     搬运的字节数，环形缓存为空返回0
+ */
+static uint32_t RAW_Process(GSM_t* GSM) {
+	GSM_Sink_t* sink = __CMD_HEAD(GSM)->Sink;
+	const uint8_t* data;
+	uint32_t len, stored;
+	ssize_t n;
+
+	len = BUFFER_GetLinearBlock(&GSM->Buffer, &data);
+	if (len > GSM->RawRemaining) {
+		len = GSM->RawRemaining;
+	}
+	if (len == 0) {
+		return 0;
+	}
+	if (sink->Data != NULL) {
+		stored = sink->Size - sink->Length;
+		if (stored > len) {
+			stored = len;
+		}
+		memcpy(&sink->Data[sink->Length], data, stored);
+	} else {
+		for (stored = 0; stored < len; stored += n) {
+			n = write(sink->FD, data + stored, len - stored);
+			if (n <= 0) { /* 写入失败的数据丢弃 */
+				break;
+			}
+		}
+	}
+	BUFFER_Skip(&GSM->Buffer, len);
+	RAW_Account(GSM, sink, stored, len);
+	return len;
+}
+
+#if GSM_SMS
+/* AT+CMGL的短信类型参数，按GSM_SMS_ReadType_t排列 */
+static const char* SMS_StatText[] = { "ALL", "REC READ", "REC UNREAD",
+		"STO SENT", "STO UNSENT" };
+static const uint8_t SMS_StatPDU[] = { 4, 1, 0, 3, 2 };
+/* AT+CMGDA的参数，按GSM_SMS_MassDelete_t排列 */
+static const char* SMS_DeleteText[] = { "DEL READ", "DEL UNREAD", "DEL SENT",
+		"DEL UNSENT", "DEL INBOX", "DEL ALL" };
+
+/**
+ * 在字符池中保存一个字符串
+ * @param  batch 批量读取结果
+ * @param  str   字符串
+ * @param  len   字符串长度
+ * @return       保存的位置，字符池已满返回NULL
+ */
+static const char* SMS_ArenaAdd(GSM_SMS_Batch_t* batch, const char* str,
+		uint16_t len) {
+	char* ptr;
+
+	if (batch->ArenaUsed + len + 1 > batch->ArenaSize) {
+		return NULL;
+	}
+	ptr = &batch->Arena[batch->ArenaUsed];
+	memcpy(ptr, str, len);
+	ptr[len] = 0;
+	batch->ArenaUsed += len + 1;
+	return ptr;
+}
+
+/**
+ * 取出下一个逗号分隔的字段，带引号的字段去掉引号
+ * @param  ptr 当前位置，返回下一个字段的位置，没有下一个字段时为NULL
+ * @param  len 返回字段长度
+ * @return     字段起始位置
+ */
+static const char* SMS_NextField(const char** ptr, uint16_t* len) {
+	const char* p = *ptr;
+	const char* start;
+
+	if (p == NULL) {
+		*len = 0;
+		return "";
+	}
+	if (*p == '"') {
+		start = ++p;
+		while (*p && *p != '"') {
+			p++;
+		}
+		*len = p - start;
+		if (*p == '"') {
+			p++;
+		}
+	} else {
+		start = p;
+		while (*p && *p != ',') {
+			p++;
+		}
+		*len = p - start;
+	}
+	*ptr = *p == ',' ? p + 1 : NULL;
+	return start;
+}
+
+/**
+ * 解析短信状态字段
+ * @param  str 字段
+ * @param  len 字段长度
+ * @param  pdu 是否是PDU模式
+ * @return     短信状态
+ */
+static GSM_SMS_ReadType_t SMS_ParseStatus(const char* str, uint16_t len,
+		uint8_t pdu) {
+	uint8_t i, stat = 0xFF;
+
+	if (pdu) {
+		stat = ParseNumber(str, NULL);
+	}
+	for (i = GSM_SMS_ReadType_READ; i <= GSM_SMS_ReadType_UNSENT; i++) {
+		if (pdu ? SMS_StatPDU[i] == stat :
+				len == strlen(SMS_StatText[i])
+						&& strncmp(str, SMS_StatText[i], len) == 0) {
+			return (GSM_SMS_ReadType_t) i;
+		}
+	}
+	return GSM_SMS_ReadType_ALL;
+}
+
+/**
+ * 解析短信时间，格式为yy/MM/dd,hh:mm:ss+zz
+ * @param str 时间字段
+ * @param len 字段长度
+ * @param dt  解析结果
+ */
+static void SMS_ParseDateTime(const char* str, uint16_t len,
+		GSM_DateTime_t* dt) {
+	if (len < 17) {
+		return;
+	}
+	dt->Date.Year = 2000 + ParseNumber(&str[0], NULL);
+	dt->Date.Month = ParseNumber(&str[3], NULL);
+	dt->Date.Day = ParseNumber(&str[6], NULL);
+	dt->Time.Hours = ParseNumber(&str[9], NULL);
+	dt->Time.Minutes = ParseNumber(&str[12], NULL);
+	dt->Time.Seconds = ParseNumber(&str[15], NULL);
+}
+
+/**
+ * 丢弃正在解析的短信，并跳过它的内容行
+ * @param batch 批量读取结果
+ * @param mark  这条短信在字符池中的起始位置，为NULL时没有占用字符池
+ */
+static void SMS_Drop(GSM_SMS_Batch_t* batch, const char* mark) {
+	if (mark != NULL) { /* 收回字符池空间 */
+		batch->ArenaUsed = mark - batch->Arena;
+	}
+	batch->Dropped++;
+	batch->Skip = 1;
+}
+
+/**
+ * AT+CMGL的中间返回行解析函数
+ * 文本模式：+CMGL: <index>,<stat>,<oa>,<alpha>,<scts>，后面是一行或多行内容
+ * PDU模式：+CMGL: <index>,<stat>,[<alpha>],<length>，后面是一行PDU
+ */
+static void SMS_ParseList(GSM_t* GSM, GSM_CMD_t* cmd, const char* line,
+		uint16_t len, uint8_t type) {
+	GSM_SMS_Batch_t* batch = (GSM_SMS_Batch_t *) cmd->Context;
+	GSM_SMS_Entry_t* entry;
+	const char* ptr;
+	const char* field;
+	const char* mark;
+	uint16_t flen;
+
+	if (type == GSM_URC_CMGL) { /* 新的一条短信 */
+		cmd->RawLine = 1; /* 内容可能是"OK"、"RING"或者以AT开头，不能分类 */
+		if (batch->Count >= batch->MaxEntries) {
+			SMS_Drop(batch, NULL);
+			return;
+		}
+		entry = &batch->Entries[batch->Count];
+		memset(entry, 0x00, sizeof(GSM_SMS_Entry_t));
+		entry->Memory = GSM_SMS_Memory_SM;
+		entry->Number = entry->Name = "";
+		mark = &batch->Arena[batch->ArenaUsed];
+		ptr = line + 6;
+		while (*ptr == ' ') {
+			ptr++;
+		}
+		field = SMS_NextField(&ptr, &flen);
+		entry->Position = ParseNumber(field, NULL);
+		field = SMS_NextField(&ptr, &flen);
+		entry->Status = SMS_ParseStatus(field, flen, batch->PDU);
+		if (batch->PDU) {
+			SMS_NextField(&ptr, &flen); /* 电话簿中的名字，PDU模式下一般为空 */
+			field = SMS_NextField(&ptr, &flen);
+			entry->PDULength = ParseNumber(field, NULL);
+		} else {
+			field = SMS_NextField(&ptr, &flen);
+			entry->Number = SMS_ArenaAdd(batch, field, flen);
+			field = SMS_NextField(&ptr, &flen);
+			entry->Name = SMS_ArenaAdd(batch, field, flen);
+			field = SMS_NextField(&ptr, &flen);
+			SMS_ParseDateTime(field, flen, &entry->DateTime);
+			if (entry->Number == NULL || entry->Name == NULL) {
+				SMS_Drop(batch, mark);
+				return;
+			}
+		}
+		batch->Count++;
+		batch->Skip = 0;
+		return;
+	}
+	if (batch->Skip || batch->Count == 0) {
+		return;
+	}
+	entry = &batch->Entries[batch->Count - 1];
+	mark = batch->PDU ? entry->Data : entry->Number; /* 这条短信在字符池中的起始位置 */
+	if (len >= GSM_RECEIVED_MAX_LENGTH - 1) { /* 行缓存已满，内容被截断，整条丢弃 */
+		batch->Count--;
+		SMS_Drop(batch, mark);
+		return;
+	}
+	if (entry->Data == NULL) { /* 第一行内容 */
+		entry->Data = SMS_ArenaAdd(batch, line, len);
+		if (entry->Data == NULL) {
+			batch->Count--;
+			SMS_Drop(batch, mark);
+			return;
+		}
+		entry->DataLen = len;
+	} else if (batch->ArenaUsed + len + 1 <= batch->ArenaSize) { /* 多行内容，上一行在字符池末尾，直接扩展 */
+		batch->Arena[batch->ArenaUsed - 1] = '\n';
+		memcpy(&batch->Arena[batch->ArenaUsed], line, len);
+		batch->ArenaUsed += len;
+		batch->Arena[batch->ArenaUsed++] = 0;
+		entry->DataLen += len + 1;
+	} else { /* 字符池放不下后面的内容，不保留不完整的短信 */
+		batch->Count--;
+		SMS_Drop(batch, mark);
+	}
+}
+
+/**
+ * 把Batch中从Deleted开始的短信位置用分号连接成一条AT+CMGD命令加入队列，
+ * 一条命令行可以删除多条短信，减少往返次数
+ * @param  GSM   GSM工作结构体指针
+ * @param  batch 批量读取结果
+ * @param  arg   用户回调函数的参数
+ * @return       这条命令删除的短信数量，队列满返回0
+ */
+static uint16_t SMS_DeleteChunk(GSM_t* GSM, GSM_SMS_Batch_t* batch,
+		void* arg);
+
+/**
+ * AT+CMGD命令完成回调，成功时继续删除剩下的短信，全部完成或者出错时调用用户回调
+ */
+static void SMS_DeleteNext(GSM_t* GSM, GSM_Result_t Result,
+		const GSM_CMD_t* Cmd) {
+	GSM_SMS_Batch_t* batch = (GSM_SMS_Batch_t *) Cmd->Context;
+
+	if (Result == gsmOK) {
+		batch->Deleted += batch->Deleting;
+		batch->Deleting = 0;
+		if (batch->Deleted < batch->Count) {
+			batch->Deleting = SMS_DeleteChunk(GSM, batch, Cmd->Arg);
+			if (batch->Deleting) {
+				return;
+			}
+			Result = gsmBUSY; /* 队列被其他命令占满，可以再次调用GSM_SMS_DeleteBatch继续 */
+		}
+	}
+	batch->Deleting = 0;
+	if (batch->Callback) {
+		batch->Callback(GSM, Result, Cmd);
+	}
+}
+
+static uint16_t SMS_DeleteChunk(GSM_t* GSM, GSM_SMS_Batch_t* batch,
+		void* arg) {
+	GSM_CMD_t* cmd = CMD_Alloc(GSM);
+	uint16_t i = batch->Deleted, len = 0;
+	int n;
+
+	if (cmd == NULL) {
+		return 0;
+	}
+	while (i < batch->Count) {
+		n = snprintf(&cmd->AT[len], GSM_CMD_MAX_LENGTH - len,
+				i == batch->Deleted ? "AT+CMGD=%u" : ";+CMGD=%u",
+				batch->Entries[i].Position);
+		if (n >= GSM_CMD_MAX_LENGTH - len) { /* 放不下，留给下一条命令 */
+			cmd->AT[len] = 0;
+			break;
+		}
+		len += n;
+		i++;
+	}
+	cmd->Cmd = CMD_SMS_CMGD;
+	cmd->Context = batch;
+	cmd->Callback = SMS_DeleteNext;
+	cmd->Arg = arg;
+	CMD_Commit(GSM);
+	return i - batch->Deleted;
+}
+#endif /* GSM_SMS */
+
+/**
+ * 处理接收到的完整的一行数据
+ * @param GSM GSM工作结构体指针
+ */
+static void ParseReceived(GSM_t* GSM) {
+	const char* str = (const char *) GSM->Received.Data;
+	GSM_CMD_t* cmd = __CMD_HEAD(GSM);
+	uint8_t type;
+
+	if (GSM->ActiveCmd != CMD_IDLE && cmd->RawLine) { /* 解析函数需要的内容行 */
+		cmd->RawLine = 0;
+		cmd->Parse(GSM, cmd, str, RECEIVED_LENGTH(), GSM_URC_Unknown);
+		return;
+	}
+	if (RECEIVED_LENGTH() == 0) { /* 空行 */
+		return;
+	}
+	type = GSM_URC_Classify(str, RECEIVED_LENGTH());
+	if (type >= GSM_URC_User) { /* 用户注册的主动上报 */
+		if (GSM->Callback) {
+			GSM->CallbackParams.CP1 = str;
+			GSM->CallbackParams.UI = type;
+			__CALL_CALLBACK(GSM, gsmEventURC);
+		}
+		return;
+	}
+	if ((type == GSM_URC_CIPRXGET || type == GSM_URC_HTTPREAD
+			|| type == GSM_URC_FTPGET) && GSM->ActiveCmd != CMD_IDLE
+			&& __CMD_HEAD(GSM)->Sink != NULL) { /* 数据长度头，后面是原始数据 */
+		GSM_Sink_t* sink = __CMD_HEAD(GSM)->Sink;
+		GSM->RawRemaining = RAW_ParseLength(str, type);
+		if (sink->Expected == 0) {
+			sink->StartTime = GSM->Time;
+		}
+		sink->Expected += GSM->RawRemaining;
+		return;
+	}
+	switch (type) {
+	case GSM_URC_OK:
+		GSM->Events.F.RespOk = 1;
+		break;
+	case GSM_URC_ERROR:
+	case GSM_URC_CME_ERROR:
+	case GSM_URC_CMS_ERROR:
+		GSM->Events.F.RespError = 1;
+		break;
+	case GSM_URC_BUSY:
+	case GSM_URC_NO_CARRIER:
+	case GSM_URC_NO_DIALTONE:
+	case GSM_URC_NO_ANSWER:
+		if (CMD_IS_ACTIVE_CALL(GSM)) { /* 拨号失败的最终结果 */
+			GSM->Events.F.RespError = 1;
+		}
+		break;
+	case GSM_URC_DOWNLOAD:
+#if GSM_HTTP
+		GSM->Events.F.RespDownload = 1;
+#endif /* GSM_HTTP */
+		break;
+	case GSM_URC_CALL_READY:
+		GSM->Events.F.RespCallReady = 1;
+		break;
+	case GSM_URC_SMS_READY:
+		GSM->Events.F.RespSMSReady = 1;
+		break;
+	case GSM_URC_UV_WARNING:
+		GSM->Flags.F.Call_UV_Warn = 1;
+		break;
+	case GSM_URC_UV_POWER_DOWN:
+		GSM->Flags.F.Call_UV_PD = 1;
+		break;
+	case GSM_URC_RING:
+#if GSM_CALL
+		GSM->Flags.F.CALL_RING_Received = 1;
+#endif /* GSM_CALL */
+		break;
+	case GSM_URC_CMTI: { /* +CMTI: "SM",3 */
+#if GSM_SMS
+		const char* ptr = strchr(str, ',');
+		uint8_t i;
+		for (i = 0; ptr && i < GSM_MAX_RECEIVED_SMS_INFO; i++) {
+			if (!GSM->SmsInfos[i].Flags.F.Used) {
+				memset(&GSM->SmsInfos[i], 0x00, sizeof(GSM_SmsInfo_t));
+				GSM->SmsInfos[i].Memory = GSM_SMS_Memory_SM;
+				GSM->SmsInfos[i].Position = ParseNumber(ptr + 1, NULL);
+				GSM->SmsInfos[i].Flags.F.Used = 1;
+				GSM->SmsInfos[i].Flags.F.Received = 1;
+				GSM->Flags.F.SMS_CMTI_Received = 1;
+				break;
+			}
+		}
+#endif /* GSM_SMS */
+		break;
+	}
+	case GSM_URC_ECHO: /* 回显的命令不保存，但可能是以AT开头的多行短信内容 */
+		if (GSM->ActiveCmd != CMD_IDLE && cmd->Parse) {
+			cmd->Parse(GSM, cmd, str, RECEIVED_LENGTH(), type);
+		}
+		break;
+	default:
+		if (type == GSM_URC_CPIN) { /* +CPIN: READY */
+			str += 7;
+			if (strcmp(str, "READY") == 0) {
+				GSM->CPIN = GSM_CPIN_Ready;
+			} else if (strcmp(str, "SIM PIN") == 0) {
+				GSM->CPIN = GSM_CPIN_SIM_PIN;
+			} else if (strcmp(str, "SIM PUK") == 0) {
+				GSM->CPIN = GSM_CPIN_SIM_PUK;
+			} else {
+				GSM->CPIN = GSM_CPIN_Unknown;
+			}
+		} else if (type == GSM_URC_CREG) { /* +CREG: <n>,<stat> */
+			const char* ptr = strchr(str, ',');
+			GSM->NetworkStatus = (GSM_NetworkStatus_t) ParseNumber(
+					ptr ? ptr + 1 : str + 7, NULL);
+		}
+		/* 命令执行期间的其他行都是命令的中间返回 */
+		if (GSM->ActiveCmd != CMD_IDLE) {
+			if (cmd->Parse) {
+				cmd->Parse(GSM, cmd, (const char *) GSM->Received.Data,
+						RECEIVED_LENGTH(), type);
+			} else {
+				CMD_SaveResp(GSM, cmd);
+			}
+		}
+		break;
+	}
+}
+
+/**
+ * 执行命令队列的protothread：发送队首命令，等待最终结果或者超时
+ * @param  pt  protothread结构体指针
+ * @param  GSM GSM工作结构体指针
+ * @return     protothread状态
+ */
+static PT_THREAD(PT_Thread_CMD(struct pt* pt, GSM_t* GSM)) {
+	GSM_CMD_t* cmd = __CMD_HEAD(GSM);
+
+	PT_BEGIN(pt);
+	PT_WAIT_UNTIL(pt, GSM_CMDQueue_Count(&GSM->CmdQueue) > 0);
+	cmd = __CMD_HEAD(GSM);
+	__ACTIVE_CMD(GSM, cmd->Cmd);
+	GSM->ActiveCmdTimeout = cmd->Timeout;
+	__RST_EVENTS_RESP(GSM);
+	/* 命令行整行写入发送队列，队列被慢速tty占满时等待EPOLLOUT写出后再发 */
+	PT_WAIT_UNTIL(pt, GSM_LL_TX_SIZE - GSM_LL_TxPending(&GSM->LL)
+			>= strlen(cmd->AT) + 2 || __CMD_IS_TIMEOUT(GSM));
+	if (!__CMD_IS_TIMEOUT(GSM)) {
+		UART_SEND_STR(cmd->AT);
+		UART_SEND_STR(GSM_CRLF);
+	}
+#if GSM_STATS
+	GSM->StatsIssued = GSM->Stats != NULL ? GSM_Stats_Now() : 0;
+	GSM->StatsFirstByte = 0;
+	GSM->StatsResumes = 0;
+#endif /* GSM_STATS */
+
+	if (cmd->Data != NULL) { /* 等待'>'提示符再发送数据 */
+		PT_WAIT_UNTIL(pt, GSM->Events.F.RespBracket ||
+#if GSM_HTTP
+				GSM->Events.F.RespDownload ||
+#endif /* GSM_HTTP */
+				GSM->Events.F.RespError || __CMD_IS_TIMEOUT(GSM));
+		if (!GSM->Events.F.RespError && !__CMD_IS_TIMEOUT(GSM)) {
+			GSM->TxSent = 0;
+			PT_WAIT_UNTIL(pt, CMD_SendData(GSM, cmd) || __CMD_IS_TIMEOUT(GSM));
+		}
+	}
+	PT_WAIT_UNTIL(pt, GSM->Events.F.RespOk || GSM->Events.F.RespError
+			|| __CMD_IS_TIMEOUT(GSM));
+
+	if (GSM->Events.F.RespOk) {
+		CMD_Complete(GSM, gsmOK);
+	} else if (GSM->Events.F.RespError) {
+		CMD_Complete(GSM, gsmERROR);
+	} else {
+		CMD_Complete(GSM, gsmTIMEOUT);
+	}
+	PT_END(pt);
+}
+
+/**
+ * 调用用户事件回调函数
+ * @param GSM GSM工作结构体指针
+ */
+static void ProcessCallbacks(GSM_t* GSM) {
+	if (GSM->Callback == NULL) {
+		return;
+	}
+	if (GSM->Flags.F.Call_Idle) {
+		GSM->Flags.F.Call_Idle = 0;
+		__CALL_CALLBACK(GSM, gsmEventIdle);
+	}
+#if GSM_CALL
+	if (GSM->Flags.F.CALL_RING_Received) {
+		GSM->Flags.F.CALL_RING_Received = 0;
+		__CALL_CALLBACK(GSM, gsmEventCallRING);
+	}
+#endif /* GSM_CALL */
+#if GSM_SMS
+	if (GSM->Flags.F.SMS_CMTI_Received) {
+		uint8_t i;
+		GSM->Flags.F.SMS_CMTI_Received = 0;
+		for (i = 0; i < GSM_MAX_RECEIVED_SMS_INFO; i++) {
+			if (GSM->SmsInfos[i].Flags.F.Received) {
+				GSM->SmsInfos[i].Flags.F.Received = 0;
+				GSM->CallbackParams.CP1 = &GSM->SmsInfos[i];
+				__CALL_CALLBACK(GSM, gsmEventSMSCMTI);
+			}
+		}
+	}
+#endif /* GSM_SMS */
+	if (GSM->Flags.F.Call_UV_Warn) {
+		GSM->Flags.F.Call_UV_Warn = 0;
+		__CALL_CALLBACK(GSM, gsmEventUVWarning);
+	}
+	if (GSM->Flags.F.Call_UV_PD) {
+		GSM->Flags.F.Call_UV_PD = 0;
+		__CALL_CALLBACK(GSM, gsmEventUVPowerDown);
+	}
+}
+
+/**
+ * 运行命令队列，前一条命令结束后立即发出下一条命令
+ * @param GSM GSM工作结构体指针
+ */
+static void ProcessQueue(GSM_t* GSM) {
+	do {
+#if GSM_STATS
+		GSM->StatsResumes++;
+#endif /* GSM_STATS */
+	} while (!PT_SCHEDULE(PT_Thread_CMD(&GSM->PT_CMD, GSM))
+			&& GSM_CMDQueue_Count(&GSM->CmdQueue) > 0);
+}
+
+GSM_Result_t GSM_Init(GSM_t* GSM, uint32_t Baudrate,
+		GSM_EventCallback_t Callback) {
+	GSM_LL_t LL = GSM->LL; /* 底层驱动的设置由用户在初始化前填写 */
+	void* UserParameters = GSM->UserParameters;
+#if GSM_STATS
+	GSM_Stats_t* Stats = GSM->Stats;
+#endif /* GSM_STATS */
+
+	memset((void *) GSM, 0x00, sizeof(GSM_t)); /* Reset structure for GSM */
+	GSM_URC_Init(); /* 所有实例共享的行分类前缀树 */
+	GSM->LL = LL;
+	GSM->LL.Baudrate = Baudrate;
+	GSM->UserParameters = UserParameters;
+#if GSM_STATS
+	GSM->Stats = Stats;
+#endif /* GSM_STATS */
+	GSM->Callback = Callback;
+	/* Initialize buffer for received data */
+	if (BUFFER_Init(&GSM->Buffer, sizeof(GSM->BufferData), GSM->BufferData)
+			!= 0) {
+		return gsmERROR;
+	}
+	__RESET_THREADS(GSM);
+#if GSM_RTOS
+	if (GSM_SYS_Create((GSM_RTOS_SYNC_t *) &GSM->Sync)
+			|| GSM_SYS_EventCreate((GSM_RTOS_EVENT_t *) &GSM->CmdDone)) {
+		return gsmSYSERROR;
+	}
+#endif
+	if (GSM_LL_Init((GSM_LL_t *) &GSM->LL)) {
+		return gsmLLERROR;
+	}
+	return gsmOK;
+}
+
+uint32_t GSM_DataReceived(GSM_t* GSM, const uint8_t* ch, uint32_t count) {
+	return BUFFER_Write(&GSM->Buffer, ch, count); /* Write received data to buffer */
+}
+
+GSM_Result_t GSM_Update(GSM_t* GSM) {
+	uint8_t ch;
+
+	__LOCK(GSM);
+	GSM->Updating = 1;
+#if GSM_RTOS
+	GSM_SYS_ThreadSelf((GSM_RTOS_THREAD_t *) &GSM->UpdateThread); /* 阻塞调用据此判断是否在GSM_Update的线程中 */
+	GSM->UpdateThreadSet = 1;
+#endif /* GSM_RTOS */
+#if GSM_STATS
+	if (GSM->StatsIssued && !GSM->StatsFirstByte && GSM->ActiveCmd != CMD_IDLE
+			&& BUFFER_GetFull(&GSM->Buffer)) { /* 上次更新后收到的数据都在命令发出之后 */
+		GSM->StatsFirstByte = GSM_Stats_Now();
+	}
+#endif /* GSM_STATS */
+	ProcessQueue(GSM); /* 发送已经入队的命令 */
+	while (1) {
+		if (GSM->RawRemaining) { /* 原始数据整块搬运 */
+			if (RAW_Process(GSM) == 0) {
+				break;
+			}
+			continue;
+		}
+		if (!BUFFER_Read(&GSM->Buffer, &ch, 1)) { /* Read character by character from device */
+			break;
+		}
+		if (ch == '\n') { /* 一行结束 */
+			while (RECEIVED_LENGTH() > 0
+					&& GSM->Received.Data[RECEIVED_LENGTH() - 1] == '\r') {
+				GSM->Received.Data[--GSM->Received.Length] = 0;
+			}
+			ParseReceived(GSM);
+			RECEIVED_RESET();
+			ProcessQueue(GSM); /* 收到最终结果后立即发送下一条命令 */
+		} else if (ch == '>' && RECEIVED_LENGTH() == 0) { /* 数据输入提示符 */
+			GSM->Events.F.RespBracket = 1;
+			ProcessQueue(GSM);
+		} else {
+			RECEIVED_ADD(ch);
+		}
+	}
+	ProcessQueue(GSM); /* 检查超时 */
+	ProcessCallbacks(GSM);
+	GSM_LL_Flush((GSM_LL_t *) &GSM->LL); /* 本次产生的所有发送数据一次写出 */
+	GSM->Updating = 0;
+	__UNLOCK(GSM);
+	return gsmOK;
+}
+
+GSM_Result_t GSM_UpdateTime(GSM_t* GSM, uint32_t millis) {
+	__LOCK(GSM);
+	GSM->Time += millis;
+	__UNLOCK(GSM);
+	return gsmOK;
+}
+
+/**
+ * 获取单调时钟，单位毫秒，阻塞调用用它计算超时
+ * @return 当前时间
+ */
+static uint64_t GSM_Millis(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * 阻塞调用等待一次：异步模式下在命令完成事件上睡眠，
+ * 否则由调用者自己运行GSM_Update，并用实际流逝的时间推进GSM->Time，使命令超时生效
+ * @param GSM     GSM工作结构体指针，调用者已经加锁
+ * @param last    上次推进GSM->Time的时刻，单位毫秒
+ * @param timeout 最长等待时间，单位毫秒
+ */
+static void WaitStep(GSM_t* GSM, uint64_t* last, uint32_t timeout) {
+#if GSM_ASYNC
+#if GSM_RTOS
+	GSM_SYS_EventWait((GSM_RTOS_EVENT_t *) &GSM->CmdDone,
+			(GSM_RTOS_SYNC_t *) &GSM->Sync, timeout);
+#else
+	struct timespec ts = { 0, 1000000 };
+
+	nanosleep(&ts, NULL); /* 无RTOS时由中断推进，每毫秒检查一次，不空转 */
+#endif /* GSM_RTOS */
+#else
+	uint64_t now = GSM_Millis();
+
+	GSM_UpdateTime(GSM, (uint32_t) (now - *last));
+	*last = now;
+	GSM_Update(GSM);
+#endif /* GSM_ASYNC */
+}
+
+/**
+ * 检查是否在等不到命令完成的地方调用阻塞API：回调函数中，或者运行GSM_Update的线程中
+ * 调用者已经加锁，别的线程在GSM_Update中时拿不到锁，所以Updating为1说明是同一线程；
+ * 递归锁在等待事件时只释放一层，持有锁的回调函数中也不能等待
+ * @param  GSM GSM工作结构体指针，调用者已经加锁
+ * @return     不能阻塞返回1
+ */
+static uint8_t IsUpdateContext(GSM_t* GSM) {
+	if (GSM->Updating) {
+		return 1;
+	}
+#if GSM_ASYNC && GSM_RTOS
+	if (GSM->UpdateThreadSet
+			&& GSM_SYS_ThreadIsSelf((GSM_RTOS_THREAD_t *) &GSM->UpdateThread)) {
+		return 1;
+	}
+#endif /* GSM_ASYNC && GSM_RTOS */
+	return 0;
+}
+
+GSM_Result_t GSM_WaitReady(GSM_t* GSM, uint32_t timeout) {
+	uint64_t start = GSM_Millis(), last = start, elapsed;
+	GSM_Result_t res = gsmOK;
+
+	__LOCK(GSM);
+	if (IsUpdateContext(GSM)) {
+		__UNLOCK(GSM);
+		return gsmBUSY;
+	}
+	while (GSM_CMDQueue_Count(&GSM->CmdQueue) > 0) {
+		elapsed = GSM_Millis() - start;
+		if (elapsed > timeout) {
+			res = gsmTIMEOUT;
+			break;
+		}
+		WaitStep(GSM, &last, (uint32_t) (timeout - elapsed) + 1);
+	}
+	__UNLOCK(GSM);
+	return res;
+}
+
+GSM_Result_t GSM_CMD_Send(GSM_t* GSM, const char* AT, char* Resp,
+		uint16_t RespSize, uint32_t Timeout, GSM_CmdCallback_t Callback,
+		void* Arg) {
+	GSM_CMD_t* cmd;
+
+	__CHECK_INPUTS(AT != NULL && strlen(AT) < GSM_CMD_MAX_LENGTH);
+	__LOCK(GSM);
+	cmd = CMD_Alloc(GSM);
+	if (cmd == NULL) {
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	strcpy(cmd->AT, AT);
+	cmd->Cmd = CMD_Lookup(AT);
+	cmd->Resp = Resp;
+	cmd->RespSize = RespSize;
+	if (Resp != NULL && RespSize > 0) {
+		Resp[0] = 0;
+	}
+	if (Timeout) {
+		cmd->Timeout = Timeout;
+	}
+	cmd->Callback = Callback;
+	cmd->Arg = Arg;
+	CMD_Commit(GSM);
+	__UNLOCK(GSM);
+	__RETURN(GSM, gsmOK);
+}
+
+GSM_Result_t GSM_CMD_Read(GSM_t* GSM, const char* AT, GSM_Sink_t* Sink,
+		uint32_t Timeout, GSM_CmdCallback_t Callback, void* Arg) {
+	GSM_CMD_t* cmd;
+
+	__CHECK_INPUTS(AT != NULL && strlen(AT) < GSM_CMD_MAX_LENGTH && Sink != NULL);
+	Sink->Length = 0;
+	Sink->Dropped = 0;
+	Sink->Expected = 0;
+	Sink->BytesPerSecond = 0;
+	__LOCK(GSM);
+	cmd = CMD_Alloc(GSM);
+	if (cmd == NULL) {
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	strcpy(cmd->AT, AT);
+	cmd->Cmd = CMD_Lookup(AT);
+	cmd->Sink = Sink;
+	if (Timeout) {
+		cmd->Timeout = Timeout;
+	}
+	cmd->Callback = Callback;
+	cmd->Arg = Arg;
+	CMD_Commit(GSM);
+	__UNLOCK(GSM);
+	__RETURN(GSM, gsmOK);
+}
+
+uint8_t* GSM_RawBuffer(GSM_t* GSM, uint32_t* len) {
+	GSM_Sink_t* sink;
+	uint8_t* ptr = NULL;
+
+	__LOCK(GSM);
+	if (GSM->RawRemaining && BUFFER_GetFull(&GSM->Buffer) == 0) {
+		sink = __CMD_HEAD(GSM)->Sink;
+		if (sink->Data != NULL && sink->Length < sink->Size) {
+			*len = sink->Size - sink->Length;
+			if (*len > GSM->RawRemaining) {
+				*len = GSM->RawRemaining;
+			}
+			ptr = &sink->Data[sink->Length];
+		}
+	}
+	__UNLOCK(GSM);
+	return ptr;
+}
+
+void GSM_RawCommit(GSM_t* GSM, uint32_t len) {
+	__LOCK(GSM);
+	if (len <= GSM->RawRemaining) {
+		RAW_Account(GSM, __CMD_HEAD(GSM)->Sink, len, len);
+	}
+	__UNLOCK(GSM);
+}
+
+/* 阻塞调用等待的完成标志 */
+typedef struct {
+	volatile uint8_t Done;
+	volatile GSM_Result_t Result;
+} CMD_Wait_t;
+
+static void CMD_WaitCallback(GSM_t* GSM, GSM_Result_t Result,
+		const GSM_CMD_t* Cmd) {
+	CMD_Wait_t* wait = (CMD_Wait_t *) Cmd->Arg;
+	wait->Result = Result;
+	wait->Done = 1;
+}
+
+/**
+ * 队列中所有命令的超时时间之和，即最后一条命令最迟的完成时间
+ * @param  GSM GSM工作结构体指针
+ * @return     单位毫秒
+ */
+static uint64_t CMD_QueueTimeout(GSM_t* GSM) {
+	uint64_t sum = 0;
+	uint8_t i;
+
+	for (i = GSM->CmdQueue.Out; i != GSM->CmdQueue.In; i++) {
+		sum += GSM->CmdQueue.Items[i & (GSM_CMD_QUEUE_SIZE - 1)].Timeout;
+	}
+	return sum;
+}
+
+/**
+ * 等待超时后把命令和调用者的栈分开，命令继续执行，但不再回调和写入Resp
+ * @param GSM  GSM工作结构体指针
+ * @param wait 调用者栈上的完成标志
+ */
+static void CMD_Detach(GSM_t* GSM, CMD_Wait_t* wait) {
+	GSM_CMD_t* cmd;
+	uint8_t i;
+
+	for (i = GSM->CmdQueue.Out; i != GSM->CmdQueue.In; i++) {
+		cmd = &GSM->CmdQueue.Items[i & (GSM_CMD_QUEUE_SIZE - 1)];
+		if (cmd->Callback == CMD_WaitCallback && cmd->Arg == wait) {
+			cmd->Callback = NULL;
+			cmd->Arg = NULL;
+			cmd->Resp = NULL;
+			cmd->RespSize = 0;
+		}
+	}
+}
+
+GSM_Result_t GSM_CMD_Execute(GSM_t* GSM, const char* AT, char* Resp,
+		uint16_t RespSize, uint32_t Timeout) {
+	CMD_Wait_t wait = { 0, gsmOK };
+	GSM_Result_t res;
+	uint64_t start = GSM_Millis(), last = start, limit, elapsed;
+
+	__LOCK(GSM); /* 入队和等待之间不能漏掉完成事件 */
+	if (IsUpdateContext(GSM)) { /* 只有这个线程会运行GSM_Update，等待永远不会结束 */
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	res = GSM_CMD_Send(GSM, AT, Resp, RespSize, Timeout, CMD_WaitCallback,
+			&wait);
+	if (res != gsmOK) {
+		__UNLOCK(GSM);
+		return res;
+	}
+	/* 前面的命令和这条命令都超时也该结束了，GSM->Time停止推进时靠这个期限返回 */
+	limit = CMD_QueueTimeout(GSM);
+	while (!wait.Done) {
+		elapsed = GSM_Millis() - start;
+		if (elapsed > limit) {
+			CMD_Detach(GSM, &wait); /* wait在栈上，返回后命令不能再引用它 */
+			__UNLOCK(GSM);
+			__RETURN(GSM, gsmTIMEOUT);
+		}
+		WaitStep(GSM, &last, (uint32_t) (limit - elapsed) + 1);
+	}
+	__UNLOCK(GSM);
+	__RETURN(GSM, wait.Result);
+}
+
+#if GSM_SMS
+GSM_Result_t GSM_SMS_Send(GSM_t* GSM, const char* Number, const char* Data,
+		GSM_CmdCallback_t Callback, void* Arg) {
+	GSM_CMD_t* cmd;
+
+	__CHECK_INPUTS(Number != NULL && Data != NULL && strlen(Data) <= GSM_SMS_MAX_LENGTH);
+	__CHECK_INPUTS(strlen(Number) < GSM_CMD_MAX_LENGTH - 12);
+	__LOCK(GSM);
+	cmd = CMD_Alloc(GSM);
+	if (cmd == NULL) {
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	sprintf(cmd->AT, "AT+CMGS=\"%s\"", Number);
+	cmd->Cmd = CMD_SMS_CMGS;
+	cmd->Data = (const uint8_t *) Data;
+	cmd->DataLen = strlen(Data);
+	cmd->Timeout = 60000; /* 短信发送需要等待网络 */
+	cmd->Callback = Callback;
+	cmd->Arg = Arg;
+	CMD_Commit(GSM);
+	__UNLOCK(GSM);
+	__RETURN(GSM, gsmOK);
+}
+
+GSM_Result_t GSM_SMS_List(GSM_t* GSM, GSM_SMS_Batch_t* Batch,
+		GSM_SMS_ReadType_t Type, GSM_CmdCallback_t Callback, void* Arg) {
+	GSM_CMD_t* cmd;
+
+	__CHECK_INPUTS(Batch != NULL && Batch->Entries != NULL && Batch->MaxEntries > 0);
+	__CHECK_INPUTS(Batch->Arena != NULL && Type <= GSM_SMS_ReadType_UNSENT);
+	Batch->Count = 0;
+	Batch->ArenaUsed = 0;
+	Batch->Dropped = 0;
+	Batch->Skip = 0;
+	Batch->Deleted = 0;
+	__LOCK(GSM);
+	if (GSM_CMD_QUEUE_SIZE - GSM_CMDQueue_Count(&GSM->CmdQueue) < 2) { /* 需要两个位置 */
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	cmd = CMD_Alloc(GSM); /* 切换短信格式 */
+	sprintf(cmd->AT, "AT+CMGF=%d", Batch->PDU ? 0 : 1);
+	cmd->Cmd = CMD_SMS_CMGF;
+	CMD_Commit(GSM);
+
+	cmd = CMD_Alloc(GSM);
+	if (Batch->PDU) {
+		sprintf(cmd->AT, "AT+CMGL=%d", SMS_StatPDU[Type]);
+	} else {
+		sprintf(cmd->AT, "AT+CMGL=\"%s\"", SMS_StatText[Type]);
+	}
+	cmd->Cmd = CMD_SMS_LIST;
+	cmd->Timeout = 30000; /* 短信很多时模块需要较长时间输出 */
+	cmd->Parse = SMS_ParseList;
+	cmd->Context = Batch;
+	cmd->Callback = Callback;
+	cmd->Arg = Arg;
+	CMD_Commit(GSM);
+	__UNLOCK(GSM);
+	__RETURN(GSM, gsmOK);
+}
+
+GSM_Result_t GSM_SMS_DeleteBatch(GSM_t* GSM, GSM_SMS_Batch_t* Batch,
+		GSM_CmdCallback_t Callback, void* Arg) {
+	__CHECK_INPUTS(Batch != NULL && Batch->Deleted < Batch->Count);
+	__LOCK(GSM);
+	if (Batch->Deleting) { /* 上一次删除还没有结束 */
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	Batch->Callback = Callback;
+	Batch->Deleting = SMS_DeleteChunk(GSM, Batch, Arg);
+	__UNLOCK(GSM);
+	__RETURN(GSM, Batch->Deleting ? gsmOK : gsmBUSY);
+}
+
+GSM_Result_t GSM_SMS_DeleteByStatus(GSM_t* GSM, GSM_SMS_MassDelete_t Type,
+		GSM_CmdCallback_t Callback, void* Arg) {
+	GSM_CMD_t* cmd;
+
+	__CHECK_INPUTS(Type <= GSM_SMS_MassDelete_All);
+	__LOCK(GSM);
+	if (GSM_CMD_QUEUE_SIZE - GSM_CMDQueue_Count(&GSM->CmdQueue) < 2) {
+		__UNLOCK(GSM);
+		__RETURN(GSM, gsmBUSY);
+	}
+	cmd = CMD_Alloc(GSM); /* AT+CMGDA的参数和短信格式有关，统一使用文本模式 */
+	strcpy(cmd->AT, "AT+CMGF=1");
+	cmd->Cmd = CMD_SMS_CMGF;
+	CMD_Commit(GSM);
+
+	cmd = CMD_Alloc(GSM);
+	sprintf(cmd->AT, "AT+CMGDA=\"%s\"", SMS_DeleteText[Type]);
+	cmd->Cmd = CMD_SMS_MASSDELETE;
+	cmd->Timeout = 25000; /* 删除大量短信需要较长时间 */
+	cmd->Callback = Callback;
+	cmd->Arg = Arg;
+	CMD_Commit(GSM);
+	__UNLOCK(GSM);
+	__RETURN(GSM, gsmOK);
+}
+#endif /* GSM_SMS */
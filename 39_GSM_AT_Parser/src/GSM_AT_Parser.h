@@ -15,8 +15,14 @@
 extern "C" {
 #endif
 
+#include <stdio.h>
+#include <string.h>
 #include "gsm_config.h"
 #include "gsm_ll.h"
+#include "gsm_urc.h"
+#include "gsm_stats.h"
+#include "Buffer.h"
+#include "pt/pt.h"
 #if GSM_RTOS
 #include "gsm_sys.h"
 #endif
@@ -146,16 +152,43 @@ typedef struct _GSM_SmsInfo_t {
 	} Flags;
 } GSM_SmsInfo_t;
 
+/*
+ * 一条短信，字符串都指向所属GSM_SMS_Batch_t的字符池
+ */
 typedef struct _GSM_SMS_Entry_t {
 	uint16_t Position; //在短信内存中的位置
 	GSM_SMS_Memory_t Memory; //存放短信的内存类型
-	char Data[GSM_SMS_MAX_LENGTH]; //短信内容
-	uint8_t DataLen; //短信长度
-	char Name[20]; //短信发送者的名字
-	char Number[20]; //短信发送者的号码
+	GSM_SMS_ReadType_t Status; //短信状态，已读、未读、已发送或者未发送
+	const char* Data; //短信内容，PDU模式下为十六进制PDU字符串
+	uint16_t DataLen; //短信内容长度
+	uint16_t PDULength; //PDU模式下TPDU的字节数，不包括短信中心地址
+	const char* Name; //短信发送者的名字
+	const char* Number; //短信发送者的号码
 	GSM_DateTime_t DateTime; //短信发送或者接收的时间
 } GSM_SMS_Entry_t;
 
+struct _GSM_t;
+struct _GSM_CMD_t;
+
+/*
+ * 批量读取短信的结果，条目池和字符池都由用户提供
+ */
+typedef struct _GSM_SMS_Batch_t {
+	GSM_SMS_Entry_t* Entries; //条目池
+	uint16_t MaxEntries; //条目池大小
+	uint16_t Count; //已经读取的短信数量
+	char* Arena; //字符池，保存号码、名字和短信内容
+	uint32_t ArenaSize; //字符池大小
+	uint32_t ArenaUsed; //字符池已经使用的字节数
+	uint8_t PDU; //为1时使用PDU模式读取，不需要模块转换编码
+	uint16_t Dropped; //条目池或者字符池已满、或者内容行被截断而丢弃的短信数量
+	uint8_t Skip; //内部使用，正在丢弃当前短信的内容行
+	uint16_t Deleted; //GSM_SMS_DeleteBatch已经删除的条目数量，前Deleted条已从模块中删除
+	uint16_t Deleting; //内部使用，正在执行的AT+CMGD命令删除的条目数量
+	void (*Callback)(struct _GSM_t* GSM, GSM_Result_t Result,
+			const struct _GSM_CMD_t* Cmd); //内部使用，GSM_SMS_DeleteBatch的完成回调
+} GSM_SMS_Batch_t;
+
 typedef struct _GSM_PB_Entry_t {
 	uint16_t Index; //电话本中的索引号
 	char Name[20]; //电话本中记录的名字
@@ -323,6 +356,9 @@ typedef enum _GSM_Event_t {
 	gsmEventGPRSDetached, //GPRS业务已分离
 	gsmEventUVWarning, //收到低压警报
 	gsmEventUVPowerDown, //低压断电
+	gsmEventURC, //收到用户注册的主动上报，CP1为整行数据，UI为注册时分配的类型
+	gsmEventCmdQueued, //有命令入队，在调用者的线程中触发，用于唤醒GSM_Update所在的线程
+	gsmEventDisconnected, //tty已经断开(例如USB模块被拔出)，管理器已经关闭设备
 } GSM_Event_t;
 
 typedef struct _GSM_EventParams_t {
@@ -331,7 +367,112 @@ typedef struct _GSM_EventParams_t {
 	uint32_t UI;
 } GSM_EventParams_t;
 
-typedef int (*GSM_EventCallback_t)(GSM_Event_t, GSM_EventParams_t*);
+struct _GSM_t;
+struct _GSM_CMD_t;
+
+typedef int (*GSM_EventCallback_t)(struct _GSM_t*, GSM_Event_t,
+		GSM_EventParams_t*);
+
+/*
+ * 当前正在接收的一行数据
+ */
+typedef struct _GSM_Received_t {
+	uint16_t Length; //行长度
+	uint8_t Data[GSM_RECEIVED_MAX_LENGTH]; //行数据，以0结尾
+} GSM_Received_t;
+
+/*
+ * 命令执行过程中使用的临时指针
+ */
+typedef struct _GSM_Pointers_t {
+	volatile const void* CPtr1;
+	volatile const void* CPtr2;
+	volatile const void* CPtr3;
+	volatile void* Ptr1;
+	volatile void* Ptr2;
+	volatile void* Ptr3;
+	volatile uint32_t UI;
+} GSM_Pointers_t;
+
+/**
+ * AT命令执行完成的回调函数
+ * @param GSM    GSM工作结构体指针
+ * @param Result 命令执行结果，收到OK为gsmOK，收到ERROR为gsmERROR，超时为gsmTIMEOUT
+ * @param Cmd    执行完成的命令，Resp中保存了命令的中间返回行
+ */
+typedef void (*GSM_CmdCallback_t)(struct _GSM_t* GSM, GSM_Result_t Result,
+		const struct _GSM_CMD_t* Cmd);
+
+/**
+ * 命令的中间返回行解析函数，设置后中间返回行不再保存到Resp
+ * @param GSM  GSM工作结构体指针
+ * @param Cmd  当前命令，Context为解析函数的上下文
+ * @param Line 一行数据，不包括结尾的\r\n
+ * @param Len  行长度
+ * @param Type 行类型，GSM_URC_Type_t
+ */
+typedef void (*GSM_LineHandler_t)(struct _GSM_t* GSM, struct _GSM_CMD_t* Cmd,
+		const char* Line, uint16_t Len, uint8_t Type);
+
+struct _GSM_Sink_t;
+
+/**
+ * 原始数据接收进度回调函数，每搬运一块数据调用一次
+ * @param GSM  GSM工作结构体指针
+ * @param Sink 数据接收目标，其中包含已经接收的字节数和速率
+ */
+typedef void (*GSM_ProgressCallback_t)(struct _GSM_t* GSM,
+		const struct _GSM_Sink_t* Sink);
+
+/*
+ * 原始数据接收目标
+ * 命令返回+CIPRXGET: 2,+HTTPREAD:或者+FTPGET: 2长度头之后，
+ * 后面的数据不再按行解析，直接从环形缓存(或者串口)搬运到这里
+ */
+typedef struct _GSM_Sink_t {
+	uint8_t* Data; //目标缓存，为NULL时写入FD
+	uint32_t Size; //目标缓存大小
+	int FD; //目标文件描述符，Data为NULL时使用
+	uint32_t Length; //已经保存的字节数
+	uint32_t Dropped; //目标缓存已满或者写入FD失败而丢弃的字节数
+	uint32_t Expected; //所有长度头中声明的总字节数
+	uint32_t StartTime; //收到第一个长度头的时间，单位毫秒
+	uint32_t BytesPerSecond; //平均接收速率
+	GSM_ProgressCallback_t Progress; //进度回调函数，可以为NULL
+	void* Arg; //回调函数的用户参数
+} GSM_Sink_t;
+
+/*
+ * 命令队列中的一条AT命令
+ */
+typedef struct _GSM_CMD_t {
+	uint16_t Cmd; //命令代码，CMD_xxx
+	char AT[GSM_CMD_MAX_LENGTH]; //要发送的AT命令，不包括结尾的\r\n
+	const uint8_t* Data; //收到'>'提示符后要发送的数据，可以为NULL
+	uint16_t DataLen; //Data的字节数
+	char* Resp; //保存中间返回行的用户缓存，可以为NULL
+	uint16_t RespSize; //Resp缓存大小
+	uint16_t RespLength; //Resp中已经保存的字节数
+	GSM_Sink_t* Sink; //原始数据接收目标，可以为NULL
+	GSM_LineHandler_t Parse; //中间返回行解析函数，可以为NULL
+	void* Context; //解析函数的上下文
+	uint8_t RawLine; //为1时下一行(包括空行)不经过分类，直接交给Parse，由解析函数设置
+	uint32_t Timeout; //从命令发出到收到最终结果的超时时间，单位毫秒
+	GSM_CmdCallback_t Callback; //命令完成回调函数
+	void* Arg; //回调函数的用户参数
+} GSM_CMD_t;
+
+/*
+ * 有界命令队列，队首为正在执行的命令
+ * In和Out为自由增长的计数器，差值即队列中的命令数
+ */
+typedef struct _GSM_CMDQueue_t {
+	GSM_CMD_t Items[GSM_CMD_QUEUE_SIZE]; //命令存储区
+	volatile uint8_t In; //写入计数
+	volatile uint8_t Out; //读出计数
+} GSM_CMDQueue_t;
+
+#define GSM_CMDQueue_Count(q)               ((uint8_t)((q)->In - (q)->Out))
 
 typedef struct _GSM_t {
 	volatile uint32_t Time; //当前时间，单位毫秒
@@ -339,6 +480,12 @@ typedef struct _GSM_t {
 
 	//底层管理
 	GSM_LL_t LL; //底层通信
+	BUFFER_t Buffer; //接收数据的环形缓存
+	uint8_t BufferData[GSM_BUFFER_SIZE]; //环形缓存的存储区
+	GSM_Received_t Received; //当前正在接收的一行数据
+	GSM_Pointers_t Pointers; //命令执行过程中使用的临时指针
+	volatile uint32_t RawRemaining; //原始数据模式下还没收到的字节数，为0时按行解析
+	uint16_t TxSent; //队首命令的Data已经写入发送队列的字节数
 
 	//有效命令信息
 	volatile uint16_t ActiveCmd; //当前可执行的有效命令
@@ -348,6 +495,9 @@ typedef struct _GSM_t {
 	volatile GSM_Result_t ActiveResult; //函数返回结果
 	volatile uint32_t ActiveCmdTimeout; //有效命令超时时间，单位：毫秒
 
+	GSM_CMDQueue_t CmdQueue; //AT命令队列
+	struct pt PT_CMD; //执行命令队列的protothread
+
 	volatile GSM_NetworkStatus_t NetworkStatus; //网络状态
 
 	GSM_CPIN_t CPIN; //SIM卡状态
@@ -378,7 +528,11 @@ typedef struct _GSM_t {
 
 #if GSM_RTOS
 	GSM_RTOS_SYNC_t Sync; //RTOS同步对象
+	GSM_RTOS_EVENT_t CmdDone; //命令完成事件，阻塞调用在上面等待
+	GSM_RTOS_THREAD_t UpdateThread; //最近一次运行GSM_Update的线程
+	volatile uint8_t UpdateThreadSet; //UpdateThread有效
 #endif
+	volatile uint8_t Updating; //正在执行GSM_Update，回调函数中为1
 
 	union {
 		struct {
@@ -427,6 +581,14 @@ typedef struct _GSM_t {
 	} Flags;
 	GSM_EventCallback_t Callback; //回调函数
 	GSM_EventParams_t CallbackParams; //回调函数参数
+	void* UserParameters; //用户数据指针，可选
+
+#if GSM_STATS
+	GSM_Stats_t* Stats; //命令统计对象，为NULL时不统计，可以被多个实例共享
+	uint64_t StatsIssued; //队首命令发出的时间，单位微秒
+	uint64_t StatsFirstByte; //队首命令收到第一个字节的时间，为0表示还没收到
+	uint32_t StatsResumes; //队首命令发出后protothread被调度的次数
+#endif /* GSM_STATS */
 
 	union {
 		struct {
@@ -460,6 +622,176 @@ typedef struct _GSM_t {
 	} Events;
 } GSM_t;
 
+/**
+ * 初始化GSM工作结构体以及底层驱动
+ * @note   GSM->LL中的底层驱动设置、GSM->UserParameters和GSM->Stats需要在调用之前填写
+ * @param  GSM      GSM工作结构体指针
+ * @param  Baudrate 串口波特率
+ * @param  Callback 事件回调函数，可以为NULL
+ * @return          成功返回gsmOK，底层驱动出错返回gsmLLERROR
+ */
+GSM_Result_t GSM_Init(GSM_t* GSM, uint32_t Baudrate,
+		GSM_EventCallback_t Callback);
+
+/**
+ * 将串口收到的数据复制到GSM实例的内部工作缓存中
+ * @param  GSM   GSM工作结构体指针
+ * @param  ch    串口收到的数据
+ * @param  count 要写入数据的字节数
+ * @return       返回成功写入数据的字节数
+ */
+uint32_t GSM_DataReceived(GSM_t* GSM, const uint8_t* ch, uint32_t count);
+
+/**
+ * 执行GSM解析工作：处理收到的数据，发送队列中的下一条命令，调用事件回调
+ * @param  GSM GSM工作结构体指针
+ * @return     成功返回gsmOK
+ */
+GSM_Result_t GSM_Update(GSM_t* GSM);
+
+/**
+ * 更新GSM库的时间，需要在定时器中周期性调用
+ * @param  GSM    GSM工作结构体指针
+ * @param  millis 距离上次调用经过的毫秒数
+ * @return        成功返回gsmOK
+ */
+GSM_Result_t GSM_UpdateTime(GSM_t* GSM, uint32_t millis);
+
+/**
+ * 等待命令队列中所有的命令执行完成
+ * @note   GSM_ASYNC下阻塞在命令完成事件上，否则由调用者运行GSM_Update
+ * @note   不能在回调函数中或运行GSM_Update的线程中调用，这时返回gsmBUSY
+ * @param  GSM     GSM工作结构体指针
+ * @param  timeout 超时时间，单位毫秒，按单调时钟计算
+ * @return         队列为空返回gsmOK，超时返回gsmTIMEOUT，在回调函数中调用返回gsmBUSY
+ */
+GSM_Result_t GSM_WaitReady(GSM_t* GSM, uint32_t timeout);
+
+/**
+ * 将一条AT命令加入命令队列，立即返回。前一条命令收到最终结果后会立刻发出下一条命令
+ * @param  GSM      GSM工作结构体指针
+ * @param  AT       AT命令字符串，如"AT+CSQ"，不包括结尾的\r\n
+ * @param  Resp     保存中间返回行的缓存，每行以\n结尾，可以为NULL
+ * @param  RespSize Resp缓存大小
+ * @param  Timeout  超时时间，单位毫秒，为0时使用GSM_CMD_TIMEOUT
+ * @param  Callback 命令完成回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满返回gsmBUSY，参数错误返回gsmPARERROR
+ */
+GSM_Result_t GSM_CMD_Send(GSM_t* GSM, const char* AT, char* Resp,
+		uint16_t RespSize, uint32_t Timeout, GSM_CmdCallback_t Callback,
+		void* Arg);
+
+/**
+ * 将一条AT命令加入命令队列，并阻塞等待它执行完成
+ * @note   GSM_ASYNC下GSM_Update在其他线程中调用，这里阻塞在命令完成事件上；
+ *         否则由调用者运行GSM_Update，并按单调时钟推进GSM->Time使命令超时生效
+ * @note   回调函数和运行GSM_Update的线程(如GSM_Manager的线程)等不到命令完成，
+ *         在其中调用时立即返回gsmBUSY，应该改用GSM_CMD_Send
+ * @note   最多等待队列中各命令超时时间之和，到时命令还没完成时返回gsmTIMEOUT，
+ *         命令仍然会执行，但不再写入Resp
+ * @param  GSM      GSM工作结构体指针
+ * @param  AT       AT命令字符串
+ * @param  Resp     保存中间返回行的缓存，可以为NULL
+ * @param  RespSize Resp缓存大小
+ * @param  Timeout  超时时间，单位毫秒，为0时使用GSM_CMD_TIMEOUT
+ * @return          返回命令的执行结果，在回调函数中调用返回gsmBUSY
+ */
+GSM_Result_t GSM_CMD_Execute(GSM_t* GSM, const char* AT, char* Resp,
+		uint16_t RespSize, uint32_t Timeout);
+
+/**
+ * 将一条读取数据的AT命令加入命令队列，如"AT+CIPRXGET=2,1460"，"AT+HTTPREAD"，"AT+FTPGET=2,1024"
+ * 收到长度头之后的数据直接搬运到Sink，不经过行缓存
+ * @param  GSM      GSM工作结构体指针
+ * @param  AT       AT命令字符串
+ * @param  Sink     数据接收目标，在回调函数被调用前必须保持有效，Length等统计值会被清零
+ * @param  Timeout  超时时间，单位毫秒，为0时使用GSM_CMD_TIMEOUT，收到数据时重新计时
+ * @param  Callback 命令完成回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满返回gsmBUSY，参数错误返回gsmPARERROR
+ */
+GSM_Result_t GSM_CMD_Read(GSM_t* GSM, const char* AT, GSM_Sink_t* Sink,
+		uint32_t Timeout, GSM_CmdCallback_t Callback, void* Arg);
+
+/**
+ * 根据命令代码得到AT命令的名字，用于打印统计信息
+ * @param  Cmd 命令代码
+ * @return     不包括"AT"的命令名字，如"+CSQ"，没有名字的命令返回NULL
+ */
+const char* GSM_CMD_Name(uint16_t Cmd);
+
+/**
+ * 原始数据模式下获取可以直接写入的目标地址，用于从串口直接读入用户缓存
+ * @note   只有环形缓存为空并且目标为用户缓存时才返回地址，之后必须调用GSM_RawCommit
+ * @param  GSM GSM工作结构体指针
+ * @param  len 返回最多可以写入的字节数
+ * @return     目标地址，不能直接写入时返回NULL
+ */
+uint8_t* GSM_RawBuffer(GSM_t* GSM, uint32_t* len);
+
+/**
+ * 提交直接写入GSM_RawBuffer返回地址的数据
+ * @param GSM GSM工作结构体指针
+ * @param len 写入的字节数
+ */
+void GSM_RawCommit(GSM_t* GSM, uint32_t len);
+
+#if GSM_SMS
+/**
+ * 发送短信，AT+CMGS命令进入队列，收到'>'提示符后发送短信内容
+ * @param  GSM      GSM工作结构体指针
+ * @param  Number   接收方号码
+ * @param  Data     短信内容，在回调函数被调用前必须保持有效
+ * @param  Callback 命令完成回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满返回gsmBUSY
+ */
+GSM_Result_t GSM_SMS_Send(GSM_t* GSM, const char* Number, const char* Data,
+		GSM_CmdCallback_t Callback, void* Arg);
+
+/**
+ * 用一条AT+CMGL命令读取多条短信，在一次扫描中解析到Batch的条目池和字符池
+ * @note   需要时先加入AT+CMGF命令切换短信格式，PDU模式下模块不需要转换编码，并且内容中不会出现OK这样的行
+ * @note   处理完后用GSM_SMS_DeleteBatch删除读到的短信，读取期间新到的短信不会被删除
+ * @param  GSM      GSM工作结构体指针
+ * @param  Batch    读取结果，设置好条目池、字符池和PDU，在回调函数被调用前必须保持有效
+ * @param  Type     要读取的短信类型
+ * @param  Callback 命令完成回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满返回gsmBUSY，参数错误返回gsmPARERROR
+ */
+GSM_Result_t GSM_SMS_List(GSM_t* GSM, GSM_SMS_Batch_t* Batch,
+		GSM_SMS_ReadType_t Type, GSM_CmdCallback_t Callback, void* Arg);
+
+/**
+ * 删除GSM_SMS_List读到的短信，只删除Batch中列出的位置，从Batch->Deleted开始
+ * 每条AT+CMGD命令行用分号连接多个+CMGD，完成后再加入下一条，同时只占用一个队列位置
+ * @note   出错时Batch->Deleted为已经删除的条目数量，再次调用从这里继续；
+ *         回调函数的Result为gsmBUSY表示中途队列已满
+ * @param  GSM      GSM工作结构体指针
+ * @param  Batch    GSM_SMS_List读取的结果，在回调函数被调用前必须保持有效
+ * @param  Callback 全部删除或者出错后调用的回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满或者上一次删除还没结束返回gsmBUSY，没有要删除的条目返回gsmPARERROR
+ */
+GSM_Result_t GSM_SMS_DeleteBatch(GSM_t* GSM, GSM_SMS_Batch_t* Batch,
+		GSM_CmdCallback_t Callback, void* Arg);
+
+/**
+ * 用一条AT+CMGDA命令按状态删除短信，之前先加入AT+CMGF=1命令切换到文本模式
+ * @note   删除模块中所有符合状态的短信，包括没有被GSM_SMS_List读到的；
+ *         只删除已经处理的短信请用GSM_SMS_DeleteBatch
+ * @param  GSM      GSM工作结构体指针
+ * @param  Type     要删除的短信状态
+ * @param  Callback 命令完成回调函数，可以为NULL
+ * @param  Arg      回调函数的用户参数
+ * @return          成功返回gsmOK，队列满返回gsmBUSY
+ */
+GSM_Result_t GSM_SMS_DeleteByStatus(GSM_t* GSM, GSM_SMS_MassDelete_t Type,
+		GSM_CmdCallback_t Callback, void* Arg);
+#endif /* GSM_SMS */
+
 #ifdef __cplusplus
 }
 #endif
@@ -66,12 +66,22 @@
  *
  * \note   When this mode is enabled, RTOS dependant locking system is required for thread synchronization.
  */
-#define GSM_RTOS                        0
+#define GSM_RTOS                        1
 
 /**
  * \brief  RTOS sync object for mutex
  */
-#define GSM_RTOS_SYNC_t                 osMutexDef_t
+#define GSM_RTOS_SYNC_t                 pthread_mutex_t
+
+/**
+ * \brief  RTOS event object, blocking API calls wait on it until a command completes
+ */
+#define GSM_RTOS_EVENT_t                pthread_cond_t
+
+/**
+ * \brief  RTOS thread identifier, blocking API calls use it to detect the thread which runs \ref GSM_Update
+ */
+#define GSM_RTOS_THREAD_t               pthread_t
 
 /**
  * \brief  Timeout in milliseconds for mutex to access API
@@ -87,6 +97,80 @@
  */
 #define GSM_ASYNC                       1
 
+/**
+ * \brief  Number of AT commands which can wait in command queue at a time
+ *
+ * \note   Must be power of 2 and not more than 128.
+ *         When queue is full, functions return \ref gsmBUSY.
+ */
+#define GSM_CMD_QUEUE_SIZE              8
+
+/**
+ * \brief  Maximal length of AT command string stored in command queue, including trailing zero
+ */
+#define GSM_CMD_MAX_LENGTH              128
+
+/**
+ * \brief  Default timeout in milliseconds for AT command to receive final result code
+ */
+#define GSM_CMD_TIMEOUT                 5000
+
+/**
+ * \brief  Size of transmit queue in low-level driver in units of bytes
+ *
+ * \note   Must be power of 2. Data is queued during \ref GSM_Update and written with one writev call.
+ *         When queue is full, \ref GSM_LL_SendData queues only part of data and command
+ *         sending continues on next \ref GSM_Update after tty becomes writable.
+ */
+#define GSM_LL_TX_SIZE                  4096
+
+/**
+ * \brief  Maximal number of nodes in response line classifier trie, shared by all GSM instances
+ *
+ * \note   Built-in result codes and URCs use about 250 nodes,
+ *         the rest is available for vendor URCs registered with \ref GSM_URC_Register
+ */
+#define GSM_URC_MAX_NODES               512
+
+/**
+ * \brief  Maximal number of scenario steps in host-side modem simulator
+ *
+ * \note   Up to 32 of them can be timed URC injections
+ */
+#define GSM_SIM_MAX_STEPS               256
+
+/**
+ * \brief  Maximal number of GSM modems driven by one \ref GSM_Manager_t
+ */
+#define GSM_MANAGER_MAX_MODEMS          64
+
+/**
+ * \brief  Time in milliseconds manager thread sleeps in epoll when no data is received.
+ *
+ *         It is also resolution of command timeouts when modems are driven by manager.
+ */
+#define GSM_MANAGER_TICK                10
+
+/**
+ * \brief  Enables (1) or disables (0) per-command latency statistics
+ *
+ * \note   When enabled, statistics are recorded only for GSM instances with \ref GSM_t.Stats set.
+ *         See \ref GSM_Stats_Snapshot for reading them from another thread.
+ */
+#define GSM_STATS                       1
+
+/**
+ * \brief  Maximal number of different command codes recorded by one statistics object
+ */
+#define GSM_STATS_MAX_CMDS              32
+
+/**
+ * \brief  Maximal length of one line received from module, including trailing zero
+ *
+ * \note   Must hold one SMS in PDU mode, which is up to 176 octets encoded as hex
+ */
+#define GSM_RECEIVED_MAX_LENGTH         384
+
 /**
  * \brief  Maximal SMS length in units of bytes
  */
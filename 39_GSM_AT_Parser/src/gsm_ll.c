@@ -24,6 +24,13 @@
  * |----------------------------------------------------------------------
  */
 #include "gsm_ll.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
 
 /******************************************************************************/
 /******************************************************************************/
@@ -31,25 +38,146 @@
 /******************************************************************************/
 /******************************************************************************/
 
+/* 将波特率数值转换成termios的速度常量，不支持的波特率返回B0 */
+static speed_t LL_Speed(uint32_t baudrate) {
+	switch (baudrate) {
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	case 230400:
+		return B230400;
+#ifdef B460800
+	case 460800:
+		return B460800;
+#endif
+#ifdef B921600
+	case 921600:
+		return B921600;
+#endif
+	default:
+		return B0;
+	}
+}
+
 uint8_t GSM_LL_Init(GSM_LL_t* LL) {
+	struct termios tio;
+	speed_t speed = LL_Speed(LL->Baudrate);
+
 	/* Init UART */
+	if (LL->Device == NULL || speed == B0) { /* 静默换成别的波特率只会收到乱码 */
+		return 1;
+	}
+	LL->FD = open(LL->Device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (LL->FD < 0) {
+		return 1;
+	}
+	if (tcgetattr(LL->FD, &tio) < 0) {
+		close(LL->FD);
+		LL->FD = -1;
+		return 1;
+	}
+	cfmakeraw(&tio); /* 原始模式，8N1 */
+	tio.c_cflag |= CLOCAL | CREAD;
+	if (LL->FlowControl) { /* 硬件流控，由内核根据CTS暂停发送 */
+		tio.c_cflag |= CRTSCTS;
+	} else {
+		tio.c_cflag &= ~CRTSCTS;
+	}
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	if (tcsetattr(LL->FD, TCSANOW, &tio) < 0) {
+		close(LL->FD);
+		LL->FD = -1;
+		return 1;
+	}
+	tcflush(LL->FD, TCIOFLUSH);
+	LL->TxIn = LL->TxOut = 0;
 
 	/* Init reset pin */
 
 	return 0;
 }
 
+uint8_t GSM_LL_DeInit(GSM_LL_t* LL) {
+	if (LL->FD >= 0) {
+		close(LL->FD);
+		LL->FD = -1;
+	}
+	return 0;
+}
 
-uint8_t GSM_LL_SendData(GSM_LL_t* LL, const uint8_t* data, uint16_t count) {
-	/* Send data via UART */
+uint16_t GSM_LL_SendData(GSM_LL_t* LL, const uint8_t* data, uint16_t count) {
+	uint32_t free, in, tocopy;
+	uint16_t queued = 0;
 
-	return 0;
+	/* Copy data to transmit queue */
+	while (count > 0) {
+		free = GSM_LL_TX_SIZE - GSM_LL_TxPending(LL);
+		if (free == 0) { /* 队列满，尝试写出一部分，tty不接收就返回已入队的字节数，不等待 */
+			if (GSM_LL_Flush(LL) < 0 || GSM_LL_TxPending(LL) == GSM_LL_TX_SIZE) {
+				break;
+			}
+			continue;
+		}
+		if (free > count) {
+			free = count;
+		}
+		in = LL->TxIn & (GSM_LL_TX_SIZE - 1);
+		tocopy = GSM_LL_TX_SIZE - in; /* 到队列末尾可以连续写入的字节数 */
+		if (tocopy > free) {
+			tocopy = free;
+		}
+		memcpy(&LL->TxData[in], data, tocopy);
+		memcpy(LL->TxData, data + tocopy, free - tocopy);
+		LL->TxIn += free;
+		data += free;
+		count -= free;
+		queued += free;
+	}
+	return queued;
 }
 
+int32_t GSM_LL_Flush(GSM_LL_t* LL) {
+	struct iovec iov[2];
+	uint32_t pending, out;
+	ssize_t n;
+
+	while ((pending = GSM_LL_TxPending(LL)) > 0) {
+		out = LL->TxOut & (GSM_LL_TX_SIZE - 1);
+		iov[0].iov_base = &LL->TxData[out];
+		iov[0].iov_len = GSM_LL_TX_SIZE - out;
+		if (iov[0].iov_len > pending) {
+			iov[0].iov_len = pending;
+		}
+		iov[1].iov_base = LL->TxData;
+		iov[1].iov_len = pending - iov[0].iov_len;
+		n = writev(LL->FD, iov, iov[1].iov_len ? 2 : 1);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) { /* tty发送缓存满或者CTS无效 */
+				break;
+			}
+			return -1;
+		}
+		LL->TxOut += n;
+	}
+	return GSM_LL_TxPending(LL);
+}
 
 uint8_t GSM_LL_SetReset(GSM_LL_t* LL, uint8_t state) {
 	/* Set reset pin */
-	if (state == GSM_RESET_LOW) {
+	if (state == GSM_RESET_CLR) {
 		/* Set pin low */
 	} else {
 		/* Set pin high */
@@ -59,10 +187,18 @@ uint8_t GSM_LL_SetReset(GSM_LL_t* LL, uint8_t state) {
 }
 
 uint8_t GSM_LL_SetRTS(GSM_LL_t* LL, uint8_t state) {
-	if (state == GSM_RTS_LOW) {
+	int bits = TIOCM_RTS;
+
+	if (state == GSM_RTS_CLR) {
 		/* Set pin low */
+		if (ioctl(LL->FD, TIOCMBIC, &bits) < 0) {
+			return 1;
+		}
 	} else {
 		/* Set pin high */
+		if (ioctl(LL->FD, TIOCMBIS, &bits) < 0) {
+			return 1;
+		}
 	}
 
 	return 0;
@@ -42,6 +42,7 @@ extern "C" {
 /* Include core libraries */
 #include "stdint.h"
 #include "stdlib.h"
+#include "gsm_config.h"
 
 /******************************************************************************/
 /******************************************************************************/
@@ -57,12 +58,23 @@ extern "C" {
 
 /**
  * \brief  Low level structure for driver
- * \note   For now it has basic settings only without hardware flow control.
+ * \note   Device and FlowControl must be set before \ref GSM_Init is called
  */
 typedef struct _GSM_LL_t {
 	uint32_t Baudrate; /*!< Baudrate to be used for UART */
+	const char* Device; /*!< Path to tty device, for example "/dev/ttyUSB0" */
+	uint8_t FlowControl; /*!< Set to 1 to enable RTS/CTS hardware flow control */
+	int FD; /*!< File descriptor of opened tty device */
+	uint8_t TxData[GSM_LL_TX_SIZE]; /*!< Transmit queue, flushed with \ref GSM_LL_Flush */
+	uint32_t TxIn; /*!< Free running write counter of transmit queue */
+	uint32_t TxOut; /*!< Free running read counter of transmit queue */
 } GSM_LL_t;
 
+/**
+ * \brief  Number of bytes waiting in transmit queue
+ */
+#define GSM_LL_TxPending(LL)            ((uint32_t)((LL)->TxIn - (LL)->TxOut))
+
 /* Include library */
 #include "GSM_AT_Parser.h"
 
@@ -76,26 +88,41 @@ typedef struct _GSM_LL_t {
  * \param  *LL: Pointer to \ref GSM_LL_t structure with settings
  * \retval Success status:
  *            - 0: Successful
- *            - > 0: Error
+ *            - > 0: Error, also when Baudrate is not supported by termios
  */
 uint8_t GSM_LL_Init(GSM_LL_t* LL);
 
+/**
+ * \brief  Releases Low-Level driver resources
+ * \param  *LL: Pointer to \ref GSM_LL_t structure with settings
+ * \retval Success status:
+ *            - 0: Successful
+ *            - > 0: Error
+ */
+uint8_t GSM_LL_DeInit(GSM_LL_t* LL);
+
 /**
  * \brief  Sends data to SIM module from GSM stack
- * \note   Send can be implemented using DMA or IRQ easily,
- *            without waiting for finish.
- *            However, when multiple calls are executed,
- *            you must take care to send previous data first.
- *            Using DMA or IRQ, you can use cyclic buffers for implementation.
+ * \note   Data is only copied to transmit queue, \ref GSM_Update flushes it at the end.
+ *            When queue is full, queued data is flushed first without waiting for tty.
+ *            If tty (or CTS line) still does not accept data, only part of data is queued
+ *            and caller sends the rest after queue is flushed on EPOLLOUT.
  *
  * \param  *LL: Pointer to \ref GSM_LL_t structure with settings
  * \param  *data: Data to be sent to module
  * \param  count: Number of bytes to be sent to module
- * \retval Success status:
- *            - 0: Successful
- *            - > 0: Error
+ * \retval Number of bytes copied to transmit queue, less than count when queue is full
  */
-uint8_t GSM_LL_SendData(GSM_LL_t* LL, const uint8_t* data, uint16_t count);
+uint16_t GSM_LL_SendData(GSM_LL_t* LL, const uint8_t* data, uint16_t count);
+
+/**
+ * \brief  Writes as much data from transmit queue to tty as possible without blocking
+ * \note   Both parts of wrapped queue are written with single writev call.
+ *            When data remains in queue, wait for tty to be writable (EPOLLOUT) and call again.
+ * \param  *LL: Pointer to \ref GSM_LL_t structure with settings
+ * \retval Number of bytes still waiting in queue or -1 on error
+ */
+int32_t GSM_LL_Flush(GSM_LL_t* LL);
 
 /**
  * \brief  Set reset pin high or low
@@ -108,9 +135,11 @@ uint8_t GSM_LL_SendData(GSM_LL_t* LL, const uint8_t* data, uint16_t count);
 uint8_t GSM_LL_SetReset(GSM_LL_t* LL, uint8_t state);
 
 /**
- * \brief  Initializes Low-Level driver to communicate with SIM module
+ * \brief  Set RTS line high or low to let module send data or pause it
+ * \note   With hardware flow control enabled, kernel drives RTS by itself
+ *            and this function only overrides it until tty buffer state changes
  * \param  *LL: Pointer to \ref GSM_LL_t structure with settings
- * \param  state: State for reset pin, it can be high or low. Check \ref GSM_RTS_SET and \ref GSM_RTS_CLR
+ * \param  state: State for RTS pin, it can be high or low. Check \ref GSM_RTS_SET and \ref GSM_RTS_CLR
  * \retval Success status:
  *            - 0: Successful
  *            - > 0: Error
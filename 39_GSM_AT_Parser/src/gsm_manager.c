@@ -0,0 +1,250 @@
+/*
+ ============================================================================
+ Name        : gsm_manager.c
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 用一个epoll线程驱动多个GSM模块
+ ============================================================================
+ */
+#include "gsm_manager.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+/* 唤醒管道在epoll中的标识 */
+#define MANAGER_WAKE_ID                     0xFFFFFFFF
+
+/* read出错(EAGAIN除外)，或者epoll报告挂断时read返回0，说明设备已经断开
+ * VMIN=0的tty没有数据时也返回0，所以单独的0不能说明断开 */
+#define MANAGER_READ_GONE(n, hup)           ((n) == 0 ? (hup) : errno != EAGAIN && errno != EINTR)
+
+/**
+ * 获取单调时钟，单位毫秒
+ * @return 当前时间
+ */
+static uint64_t Manager_Millis(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * 各GSM实例的事件回调，转交给管理器的回调并带上模块序号
+ */
+static int Manager_EventCallback(GSM_t* GSM, GSM_Event_t Event,
+		GSM_EventParams_t* Params) {
+	GSM_Modem_t* modem = (GSM_Modem_t *) GSM->UserParameters;
+
+	if (Event == gsmEventCmdQueued) { /* 其他线程入队时唤醒epoll_wait，空闲的模块马上发出命令 */
+		if (!pthread_equal(pthread_self(), modem->Manager->Thread)
+				&& write(modem->Manager->WakeFD[1], "", 1) < 0) { /* 管道满说明已经有唤醒在等待 */
+		}
+		return 0;
+	}
+	if (modem->Manager->Callback) {
+		modem->Manager->Callback(modem->Manager, modem->Index, Event, Params);
+	}
+	return 0;
+}
+
+/**
+ * 把tty中可读的数据全部送入模块的环形缓存
+ * @param  modem 模块
+ * @param  hup   epoll报告了EPOLLHUP或者EPOLLERR
+ * @return       设备已经断开返回-1，否则返回0
+ */
+static int Manager_Read(GSM_Modem_t* modem, uint8_t hup) {
+	uint8_t data[GSM_BUFFER_SIZE];
+	uint8_t* raw;
+	uint32_t free;
+	ssize_t n;
+
+	while (1) {
+		raw = GSM_RawBuffer(modem->GSM, &free);
+		if (raw != NULL) { /* 原始数据直接读入用户缓存 */
+			n = read(modem->GSM->LL.FD, raw, free);
+			if (n <= 0) {
+				return MANAGER_READ_GONE(n, hup) ? -1 : 0;
+			}
+			GSM_RawCommit(modem->GSM, n);
+			continue;
+		}
+		free = BUFFER_GetFree(&modem->GSM->Buffer);
+		if (free == 0) { /* 环形缓存满，先解析再继续读 */
+			GSM_Update(modem->GSM);
+			continue;
+		}
+		n = read(modem->GSM->LL.FD, data, free);
+		if (n <= 0) { /* EAGAIN表示已经读完 */
+			return MANAGER_READ_GONE(n, hup) ? -1 : 0;
+		}
+		GSM_DataReceived(modem->GSM, data, n);
+	}
+}
+
+/**
+ * 设备断开后从epoll中移除并关闭，否则水平触发的EPOLLHUP会让线程空转
+ * 模块中未完成的命令在超时后结束
+ * @param modem 模块
+ */
+static void Manager_Close(GSM_Modem_t* modem) {
+	GSM_EventParams_t params;
+
+	epoll_ctl(modem->Manager->EpollFD, EPOLL_CTL_DEL, modem->GSM->LL.FD, NULL);
+	GSM_LL_DeInit(&modem->GSM->LL);
+	modem->Writing = 0;
+	if (modem->Manager->Callback) {
+		memset(&params, 0x00, sizeof(params));
+		modem->Manager->Callback(modem->Manager, modem->Index,
+				gsmEventDisconnected, &params);
+	}
+}
+
+/**
+ * 发送队列中还有数据时关注EPOLLOUT，发送完后取消
+ * @param modem 模块
+ */
+static void Manager_Arm(GSM_Modem_t* modem) {
+	struct epoll_event ev;
+	uint8_t writing = GSM_LL_TxPending(&modem->GSM->LL) > 0;
+
+	if (modem->GSM->LL.FD < 0) { /* 设备已经断开 */
+		return;
+	}
+	if (writing != modem->Writing) {
+		ev.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+		ev.data.u32 = modem->Index;
+		epoll_ctl(modem->Manager->EpollFD, EPOLL_CTL_MOD, modem->GSM->LL.FD,
+				&ev);
+		modem->Writing = writing;
+	}
+}
+
+/**
+ * 事件循环线程
+ * @param  arg 管理器指针
+ * @return     NULL
+ */
+static void* Manager_Thread(void* arg) {
+	GSM_Manager_t* Manager = (GSM_Manager_t *) arg;
+	struct epoll_event events[GSM_MANAGER_MAX_MODEMS + 1];
+	uint64_t now;
+	uint32_t id;
+	int i, n;
+	char ch;
+
+	Manager->LastTime = Manager_Millis();
+	while (Manager->Running) {
+		n = epoll_wait(Manager->EpollFD, events,
+				sizeof(events) / sizeof(events[0]), GSM_MANAGER_TICK);
+		if (n < 0 && errno != EINTR) {
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			id = events[i].data.u32;
+			if (id == MANAGER_WAKE_ID) {
+				while (read(Manager->WakeFD[0], &ch, 1) > 0) {
+				}
+				continue;
+			}
+			if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+					&& Manager_Read(&Manager->Modems[id],
+							(events[i].events & (EPOLLERR | EPOLLHUP)) != 0) < 0) {
+				Manager_Close(&Manager->Modems[id]);
+				continue;
+			}
+			if (events[i].events & EPOLLOUT) { /* tty可写，继续发送队列中的数据 */
+				GSM_LL_Flush(&Manager->Modems[id].GSM->LL);
+			}
+		}
+		/* 更新时间，轮流运行每个模块的解析和命令队列 */
+		now = Manager_Millis();
+		for (i = 0; i < Manager->Count; i++) {
+			GSM_UpdateTime(Manager->Modems[i].GSM,
+					(uint32_t) (now - Manager->LastTime));
+			GSM_Update(Manager->Modems[i].GSM);
+			Manager_Arm(&Manager->Modems[i]);
+		}
+		Manager->LastTime = now;
+	}
+	return NULL;
+}
+
+GSM_Result_t GSM_Manager_Init(GSM_Manager_t* Manager,
+		GSM_Manager_EventCallback_t Callback) {
+	struct epoll_event ev;
+
+	memset(Manager, 0x00, sizeof(GSM_Manager_t));
+	Manager->Callback = Callback;
+	Manager->EpollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (Manager->EpollFD < 0) {
+		return gsmSYSERROR;
+	}
+	if (pipe(Manager->WakeFD) < 0) {
+		close(Manager->EpollFD);
+		return gsmSYSERROR;
+	}
+	fcntl(Manager->WakeFD[0], F_SETFL, O_NONBLOCK);
+	fcntl(Manager->WakeFD[1], F_SETFL, O_NONBLOCK);
+	ev.events = EPOLLIN;
+	ev.data.u32 = MANAGER_WAKE_ID;
+	epoll_ctl(Manager->EpollFD, EPOLL_CTL_ADD, Manager->WakeFD[0], &ev);
+	return gsmOK;
+}
+
+int GSM_Manager_Add(GSM_Manager_t* Manager, GSM_t* GSM, const char* Device,
+		uint32_t Baudrate, uint8_t FlowControl) {
+	GSM_Modem_t* modem;
+	struct epoll_event ev;
+
+	if (Manager->Count >= GSM_MANAGER_MAX_MODEMS || Manager->Running) {
+		return -1;
+	}
+	modem = &Manager->Modems[Manager->Count];
+	modem->GSM = GSM;
+	modem->Manager = Manager;
+	modem->Index = Manager->Count;
+	GSM->LL.Device = Device;
+	GSM->LL.FlowControl = FlowControl;
+	GSM->UserParameters = modem;
+	if (GSM_Init(GSM, Baudrate, Manager_EventCallback) != gsmOK) {
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.u32 = modem->Index;
+	if (epoll_ctl(Manager->EpollFD, EPOLL_CTL_ADD, GSM->LL.FD, &ev) < 0) {
+		GSM_LL_DeInit(&GSM->LL);
+		return -1;
+	}
+	return Manager->Count++;
+}
+
+GSM_Result_t GSM_Manager_Start(GSM_Manager_t* Manager) {
+	Manager->Running = 1;
+	if (pthread_create(&Manager->Thread, NULL, Manager_Thread, Manager) != 0) {
+		Manager->Running = 0;
+		return gsmSYSERROR;
+	}
+	return gsmOK;
+}
+
+GSM_Result_t GSM_Manager_DeInit(GSM_Manager_t* Manager) {
+	uint8_t i;
+
+	if (Manager->Running) {
+		Manager->Running = 0;
+		if (write(Manager->WakeFD[1], "", 1) < 0) { /* 唤醒epoll_wait */
+		}
+		pthread_join(Manager->Thread, NULL);
+	}
+	for (i = 0; i < Manager->Count; i++) {
+		GSM_LL_DeInit(&Manager->Modems[i].GSM->LL);
+	}
+	close(Manager->WakeFD[0]);
+	close(Manager->WakeFD[1]);
+	close(Manager->EpollFD);
+	return gsmOK;
+}
@@ -0,0 +1,98 @@
+/*
+ ============================================================================
+ Name        : gsm_manager.h
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 用一个epoll线程驱动多个GSM模块
+ ============================================================================
+ */
+
+#ifndef GSM_MANAGER_H_
+#define GSM_MANAGER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include "GSM_AT_Parser.h"
+
+struct _GSM_Manager_t;
+
+/**
+ * 模块事件回调函数
+ * @param Manager 管理器指针
+ * @param Index   产生事件的模块序号，即GSM_Manager_Add的返回值
+ * @param Event   事件
+ * @param Params  事件参数
+ */
+typedef void (*GSM_Manager_EventCallback_t)(struct _GSM_Manager_t* Manager,
+		uint8_t Index, GSM_Event_t Event, GSM_EventParams_t* Params);
+
+/*
+ * 管理器中的一个模块
+ */
+typedef struct _GSM_Modem_t {
+	GSM_t* GSM; //模块的GSM工作结构体
+	struct _GSM_Manager_t* Manager; //所属的管理器
+	uint8_t Index; //模块序号
+	uint8_t Writing; //发送队列中有数据，正在等待EPOLLOUT
+} GSM_Modem_t;
+
+/*
+ * GSM多模块管理器
+ */
+typedef struct _GSM_Manager_t {
+	int EpollFD; //epoll实例
+	int WakeFD[2]; //用于唤醒线程的管道
+	pthread_t Thread; //事件循环线程
+	volatile uint8_t Running; //线程运行标志
+	GSM_Modem_t Modems[GSM_MANAGER_MAX_MODEMS]; //模块列表
+	uint8_t Count; //模块数量
+	uint64_t LastTime; //上次更新时间，单位毫秒
+	GSM_Manager_EventCallback_t Callback; //模块事件回调函数
+	void* UserParameters; //用户数据指针，可选
+} GSM_Manager_t;
+
+/**
+ * 初始化管理器
+ * @param  Manager  管理器指针
+ * @param  Callback 模块事件回调函数，可以为NULL
+ * @return          成功返回gsmOK，系统调用出错返回gsmSYSERROR
+ */
+GSM_Result_t GSM_Manager_Init(GSM_Manager_t* Manager,
+		GSM_Manager_EventCallback_t Callback);
+
+/**
+ * 打开tty设备，初始化GSM实例并加入管理器，必须在GSM_Manager_Start之前调用
+ * @param  Manager     管理器指针
+ * @param  GSM         GSM工作结构体指针，在管理器销毁前必须保持有效
+ * @param  Device      tty设备路径
+ * @param  Baudrate    波特率，最高支持921600
+ * @param  FlowControl 为1时使能RTS/CTS硬件流控
+ * @return             成功返回模块序号，失败返回-1
+ */
+int GSM_Manager_Add(GSM_Manager_t* Manager, GSM_t* GSM, const char* Device,
+		uint32_t Baudrate, uint8_t FlowControl);
+
+/**
+ * 启动事件循环线程，轮流读取各模块的数据并运行各模块的protothread
+ * tty断开时关闭该设备，并通过回调上报gsmEventDisconnected
+ * @param  Manager 管理器指针
+ * @return         成功返回gsmOK，创建线程失败返回gsmSYSERROR
+ */
+GSM_Result_t GSM_Manager_Start(GSM_Manager_t* Manager);
+
+/**
+ * 停止事件循环线程，关闭所有tty设备
+ * @param  Manager 管理器指针
+ * @return         成功返回gsmOK
+ */
+GSM_Result_t GSM_Manager_DeInit(GSM_Manager_t* Manager);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GSM_MANAGER_H_ */
@@ -0,0 +1,328 @@
+/*
+ ============================================================================
+ Name        : gsm_sim.c
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 在主机上用pty模拟GSM模块，按场景脚本回放AT交互
+ ============================================================================
+ */
+#define _GNU_SOURCE
+#include "gsm_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* 等待命令时检查停止标志的间隔，单位毫秒 */
+#define SIM_POLL_INTERVAL                   50
+
+/**
+ * 获取单调时钟，单位微秒
+ * @return 当前时间
+ */
+static uint64_t Sim_Micros(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void Sim_SleepUntil(uint64_t us) {
+	uint64_t now = Sim_Micros();
+	struct timespec ts;
+
+	if (us > now) {
+		ts.tv_sec = (us - now) / 1000000;
+		ts.tv_nsec = (us - now) % 1000000 * 1000;
+		nanosleep(&ts, NULL);
+	}
+}
+
+/**
+ * 按模拟的波特率发送数据，每个字节按10位计算
+ * @param Sim  模拟器指针
+ * @param data 数据
+ * @param len  数据长度
+ */
+static void Sim_Send(GSM_Sim_t* Sim, const void* data, uint32_t len) {
+	const uint8_t* ptr = (const uint8_t *) data;
+	uint32_t chunk = len;
+	ssize_t n;
+
+	if (Sim->Baudrate) { /* 每次发送约1毫秒的数据 */
+		chunk = Sim->Baudrate / 10000 + 1;
+		if (Sim->TxDone < Sim_Micros()) {
+			Sim->TxDone = Sim_Micros();
+		}
+	}
+	while (len > 0 && Sim->Running) {
+		n = write(Sim->Master, ptr, len < chunk ? len : chunk);
+		if (n < 0) {
+			if (errno == EAGAIN) {
+				struct pollfd pfd = { Sim->Master, POLLOUT, 0 };
+				poll(&pfd, 1, SIM_POLL_INTERVAL);
+				continue;
+			}
+			return;
+		}
+		ptr += n;
+		len -= n;
+		if (Sim->Baudrate) { /* 线路上发送n个字节需要的时间 */
+			Sim->TxDone += (uint64_t) n * 10 * 1000000 / Sim->Baudrate;
+			Sim_SleepUntil(Sim->TxDone);
+		}
+	}
+}
+
+static void Sim_SendLine(GSM_Sim_t* Sim, const char* line) {
+	Sim_Send(Sim, line, strlen(line));
+	Sim_Send(Sim, "\r\n", 2);
+}
+
+/**
+ * 发送到期的主动上报
+ * @param  Sim 模拟器指针
+ * @return     距离下一条主动上报到期的毫秒数，没有时返回SIM_POLL_INTERVAL
+ */
+static int Sim_Inject(GSM_Sim_t* Sim) {
+	uint64_t elapsed = (Sim_Micros() - Sim->StartTime) / 1000;
+	int wait = SIM_POLL_INTERVAL;
+	uint16_t i;
+	uint8_t bit = 0;
+
+	for (i = 0; i < Sim->StepCount && bit < 32; i++) {
+		if (Sim->Steps[i].Op != '!') {
+			continue;
+		}
+		if (!(Sim->Injected & (1UL << bit))) {
+			if (Sim->Steps[i].Num <= elapsed) {
+				Sim_SendLine(Sim, Sim->Steps[i].Text);
+				Sim->Injected |= 1UL << bit;
+			} else if (Sim->Steps[i].Num - elapsed < (uint64_t) wait) {
+				wait = Sim->Steps[i].Num - elapsed;
+			}
+		}
+		bit++;
+	}
+	return wait;
+}
+
+/**
+ * 接收一条主机发来的命令，等待期间发送到期的主动上报
+ * @param  Sim 模拟器指针
+ * @return     收到命令返回1，线程停止返回0
+ */
+static int Sim_ReadLine(GSM_Sim_t* Sim) {
+	struct pollfd pfd;
+	char ch;
+	ssize_t n;
+
+	while (Sim->Running) {
+		n = read(Sim->Master, &ch, 1);
+		if (n == 1) {
+			if (ch == '\r' || ch == 0x1A) { /* 命令或者短信内容结束 */
+				Sim->Line[Sim->LineLength] = 0;
+				Sim->LineLength = 0;
+				Sim->Commands++;
+				return 1;
+			}
+			if (ch != '\n' && Sim->LineLength < sizeof(Sim->Line) - 1) {
+				Sim->Line[Sim->LineLength++] = ch;
+			}
+			continue;
+		}
+		pfd.fd = Sim->Master;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, Sim_Inject(Sim)) > 0 && (pfd.revents & POLLHUP)) {
+			usleep(SIM_POLL_INTERVAL * 1000); /* 从设备还没有打开 */
+		}
+	}
+	return 0;
+}
+
+/**
+ * 场景执行线程
+ * @param  arg 模拟器指针
+ * @return     NULL
+ */
+static void* Sim_Thread(void* arg) {
+	GSM_Sim_t* Sim = (GSM_Sim_t *) arg;
+	GSM_SimStep_t* step;
+	uint16_t pc = 0;
+	uint32_t i;
+	uint8_t data[256];
+
+	while (Sim->Running) {
+		if (pc >= Sim->StepCount) { /* 脚本结束，只读取不回复 */
+			if (!Sim_ReadLine(Sim)) {
+				break;
+			}
+			continue;
+		}
+		step = &Sim->Steps[pc];
+		switch (step->Op) {
+		case '>':
+			if (!Sim_ReadLine(Sim)) {
+				break;
+			}
+			if (strcmp(step->Text, "*") == 0
+					|| strncmp(Sim->Line, step->Text, strlen(step->Text)) == 0) {
+				pc++;
+			} else {
+				Sim->Mismatches++;
+				Sim_SendLine(Sim, "\r\nERROR");
+			}
+			break;
+		case '<':
+			Sim_SendLine(Sim, step->Text);
+			pc++;
+			break;
+		case '=':
+			Sim_Send(Sim, step->Text, strlen(step->Text));
+			pc++;
+			break;
+		case '$': /* 可以校验的数据 */
+			for (i = 0; i < step->Num; i += sizeof(data)) {
+				uint32_t j, n = step->Num - i;
+				if (n > sizeof(data)) {
+					n = sizeof(data);
+				}
+				for (j = 0; j < n; j++) {
+					data[j] = (uint8_t) (i + j);
+				}
+				Sim_Send(Sim, data, n);
+			}
+			pc++;
+			break;
+		case '~':
+			Sim_SleepUntil(Sim_Micros() + (uint64_t) step->Num * 1000);
+			pc++;
+			break;
+		case '@':
+			pc = 0;
+			break;
+		default: /* 主动上报在等待命令时处理 */
+			pc++;
+			break;
+		}
+		Sim_Inject(Sim);
+	}
+	return NULL;
+}
+
+/**
+ * 解析场景脚本
+ * @param  Sim 模拟器指针
+ * @return     成功返回0，指令过多返回-1
+ */
+static int Sim_Parse(GSM_Sim_t* Sim) {
+	char* line = Sim->Script;
+	char* next;
+	GSM_SimStep_t* step;
+
+	Sim->StepCount = 0;
+	for (; line; line = next) {
+		next = strchr(line, '\n');
+		if (next) {
+			*next++ = 0;
+		}
+		line[strcspn(line, "\r")] = 0;
+		if (strchr("<>=$~!@", line[0]) == NULL || line[0] == 0) { /* 空行和注释 */
+			continue;
+		}
+		if (Sim->StepCount >= GSM_SIM_MAX_STEPS) {
+			return -1;
+		}
+		step = &Sim->Steps[Sim->StepCount++];
+		step->Op = line[0];
+		step->Text = line + 1;
+		if (*step->Text == ' ') {
+			step->Text++;
+		}
+		step->Num = strtoul(step->Text, &step->Text, 10);
+		if (step->Op != '$' && step->Op != '~' && step->Op != '!') {
+			step->Num = 0;
+			step->Text = line[1] == ' ' ? line + 2 : line + 1;
+		} else if (*step->Text == ' ') {
+			step->Text++;
+		}
+	}
+	return 0;
+}
+
+int GSM_Sim_Start(GSM_Sim_t* Sim, const char* Scenario, uint32_t Baudrate) {
+	struct termios tio;
+
+	memset(Sim, 0x00, sizeof(GSM_Sim_t));
+	Sim->Baudrate = Baudrate;
+	Sim->Script = strdup(Scenario);
+	if (Sim->Script == NULL || Sim_Parse(Sim) < 0) {
+		free(Sim->Script);
+		return -1;
+	}
+	Sim->Master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (Sim->Master < 0 || grantpt(Sim->Master) < 0
+			|| unlockpt(Sim->Master) < 0
+			|| ptsname_r(Sim->Master, Sim->Slave, sizeof(Sim->Slave)) != 0) {
+		goto error;
+	}
+	/* 从设备打开前就设置成原始模式，避免回显 */
+	if (tcgetattr(Sim->Master, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(Sim->Master, TCSANOW, &tio);
+	}
+	Sim->Running = 1;
+	Sim->StartTime = Sim_Micros();
+	if (pthread_create(&Sim->Thread, NULL, Sim_Thread, Sim) != 0) {
+		goto error;
+	}
+	return 0;
+
+error:
+	if (Sim->Master >= 0) {
+		close(Sim->Master);
+	}
+	free(Sim->Script);
+	Sim->Running = 0;
+	return -1;
+}
+
+int GSM_Sim_Load(GSM_Sim_t* Sim, const char* File, uint32_t Baudrate) {
+	FILE* fp = fopen(File, "r");
+	char* text;
+	long size;
+	int ret;
+
+	if (fp == NULL) {
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = (char *) malloc(size + 1);
+	if (text == NULL) {
+		fclose(fp);
+		return -1;
+	}
+	size = fread(text, 1, size, fp);
+	text[size] = 0;
+	fclose(fp);
+	ret = GSM_Sim_Start(Sim, text, Baudrate);
+	free(text);
+	return ret;
+}
+
+void GSM_Sim_Stop(GSM_Sim_t* Sim) {
+	if (!Sim->Running) {
+		return;
+	}
+	Sim->Running = 0;
+	pthread_join(Sim->Thread, NULL);
+	close(Sim->Master);
+	free(Sim->Script);
+}
@@ -0,0 +1,94 @@
+/*
+ ============================================================================
+ Name        : gsm_sim.h
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 在主机上用pty模拟GSM模块，按场景脚本回放AT交互
+ ============================================================================
+ */
+
+#ifndef GSM_SIM_H_
+#define GSM_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+#include "gsm_config.h"
+
+/*
+ * 场景脚本按行解释，行首字符为指令：
+ *   # 注释
+ *   > AT+CSQ      等待主机发来以AT+CSQ开头的命令(以\r或者Ctrl+Z结束)，不匹配时回复ERROR
+ *   > *           等待任意一条命令
+ *   < +CSQ: 21,0  发送一行，自动加上\r\n
+ *   = >           发送数据，不加\r\n，如短信的'> '提示符
+ *   $ 1024        发送1024字节的原始数据，用于HTTPREAD等数据读取
+ *   ~ 200         延时200毫秒
+ *   ! 500 RING    与脚本进度无关，模拟器启动500毫秒后发送一行主动上报，只发送一次
+ *   @             回到脚本开头循环执行
+ * 脚本执行完后不再回复任何命令，可以用来测试超时
+ */
+
+/*
+ * 场景中的一条指令
+ */
+typedef struct _GSM_SimStep_t {
+	char Op; //指令字符
+	uint32_t Num; //数字参数
+	char* Text; //文本参数
+} GSM_SimStep_t;
+
+/*
+ * 模拟的GSM模块
+ */
+typedef struct _GSM_Sim_t {
+	int Master; //pty主设备
+	char Slave[64]; //pty从设备路径，作为GSM_LL_t.Device
+	uint32_t Baudrate; //模拟的波特率，发送数据按此速率限速，为0时不限速
+	pthread_t Thread; //场景执行线程
+	volatile uint8_t Running; //线程运行标志
+	char* Script; //场景脚本副本，Steps中的文本指向这里
+	GSM_SimStep_t Steps[GSM_SIM_MAX_STEPS]; //解析后的指令
+	uint16_t StepCount; //指令数量
+	char Line[GSM_CMD_MAX_LENGTH]; //正在接收的命令行
+	uint16_t LineLength; //命令行长度
+	uint64_t StartTime; //模拟器启动时间，单位微秒
+	uint64_t TxDone; //限速发送时上一块数据发送完的时间，单位微秒
+	uint32_t Injected; //已经发送的主动上报，按位表示
+	volatile uint32_t Commands; //收到的命令数量
+	volatile uint32_t Mismatches; //与脚本不匹配的命令数量
+} GSM_Sim_t;
+
+/**
+ * 创建pty并启动场景执行线程
+ * @param  Sim      模拟器指针
+ * @param  Scenario 场景脚本文本
+ * @param  Baudrate 模拟的波特率，为0时不限速
+ * @return          成功返回0，失败返回-1
+ */
+int GSM_Sim_Start(GSM_Sim_t* Sim, const char* Scenario, uint32_t Baudrate);
+
+/**
+ * 读取场景脚本文件并启动模拟器
+ * @param  Sim      模拟器指针
+ * @param  File     场景脚本文件路径
+ * @param  Baudrate 模拟的波特率，为0时不限速
+ * @return          成功返回0，失败返回-1
+ */
+int GSM_Sim_Load(GSM_Sim_t* Sim, const char* File, uint32_t Baudrate);
+
+/**
+ * 停止场景执行线程并关闭pty
+ * @param Sim 模拟器指针
+ */
+void GSM_Sim_Stop(GSM_Sim_t* Sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GSM_SIM_H_ */
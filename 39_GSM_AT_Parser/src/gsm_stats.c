@@ -0,0 +1,183 @@
+/*
+ ============================================================================
+ Name        : gsm_stats.c
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 按命令代码统计AT命令的延时、超时和protothread调度次数
+ ============================================================================
+ */
+#include "gsm_stats.h"
+#include "GSM_AT_Parser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STATS_SUB_COUNT                     (1 << GSM_STATS_SUB_BITS)
+
+/**
+ * 计算数值所在的区间
+ * @param  value 数值
+ * @return       区间序号
+ */
+static uint16_t Stats_Bucket(uint32_t value) {
+	uint8_t msb;
+
+	if (value < STATS_SUB_COUNT) { /* 小数值线性区间 */
+		return value;
+	}
+	msb = 31 - __builtin_clz(value);
+	if (msb >= GSM_STATS_MAX_BITS) { /* 最高区间是[2^(MAX_BITS-1), 2^MAX_BITS)，更大的数值都计入最后一格 */
+		return GSM_STATS_BUCKETS - 1;
+	}
+	return ((msb - GSM_STATS_SUB_BITS + 1) << GSM_STATS_SUB_BITS)
+			+ ((value >> (msb - GSM_STATS_SUB_BITS)) & (STATS_SUB_COUNT - 1));
+}
+
+/**
+ * 计算区间的上界
+ * @param  bucket 区间序号
+ * @return        区间内的最大值
+ */
+static uint32_t Stats_BucketMax(uint16_t bucket) {
+	uint8_t shift;
+
+	if (bucket < 2 * STATS_SUB_COUNT) {
+		return bucket;
+	}
+	shift = (bucket >> GSM_STATS_SUB_BITS) - 1;
+	return (((uint32_t) (STATS_SUB_COUNT | (bucket & (STATS_SUB_COUNT - 1)))
+			+ 1) << shift) - 1;
+}
+
+static void Stats_Add(GSM_Histogram_t* hist, uint32_t value) {
+	hist->Counts[Stats_Bucket(value)]++;
+	hist->Total++;
+	hist->Sum += value;
+	if (value > hist->Max) {
+		hist->Max = value;
+	}
+}
+
+int GSM_Stats_Init(GSM_Stats_t* Stats) {
+	memset(Stats, 0x00, sizeof(GSM_Stats_t));
+	return pthread_mutex_init(&Stats->Lock, NULL) == 0 ? 0 : -1;
+}
+
+void GSM_Stats_Reset(GSM_Stats_t* Stats) {
+	pthread_mutex_lock(&Stats->Lock);
+	memset(Stats->Cmds, 0x00, sizeof(Stats->Cmds));
+	Stats->Overflow = 0;
+	pthread_mutex_unlock(&Stats->Lock);
+}
+
+uint64_t GSM_Stats_Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void GSM_Stats_Record(GSM_Stats_t* Stats, uint16_t Cmd, uint32_t FirstByte,
+		uint32_t Final, uint8_t Result, uint32_t Resumes) {
+	GSM_CmdStats_t* cmd = NULL;
+	uint8_t i;
+
+	pthread_mutex_lock(&Stats->Lock);
+	for (i = 0; i < GSM_STATS_MAX_CMDS; i++) { /* 查找或者分配命令的统计项 */
+		if (Stats->Cmds[i].Count == 0 || Stats->Cmds[i].Cmd == Cmd) {
+			cmd = &Stats->Cmds[i];
+			break;
+		}
+	}
+	if (cmd == NULL) {
+		Stats->Overflow++;
+		pthread_mutex_unlock(&Stats->Lock);
+		return;
+	}
+	cmd->Cmd = Cmd;
+	cmd->Count++;
+	if (Result == 1) {
+		cmd->Errors++;
+	} else if (Result == 2) {
+		cmd->Timeouts++;
+	}
+	cmd->Resumes += Resumes;
+	if (FirstByte != GSM_STATS_NO_DATA) {
+		Stats_Add(&cmd->FirstByte, FirstByte);
+	}
+	Stats_Add(&cmd->Final, Final);
+	pthread_mutex_unlock(&Stats->Lock);
+}
+
+void GSM_Stats_Snapshot(GSM_Stats_t* Stats, GSM_Stats_t* Snapshot) {
+	pthread_mutex_lock(&Stats->Lock);
+	memcpy(Snapshot->Cmds, Stats->Cmds, sizeof(Stats->Cmds));
+	Snapshot->Overflow = Stats->Overflow;
+	pthread_mutex_unlock(&Stats->Lock);
+}
+
+uint32_t GSM_Stats_Percentile(const GSM_Histogram_t* Hist, double Percent) {
+	uint64_t target, count = 0;
+	uint16_t i;
+
+	if (Hist->Total == 0) {
+		return 0;
+	}
+	target = (uint64_t) (Hist->Total * Percent / 100.0 + 0.5);
+	if (target == 0) {
+		target = 1;
+	}
+	for (i = 0; i < GSM_STATS_BUCKETS; i++) {
+		count += Hist->Counts[i];
+		if (count >= target) {
+			if (i == GSM_STATS_BUCKETS - 1) { /* 最后一格没有上界 */
+				return Hist->Max;
+			}
+			return Stats_BucketMax(i) < Hist->Max ? Stats_BucketMax(i) : Hist->Max;
+		}
+	}
+	return Hist->Max;
+}
+
+static int Stats_CompareSum(const void* a, const void* b) {
+	const GSM_CmdStats_t* x = *(const GSM_CmdStats_t * const *) a;
+	const GSM_CmdStats_t* y = *(const GSM_CmdStats_t * const *) b;
+	return x->Final.Sum < y->Final.Sum ? 1 : x->Final.Sum > y->Final.Sum ? -1 : 0;
+}
+
+void GSM_Stats_Print(const GSM_Stats_t* Stats, FILE* fp) {
+	const GSM_CmdStats_t* cmds[GSM_STATS_MAX_CMDS];
+	const GSM_CmdStats_t* cmd;
+	const char* name;
+	uint8_t i, n = 0;
+
+	for (i = 0; i < GSM_STATS_MAX_CMDS; i++) {
+		if (Stats->Cmds[i].Count) {
+			cmds[n++] = &Stats->Cmds[i];
+		}
+	}
+	qsort(cmds, n, sizeof(cmds[0]), Stats_CompareSum);
+	fprintf(fp, "%-12s %8s %6s %6s %8s %10s %10s %10s %10s %10s %12s\r\n",
+			"cmd", "count", "error", "tmout", "resume", "first p50",
+			"first p99", "final p50", "final p99", "final max", "total ms");
+	for (i = 0; i < n; i++) {
+		cmd = cmds[i];
+		name = GSM_CMD_Name(cmd->Cmd);
+		if (name != NULL) {
+			fprintf(fp, "AT%-10s", name);
+		} else {
+			fprintf(fp, "0x%04X      ", cmd->Cmd);
+		}
+		fprintf(fp, " %8u %6u %6u %8.1f %10u %10u %10u %10u %10u %12.1f\r\n",
+				cmd->Count, cmd->Errors, cmd->Timeouts,
+				(double) cmd->Resumes / cmd->Count,
+				GSM_Stats_Percentile(&cmd->FirstByte, 50),
+				GSM_Stats_Percentile(&cmd->FirstByte, 99),
+				GSM_Stats_Percentile(&cmd->Final, 50),
+				GSM_Stats_Percentile(&cmd->Final, 99), cmd->Final.Max,
+				cmd->Final.Sum / 1000.0);
+	}
+	if (Stats->Overflow) {
+		fprintf(fp, "%u commands not recorded\r\n", Stats->Overflow);
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ ============================================================================
+ Name        : gsm_stats.h
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 按命令代码统计AT命令的延时、超时和protothread调度次数
+ ============================================================================
+ */
+
+#ifndef GSM_STATS_H_
+#define GSM_STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "gsm_config.h"
+
+/*
+ * 对数线性直方图：每个2的幂区间再等分成2^GSM_STATS_SUB_BITS份，相对误差不超过1/2^GSM_STATS_SUB_BITS
+ * 数值单位为微秒，不小于2^GSM_STATS_MAX_BITS(约134秒)的数值计入最后一个区间
+ */
+#define GSM_STATS_SUB_BITS                  3
+#define GSM_STATS_MAX_BITS                  27
+#define GSM_STATS_BUCKETS                   ((GSM_STATS_MAX_BITS - GSM_STATS_SUB_BITS + 1) << GSM_STATS_SUB_BITS)
+
+/* 没有收到任何数据时的首字节延时 */
+#define GSM_STATS_NO_DATA                   0xFFFFFFFF
+
+typedef struct _GSM_Histogram_t {
+	uint32_t Counts[GSM_STATS_BUCKETS]; //各区间的计数
+	uint32_t Total; //总计数
+	uint32_t Max; //最大值
+	uint64_t Sum; //数值总和，用于计算平均值
+} GSM_Histogram_t;
+
+/*
+ * 一种命令的统计
+ */
+typedef struct _GSM_CmdStats_t {
+	uint16_t Cmd; //命令代码，CMD_IDLE表示未使用
+	uint32_t Count; //完成的命令数
+	uint32_t Errors; //收到ERROR的命令数
+	uint32_t Timeouts; //超时的命令数
+	uint64_t Resumes; //执行期间protothread被调度的总次数
+	GSM_Histogram_t FirstByte; //从发出命令到收到第一个字节的延时
+	GSM_Histogram_t Final; //从发出命令到收到最终结果或者超时的延时
+} GSM_CmdStats_t;
+
+/*
+ * 统计对象，可以被多个GSM实例共享，统计整个模块群
+ */
+typedef struct _GSM_Stats_t {
+	pthread_mutex_t Lock; //记录和快照之间的互斥锁
+	GSM_CmdStats_t Cmds[GSM_STATS_MAX_CMDS]; //各命令的统计
+	uint32_t Overflow; //命令种类过多而没有统计的命令数
+} GSM_Stats_t;
+
+/**
+ * 初始化统计对象
+ * @param  Stats 统计对象指针
+ * @return       成功返回0，失败返回-1
+ */
+int GSM_Stats_Init(GSM_Stats_t* Stats);
+
+/**
+ * 清空统计数据
+ * @param Stats 统计对象指针
+ */
+void GSM_Stats_Reset(GSM_Stats_t* Stats);
+
+/**
+ * 获取单调时钟，单位微秒，作为统计的时间基准
+ * @return 当前时间
+ */
+uint64_t GSM_Stats_Now(void);
+
+/**
+ * 记录一条执行完成的命令，由解析器调用
+ * @param Stats     统计对象指针
+ * @param Cmd       命令代码
+ * @param FirstByte 首字节延时，单位微秒，没有收到数据时为GSM_STATS_NO_DATA
+ * @param Final     最终结果延时，单位微秒
+ * @param Result    0为成功，1为ERROR，2为超时
+ * @param Resumes   执行期间protothread被调度的次数
+ */
+void GSM_Stats_Record(GSM_Stats_t* Stats, uint16_t Cmd, uint32_t FirstByte,
+		uint32_t Final, uint8_t Result, uint32_t Resumes);
+
+/**
+ * 复制一份一致的统计数据，可以在其他线程中调用
+ * @param Stats    统计对象指针
+ * @param Snapshot 保存快照，其中的Lock不可用
+ */
+void GSM_Stats_Snapshot(GSM_Stats_t* Stats, GSM_Stats_t* Snapshot);
+
+/**
+ * 计算直方图的百分位数
+ * @param  Hist    直方图
+ * @param  Percent 百分位，0~100
+ * @return         百分位数，返回所在区间的上界，单位微秒
+ */
+uint32_t GSM_Stats_Percentile(const GSM_Histogram_t* Hist, double Percent);
+
+/**
+ * 按总延时从大到小打印各命令的统计
+ * @param Stats 统计对象或者快照
+ * @param fp    输出文件
+ */
+void GSM_Stats_Print(const GSM_Stats_t* Stats, FILE* fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GSM_STATS_H_ */
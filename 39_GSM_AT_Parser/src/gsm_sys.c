@@ -32,17 +32,65 @@
 /******************************************************************************/
 
 uint8_t GSM_SYS_Create(GSM_RTOS_SYNC_t* Sync) {
-	return 0;
+	pthread_mutexattr_t attr;
+	uint8_t ret;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); /* Callbacks may call API again */
+	ret = pthread_mutex_init(Sync, &attr) != 0; /* Create mutex */
+	pthread_mutexattr_destroy(&attr);
+	return ret;
 }
 
 uint8_t GSM_SYS_Delete(GSM_RTOS_SYNC_t* Sync) {
-	return 0;
+	return pthread_mutex_destroy(Sync) != 0; /* Delete mutex */
 }
 
 uint8_t GSM_SYS_Request(GSM_RTOS_SYNC_t* Sync) {
-	return 0;
+	return pthread_mutex_lock(Sync) != 0; /* Lock mutex */
 }
 
 uint8_t GSM_SYS_Release(GSM_RTOS_SYNC_t* Sync) {
-	return 0;
+	return pthread_mutex_unlock(Sync) != 0; /* Unlock mutex */
+}
+
+uint8_t GSM_SYS_EventCreate(GSM_RTOS_EVENT_t* Event) {
+	pthread_condattr_t attr;
+	uint8_t ret;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); /* Not affected by wall clock changes */
+	ret = pthread_cond_init(Event, &attr) != 0; /* Create condition variable */
+	pthread_condattr_destroy(&attr);
+	return ret;
+}
+
+uint8_t GSM_SYS_EventDelete(GSM_RTOS_EVENT_t* Event) {
+	return pthread_cond_destroy(Event) != 0; /* Delete condition variable */
+}
+
+uint8_t GSM_SYS_EventWait(GSM_RTOS_EVENT_t* Event, GSM_RTOS_SYNC_t* Sync,
+		uint32_t Timeout) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += Timeout / 1000;
+	ts.tv_nsec += (long) (Timeout % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	return pthread_cond_timedwait(Event, Sync, &ts) != 0; /* Release mutex and wait */
+}
+
+uint8_t GSM_SYS_EventSignal(GSM_RTOS_EVENT_t* Event) {
+	return pthread_cond_broadcast(Event) != 0; /* Wake all waiters */
+}
+
+void GSM_SYS_ThreadSelf(GSM_RTOS_THREAD_t* Thread) {
+	*Thread = pthread_self(); /* Identifier of calling thread */
+}
+
+uint8_t GSM_SYS_ThreadIsSelf(const GSM_RTOS_THREAD_t* Thread) {
+	return pthread_equal(*Thread, pthread_self()) != 0; /* Compare with calling thread */
 }
@@ -44,7 +44,8 @@ extern "C" {
 #include "stdlib.h"
 
 /* Platform dependant includes add here before gsm.h library include */
-//#include "cmsis_os.h"
+#include <pthread.h>
+#include <time.h>
 /* Include library */
 #include "GSM_AT_Parser.h"
 #include "gsm_config.h"
@@ -101,6 +102,60 @@ uint8_t GSM_SYS_Request(GSM_RTOS_SYNC_t* Sync);
  */
 uint8_t GSM_SYS_Release(GSM_RTOS_SYNC_t* Sync);
 
+/**
+ * \brief  Creates an event object
+ * \param  *Event: Pointer to event object to create in system
+ * \retval Successfull status:
+ *            - 0: Successful
+ *            - > 0: Error
+ */
+uint8_t GSM_SYS_EventCreate(GSM_RTOS_EVENT_t* Event);
+
+/**
+ * \brief  Deletes an event object
+ * \param  *Event: Pointer to event object to delete from system
+ * \retval Successfull status:
+ *            - 0: Successful
+ *            - > 0: Error
+ */
+uint8_t GSM_SYS_EventDelete(GSM_RTOS_EVENT_t* Event);
+
+/**
+ * \brief  Waits for event, sync object must be granted once by caller and is released while waiting
+ * \param  *Event: Pointer to event object to wait for
+ * \param  *Sync: Pointer to granted sync object
+ * \param  Timeout: Maximal time to wait in milliseconds
+ * \retval Successfull status:
+ *            - 0: Event was signalled (may be spurious, caller must check its condition)
+ *            - > 0: Timeout or error
+ */
+uint8_t GSM_SYS_EventWait(GSM_RTOS_EVENT_t* Event, GSM_RTOS_SYNC_t* Sync,
+		uint32_t Timeout);
+
+/**
+ * \brief  Wakes all threads waiting for event
+ * \param  *Event: Pointer to event object to signal
+ * \retval Successfull status:
+ *            - 0: Successful
+ *            - > 0: Error
+ */
+uint8_t GSM_SYS_EventSignal(GSM_RTOS_EVENT_t* Event);
+
+/**
+ * \brief  Saves identifier of calling thread
+ * \param  *Thread: Pointer to thread object to save identifier to
+ */
+void GSM_SYS_ThreadSelf(GSM_RTOS_THREAD_t* Thread);
+
+/**
+ * \brief  Checks if saved identifier belongs to calling thread
+ * \param  *Thread: Pointer to thread object saved with \ref GSM_SYS_ThreadSelf
+ * \retval Status:
+ *            - 0: Other thread
+ *            - > 0: Calling thread
+ */
+uint8_t GSM_SYS_ThreadIsSelf(const GSM_RTOS_THREAD_t* Thread);
+
 /**
  * \}
  */
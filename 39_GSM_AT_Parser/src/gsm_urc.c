@@ -0,0 +1,160 @@
+/*
+ ============================================================================
+ Name        : gsm_urc.c
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 基于前缀树的模块返回行分类器
+ ============================================================================
+ */
+#include "gsm_urc.h"
+#include <string.h>
+
+/* 前缀树节点，子节点用兄弟链表连接 */
+typedef struct {
+	char Ch; //节点字符
+	uint8_t Type; //以该节点结尾的前缀类型，0表示不是前缀结尾
+	uint8_t Exact; //为1时整行必须在该节点结束
+	uint16_t Child; //第一个子节点，0表示没有
+	uint16_t Next; //下一个兄弟节点，0表示没有
+} URC_Node_t;
+
+/* 内置的行类型 */
+typedef struct {
+	const char* Prefix;
+	uint8_t Type;
+	uint8_t Exact;
+} URC_Entry_t;
+
+static const URC_Entry_t URC_Builtin[] = {
+	{ "OK", GSM_URC_OK, 1 },
+	{ "ERROR", GSM_URC_ERROR, 1 },
+	{ "+CME ERROR", GSM_URC_CME_ERROR, 0 },
+	{ "+CMS ERROR", GSM_URC_CMS_ERROR, 0 },
+	{ "BUSY", GSM_URC_BUSY, 1 },
+	{ "NO CARRIER", GSM_URC_NO_CARRIER, 1 },
+	{ "NO DIALTONE", GSM_URC_NO_DIALTONE, 1 },
+	{ "NO ANSWER", GSM_URC_NO_ANSWER, 1 },
+	{ "RING", GSM_URC_RING, 1 },
+	{ "DOWNLOAD", GSM_URC_DOWNLOAD, 1 },
+	{ "Call Ready", GSM_URC_CALL_READY, 1 },
+	{ "SMS Ready", GSM_URC_SMS_READY, 1 },
+	{ "UNDER-VOLTAGE WARNNING", GSM_URC_UV_WARNING, 0 },
+	{ "UNDER-VOLTAGE POWER DOWN", GSM_URC_UV_POWER_DOWN, 0 },
+	{ "+CMTI:", GSM_URC_CMTI, 0 },
+	{ "+CLCC:", GSM_URC_CLCC, 0 },
+	{ "+CPIN:", GSM_URC_CPIN, 0 },
+	{ "+CREG:", GSM_URC_CREG, 0 },
+	{ "+CSQ:", GSM_URC_CSQ, 0 },
+	{ "+CMGS:", GSM_URC_CMGS, 0 },
+	{ "+CMGR:", GSM_URC_CMGR, 0 },
+	{ "+CMGL:", GSM_URC_CMGL, 0 },
+	{ "+CIPRXGET:", GSM_URC_CIPRXGET, 0 },
+	{ "+HTTPACTION:", GSM_URC_HTTPACTION, 0 },
+	{ "+HTTPREAD:", GSM_URC_HTTPREAD, 0 },
+	{ "+FTPGET:", GSM_URC_FTPGET, 0 },
+	{ "AT", GSM_URC_ECHO, 0 },
+	{ "at", GSM_URC_ECHO, 0 },
+};
+
+/* 节点0不使用，作为空链接 */
+static URC_Node_t Nodes[GSM_URC_MAX_NODES];
+static uint16_t NodeCount = 1;
+/* 第一层按首字符直接索引 */
+static uint16_t Root[128];
+static uint8_t NextUserType = GSM_URC_User;
+static uint8_t Initialized = 0;
+
+/**
+ * 在兄弟链表中查找字符，没有找到时新建节点并插入链表头部
+ * @param  link 兄弟链表头
+ * @param  ch   要查找的字符
+ * @return      节点序号，前缀树已满返回0
+ */
+static uint16_t URC_GetNode(uint16_t* link, char ch) {
+	uint16_t node = *link;
+
+	while (node && Nodes[node].Ch != ch) {
+		node = Nodes[node].Next;
+	}
+	if (node == 0) {
+		if (NodeCount >= GSM_URC_MAX_NODES) {
+			return 0;
+		}
+		node = NodeCount++;
+		memset(&Nodes[node], 0x00, sizeof(URC_Node_t));
+		Nodes[node].Ch = ch;
+		Nodes[node].Next = *link;
+		*link = node;
+	}
+	return node;
+}
+
+/**
+ * 将前缀插入前缀树
+ * @param  prefix 前缀字符串
+ * @param  type   行类型
+ * @param  exact  是否需要整行匹配
+ * @return        成功返回0，失败返回-1
+ */
+static int8_t URC_Insert(const char* prefix, uint8_t type, uint8_t exact) {
+	uint16_t node;
+
+	if (prefix == NULL || *prefix == 0 || (uint8_t) *prefix >= 128) {
+		return -1;
+	}
+	node = URC_GetNode(&Root[(uint8_t) *prefix], *prefix);
+	while (node && *++prefix) {
+		node = URC_GetNode(&Nodes[node].Child, *prefix);
+	}
+	if (node == 0) {
+		return -1;
+	}
+	Nodes[node].Type = type;
+	Nodes[node].Exact = exact;
+	return 0;
+}
+
+void GSM_URC_Init(void) {
+	uint8_t i;
+
+	if (Initialized) {
+		return;
+	}
+	for (i = 0; i < sizeof(URC_Builtin) / sizeof(URC_Builtin[0]); i++) {
+		URC_Insert(URC_Builtin[i].Prefix, URC_Builtin[i].Type,
+				URC_Builtin[i].Exact);
+	}
+	Initialized = 1;
+}
+
+uint8_t GSM_URC_Register(const char* Prefix, uint8_t Exact) {
+	GSM_URC_Init();
+	if (NextUserType == 0xFF || URC_Insert(Prefix, NextUserType, Exact) < 0) {
+		return GSM_URC_Unknown;
+	}
+	return NextUserType++;
+}
+
+uint8_t GSM_URC_Classify(const char* Line, uint16_t Len) {
+	uint8_t type = GSM_URC_Unknown;
+	uint16_t node, i = 0;
+
+	if (Len == 0 || (uint8_t) Line[0] >= 128) {
+		return GSM_URC_Unknown;
+	}
+	node = Root[(uint8_t) Line[0]];
+	while (node) { /* node与Line[i]匹配 */
+		if (Nodes[node].Type && (!Nodes[node].Exact || i + 1 == Len)) {
+			type = Nodes[node].Type; /* 记录最长匹配 */
+		}
+		if (++i >= Len) {
+			break;
+		}
+		node = Nodes[node].Child;
+		while (node && Nodes[node].Ch != Line[i]) {
+			node = Nodes[node].Next;
+		}
+	}
+	return type;
+}
@@ -0,0 +1,82 @@
+/*
+ ============================================================================
+ Name        : gsm_urc.h
+ Author      : morris
+ Version     :
+ Copyright   : Your copyright notice
+ Description : 基于前缀树的模块返回行分类器
+ ============================================================================
+ */
+
+#ifndef GSM_URC_H_
+#define GSM_URC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "gsm_config.h"
+
+/*
+ * 模块返回行的类型，包括最终结果码和主动上报(URC)
+ */
+typedef enum _GSM_URC_Type_t {
+	GSM_URC_Unknown = 0x00, //未知行，作为命令的中间返回
+	GSM_URC_OK, //OK
+	GSM_URC_ERROR, //ERROR
+	GSM_URC_CME_ERROR, //+CME ERROR: <err>
+	GSM_URC_CMS_ERROR, //+CMS ERROR: <err>
+	GSM_URC_BUSY, //BUSY
+	GSM_URC_NO_CARRIER, //NO CARRIER
+	GSM_URC_NO_DIALTONE, //NO DIALTONE
+	GSM_URC_NO_ANSWER, //NO ANSWER
+	GSM_URC_RING, //RING
+	GSM_URC_DOWNLOAD, //DOWNLOAD，等待HTTP数据
+	GSM_URC_CALL_READY, //Call Ready
+	GSM_URC_SMS_READY, //SMS Ready
+	GSM_URC_UV_WARNING, //UNDER-VOLTAGE WARNNING
+	GSM_URC_UV_POWER_DOWN, //UNDER-VOLTAGE POWER DOWN
+	GSM_URC_CMTI, //+CMTI: 收到新短信
+	GSM_URC_CLCC, //+CLCC: 通话状态
+	GSM_URC_CPIN, //+CPIN: SIM卡状态
+	GSM_URC_CREG, //+CREG: 网络注册状态
+	GSM_URC_CSQ, //+CSQ: 信号强度
+	GSM_URC_CMGS, //+CMGS: 短信已发送
+	GSM_URC_CMGR, //+CMGR: 读取短信
+	GSM_URC_CMGL, //+CMGL: 短信列表
+	GSM_URC_CIPRXGET, //+CIPRXGET: 套接字数据
+	GSM_URC_HTTPACTION, //+HTTPACTION: HTTP请求完成
+	GSM_URC_HTTPREAD, //+HTTPREAD: HTTP数据
+	GSM_URC_FTPGET, //+FTPGET: FTP数据
+	GSM_URC_ECHO, //命令回显，以AT开头
+	GSM_URC_User = 0x80 //用户注册的类型从这里开始
+} GSM_URC_Type_t;
+
+/**
+ * 初始化内置的行类型前缀树，可以重复调用，GSM_Init中会自动调用
+ */
+void GSM_URC_Init(void);
+
+/**
+ * 注册厂商自定义的主动上报行，收到后通过gsmEventURC事件通知用户
+ * @note   前缀树被所有GSM实例共享，必须在模块开始工作之前注册
+ * @param  Prefix 行的前缀，如"+CIEV:"
+ * @param  Exact  为1时整行必须与Prefix完全相同，为0时只匹配前缀
+ * @return        成功返回分配的类型(>=GSM_URC_User)，前缀树已满返回GSM_URC_Unknown
+ */
+uint8_t GSM_URC_Register(const char* Prefix, uint8_t Exact);
+
+/**
+ * 对一行数据分类，只从头到尾扫描一遍，返回最长匹配的类型
+ * @param  Line 行数据，不包括结尾的\r\n
+ * @param  Len  行长度
+ * @return      行类型，GSM_URC_Type_t或者用户注册的类型
+ */
+uint8_t GSM_URC_Classify(const char* Line, uint16_t Len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GSM_URC_H_ */
@@ -6,9 +6,385 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "GSM_AT_Parser.h"
+#include "gsm_manager.h"
+#include "gsm_sim.h"
 
-int main(void) {
-	puts("!!!Hello World!!!"); /* prints !!!Hello World!!! */
-	return EXIT_SUCCESS;
+#define BENCH_ROUNDS		200000
+#define BENCH_MAX_LINES		1024
+#define BENCH_MAX_CMDS		100000
+
+/* 从SIM800模块抓取的一段交互记录，不包括空行 */
+static const char* Transcript[] = {
+	"Call Ready", "SMS Ready", "AT", "OK", "ATE0", "OK", "AT+CPIN?",
+	"+CPIN: READY", "OK", "AT+CSQ", "+CSQ: 21,0", "OK", "AT+CREG?",
+	"+CREG: 0,1", "OK", "AT+COPS?", "+COPS: 0,0,\"CHINA MOBILE\"", "OK",
+	"AT+CMGF=1", "OK", "+CMTI: \"SM\",3", "AT+CMGR=3",
+	"+CMGR: \"REC UNREAD\",\"+8613800000000\",\"\",\"17/01/26,10:21:30+32\"",
+	"hello from the other side", "OK", "AT+CMGS=\"13800000000\"",
+	"+CMGS: 12", "OK", "RING", "+CLCC: 1,1,4,0,0,\"13800000000\",129,\"\"",
+	"RING", "NO CARRIER", "AT+HTTPINIT", "OK", "AT+HTTPACTION=0",
+	"OK", "+HTTPACTION: 0,200,1024", "AT+HTTPREAD", "+HTTPREAD: 1024",
+	"OK", "AT+CIPRXGET=2,0,512", "+CIPRXGET: 2,0,512,0", "OK",
+	"+CME ERROR: 10", "+CMS ERROR: 500", "ERROR", "AT+GSN",
+	"869012345678901", "OK", "+CIEV: \"CALL\",1",
+	"UNDER-VOLTAGE WARNNING", "DOWNLOAD", "BUSY" };
+
+/**
+ * 修改前使用的逐个比较的分类方法，作为基准测试的参照
+ * @param  str 行数据
+ * @return     行类型
+ */
+static uint8_t Classify_Strcmp(const char* str) {
+	if (strcmp(str, "OK") == 0) {
+		return GSM_URC_OK;
+	} else if (strcmp(str, "ERROR") == 0) {
+		return GSM_URC_ERROR;
+	} else if (strncmp(str, "+CME ERROR", 10) == 0) {
+		return GSM_URC_CME_ERROR;
+	} else if (strncmp(str, "+CMS ERROR", 10) == 0) {
+		return GSM_URC_CMS_ERROR;
+	} else if (strcmp(str, "BUSY") == 0) {
+		return GSM_URC_BUSY;
+	} else if (strcmp(str, "NO CARRIER") == 0) {
+		return GSM_URC_NO_CARRIER;
+	} else if (strcmp(str, "NO DIALTONE") == 0) {
+		return GSM_URC_NO_DIALTONE;
+	} else if (strcmp(str, "NO ANSWER") == 0) {
+		return GSM_URC_NO_ANSWER;
+	} else if (strcmp(str, "DOWNLOAD") == 0) {
+		return GSM_URC_DOWNLOAD;
+	} else if (strcmp(str, "Call Ready") == 0) {
+		return GSM_URC_CALL_READY;
+	} else if (strcmp(str, "SMS Ready") == 0) {
+		return GSM_URC_SMS_READY;
+	} else if (strncmp(str, "UNDER-VOLTAGE WARNNING", 22) == 0) {
+		return GSM_URC_UV_WARNING;
+	} else if (strncmp(str, "UNDER-VOLTAGE POWER DOWN", 24) == 0) {
+		return GSM_URC_UV_POWER_DOWN;
+	} else if (strcmp(str, "RING") == 0) {
+		return GSM_URC_RING;
+	} else if (strncmp(str, "+CMTI:", 6) == 0) {
+		return GSM_URC_CMTI;
+	} else if (strncmp(str, "+CPIN:", 6) == 0) {
+		return GSM_URC_CPIN;
+	} else if (strncmp(str, "+CREG:", 6) == 0) {
+		return GSM_URC_CREG;
+	} else if (strncasecmp(str, "AT", 2) == 0) {
+		return GSM_URC_ECHO;
+	}
+	return GSM_URC_Unknown;
+}
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * 读取抓取的交互记录文件，每行一条返回
+ * @param  file  文件名
+ * @param  lines 保存每行的指针
+ * @return       读取的行数
+ */
+static int LoadTranscript(const char* file, const char** lines) {
+	char buf[256];
+	int count = 0;
+	FILE* fp = fopen(file, "r");
+
+	if (fp == NULL) {
+		perror("fopen");
+		exit(1);
+	}
+	while (count < BENCH_MAX_LINES && fgets(buf, sizeof(buf), fp)) {
+		buf[strcspn(buf, "\r\n")] = 0;
+		if (buf[0]) {
+			lines[count++] = strdup(buf);
+		}
+	}
+	fclose(fp);
+	return count;
+}
+
+void Usage(char* arg) {
+	printf("Usage:%s u/U [transcript]\r\nUsage:%s s/S scenario [count] [baudrate]\r\n"
+			"Usage:%s h/H\r\nUsage:%s l/L scenario\r\n", arg, arg, arg, arg);
+}
+
+/**
+ * 行分类基准测试
+ * @param file 抓取的交互记录文件，为NULL时使用内置的交互记录
+ */
+static void Bench_URC(const char* file) {
+	const char* lines[BENCH_MAX_LINES];
+	uint16_t lens[BENCH_MAX_LINES];
+	int count, i, r;
+	volatile uint32_t sink = 0;
+	double start, trie, chain;
+	uint8_t ciev;
+
+	if (file != NULL) {
+		count = LoadTranscript(file, lines);
+	} else {
+		count = sizeof(Transcript) / sizeof(Transcript[0]);
+		memcpy(lines, Transcript, sizeof(Transcript));
+	}
+	for (i = 0; i < count; i++) {
+		lens[i] = strlen(lines[i]);
+	}
+
+	/* 注册厂商自定义的主动上报 */
+	GSM_URC_Init();
+	ciev = GSM_URC_Register("+CIEV:", 0);
+
+	start = Now();
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		for (i = 0; i < count; i++) {
+			sink += GSM_URC_Classify(lines[i], lens[i]);
+		}
+	}
+	trie = Now() - start;
+
+	start = Now();
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		for (i = 0; i < count; i++) {
+			sink += Classify_Strcmp(lines[i]);
+		}
+	}
+	chain = Now() - start;
+
+	for (i = 0; i < count; i++) {
+		uint8_t type = GSM_URC_Classify(lines[i], lens[i]);
+		printf("%3d %-4s %s\r\n", type, type == ciev ? "USER" : "", lines[i]);
+	}
+	printf("%d lines x %d rounds\r\n", count, BENCH_ROUNDS);
+	printf("trie   : %.2f ns/line\r\n", trie * 1e9 / count / BENCH_ROUNDS);
+	printf("strcmp : %.2f ns/line\r\n", chain * 1e9 / count / BENCH_ROUNDS);
+}
+
+/* 模拟器基准测试中每条命令的发送和完成时间 */
+static double SentTime[BENCH_MAX_CMDS];
+static double Latency[BENCH_MAX_CMDS];
+static volatile int Completed;
+static int Results[gsmTIMEOUT + 1];
+
+static void Bench_CmdCallback(GSM_t* GSM, GSM_Result_t Result,
+		const GSM_CMD_t* Cmd) {
+	int index = (int) (intptr_t) Cmd->Arg;
+
+	Latency[index] = Now() - SentTime[index];
+	if (Result <= gsmTIMEOUT) {
+		Results[Result]++;
+	}
+	Completed++;
+}
+
+static void Bench_Event(GSM_Manager_t* Manager, uint8_t Index,
+		GSM_Event_t Event, GSM_EventParams_t* Params) {
+	if (Event == gsmEventURC) {
+		printf("modem %d URC: %s\r\n", Index, (const char *) Params->CP1);
+	}
+}
+
+static int CompareDouble(const void* a, const void* b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
 }
 
+/**
+ * 用模拟器测试命令流水线：测量每条命令的解析CPU时间和从入队到完成的延时，并打印按命令统计的延时分布
+ * @param scenario 场景脚本文件
+ * @param count    命令数量
+ * @param baudrate 模拟的波特率，为0时不限速
+ */
+static void Bench_Sim(const char* scenario, int count, uint32_t baudrate) {
+	GSM_Sim_t Sim;
+	GSM_Manager_t Manager;
+	static GSM_t GSM;
+	static GSM_Stats_t Stats;
+	struct timespec cpu;
+	clockid_t clock;
+	double start, wall;
+	int i;
+
+	if (GSM_Sim_Load(&Sim, scenario, baudrate) < 0) {
+		perror("GSM_Sim_Load");
+		exit(1);
+	}
+	GSM_URC_Register("+CIEV:", 0);
+	GSM_Stats_Init(&Stats);
+	GSM.Stats = &Stats; /* 在GSM_Manager_Add初始化GSM实例之前设置 */
+	GSM_Manager_Init(&Manager, Bench_Event);
+	if (GSM_Manager_Add(&Manager, &GSM, Sim.Slave, 921600, 0) < 0) {
+		perror("GSM_Manager_Add");
+		exit(1);
+	}
+	GSM_Manager_Start(&Manager);
+	pthread_getcpuclockid(Manager.Thread, &clock);
+
+	start = Now();
+	for (i = 0; i < count; i++) {
+		SentTime[i] = Now();
+		while (GSM_CMD_Send(&GSM, "AT+CSQ", NULL, 0, 1000, Bench_CmdCallback,
+				(void *) (intptr_t) i) == gsmBUSY) { /* 队列满，等待命令完成 */
+			usleep(100);
+		}
+	}
+	while (Completed < count) {
+		usleep(1000);
+	}
+	wall = Now() - start;
+	clock_gettime(clock, &cpu);
+
+	GSM_Manager_DeInit(&Manager);
+	GSM_Sim_Stop(&Sim);
+
+	qsort(Latency, count, sizeof(double), CompareDouble);
+	printf("%d commands, ok %d, error %d, timeout %d, sim mismatches %u\r\n",
+			count, Results[gsmOK], Results[gsmERROR], Results[gsmTIMEOUT],
+			Sim.Mismatches);
+	printf("wall %.3f s, %.0f cmd/s\r\n", wall, count / wall);
+	printf("parser cpu %.2f us/cmd\r\n",
+			(cpu.tv_sec * 1e6 + cpu.tv_nsec / 1e3) / count);
+	printf("latency p50 %.3f ms, p99 %.3f ms, max %.3f ms\r\n",
+			Latency[count / 2] * 1e3, Latency[count * 99 / 100] * 1e3,
+			Latency[count - 1] * 1e3);
+	printf("per command, us:\r\n");
+	GSM_Stats_Print(&Stats, stdout);
+}
+
+/**
+ * 直方图边界检查：在最高区间边界和32位最大值附近各记录一次，检查计数没有越界，百分位数正确
+ * @return 全部通过返回0
+ */
+static int Check_Stats(void) {
+	static const uint32_t values[] = { (1u << GSM_STATS_MAX_BITS) - 1,
+			1u << GSM_STATS_MAX_BITS, 150000000, UINT32_MAX };
+	static GSM_Stats_t Stats;
+	const GSM_Histogram_t* hist;
+	uint64_t total;
+	uint32_t p100;
+	int i, j, failed = 0;
+
+	GSM_Stats_Init(&Stats);
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		GSM_Stats_Reset(&Stats);
+		GSM_Stats_Record(&Stats, 1, GSM_STATS_NO_DATA, values[i], 0, 0);
+		hist = &Stats.Cmds[0].Final;
+		for (j = 0, total = 0; j < GSM_STATS_BUCKETS; j++) {
+			total += hist->Counts[j];
+		}
+		p100 = GSM_Stats_Percentile(hist, 100);
+		/* 区间上界的相对误差不超过1/2^GSM_STATS_SUB_BITS */
+		if (hist->Total != 1 || total != 1 || Stats.Cmds[0].FirstByte.Total
+				|| p100 < values[i]
+				|| p100 - values[i] > values[i] >> GSM_STATS_SUB_BITS) {
+			printf("FAIL %u: total %u, counted %llu, p100 %u\r\n", values[i],
+					hist->Total, (unsigned long long) total, p100);
+			failed++;
+		} else {
+			printf("ok   %u: p100 %u\r\n", values[i], p100);
+		}
+	}
+	return failed;
+}
+
+static volatile GSM_Result_t ListResult;
+
+static void List_CmdCallback(GSM_t* GSM, GSM_Result_t Result,
+		const GSM_CMD_t* Cmd) {
+	ListResult = Result;
+}
+
+/**
+ * 批量读取短信检查：场景中短信内容依次为下面的字符串，它们看起来像回显、最终结果或者主动上报
+ * @param  scenario 场景脚本文件
+ * @return          全部通过返回0
+ */
+static int Check_SMSList(const char* scenario) {
+	static const char* bodies[] = { "at home", "OK", "ERROR", "RING",
+			"first line\nAT second line", "" };
+	static GSM_t GSM;
+	static GSM_SMS_Entry_t entries[16];
+	static char arena[1024];
+	GSM_SMS_Batch_t batch;
+	GSM_Manager_t Manager;
+	GSM_Sim_t Sim;
+	GSM_Result_t res;
+	int count = sizeof(bodies) / sizeof(bodies[0]);
+	int i, failed = 0;
+
+	if (GSM_Sim_Load(&Sim, scenario, 0) < 0) {
+		perror("GSM_Sim_Load");
+		exit(1);
+	}
+	GSM_Manager_Init(&Manager, NULL);
+	if (GSM_Manager_Add(&Manager, &GSM, Sim.Slave, 921600, 0) < 0) {
+		perror("GSM_Manager_Add");
+		exit(1);
+	}
+	GSM_Manager_Start(&Manager);
+	memset(&batch, 0, sizeof(batch));
+	batch.Entries = entries;
+	batch.MaxEntries = sizeof(entries) / sizeof(entries[0]);
+	batch.Arena = arena;
+	batch.ArenaSize = sizeof(arena);
+	res = GSM_SMS_List(&GSM, &batch, GSM_SMS_ReadType_ALL, List_CmdCallback,
+			NULL);
+	if (res == gsmOK) {
+		res = GSM_WaitReady(&GSM, 5000);
+	}
+	if (res == gsmOK) {
+		res = ListResult;
+	}
+	GSM_Manager_DeInit(&Manager);
+	GSM_Sim_Stop(&Sim);
+
+	for (i = 0; i < batch.Count; i++) {
+		const char* data = entries[i].Data ? entries[i].Data : "(no body)";
+		int ok = i < count && entries[i].Position == i + 1
+				&& entries[i].Data != NULL && strcmp(data, bodies[i]) == 0;
+		printf("%s %d: \"%s\"\r\n", ok ? "ok  " : "FAIL", entries[i].Position,
+				data);
+		failed += !ok;
+	}
+	if (res != gsmOK || batch.Count != count || batch.Dropped) {
+		printf("FAIL result %d, %d entries, %d dropped, expected %d entries\r\n",
+				res, batch.Count, batch.Dropped, count);
+		failed++;
+	}
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	int count = 1000;
+
+	if (argc < 2) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	if (!strncasecmp(argv[1], "u", 1)) {
+		Bench_URC(argc > 2 ? argv[2] : NULL);
+	} else if (!strncasecmp(argv[1], "s", 1) && argc > 2) {
+		if (argc > 3) {
+			count = atoi(argv[3]);
+		}
+		if (count <= 0 || count > BENCH_MAX_CMDS) {
+			count = BENCH_MAX_CMDS;
+		}
+		Bench_Sim(argv[2], count, argc > 4 ? atoi(argv[4]) : 0);
+	} else if (!strncasecmp(argv[1], "h", 1)) {
+		return Check_Stats() ? EXIT_FAILURE : EXIT_SUCCESS;
+	} else if (!strncasecmp(argv[1], "l", 1) && argc > 2) {
+		return Check_SMSList(argv[2]) ? EXIT_FAILURE : EXIT_SUCCESS;
+	} else {
+		Usage(argv[0]);
+		exit(1);
+	}
+	return EXIT_SUCCESS;
+}
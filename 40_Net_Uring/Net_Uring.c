@@ -0,0 +1,895 @@
+/*
+ * 	Net_Uring.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ *  要求：
+ *  	网络编程之---io_uring
+ *  	使用io_uring实现单线程并发服务器，内核不支持时退回epoll
+ *	********************************************************************
+ *	1. io_uring在用户空间和内核之间共享两个环形队列：提交队列(SQ)和完成队列(CQ)，
+ *	应用程序把请求写入SQ，内核把结果写入CQ，一次io_uring_enter可以提交很多请求，
+ *	同时等待完成，不需要每个recv/send都进行一次系统调用
+ *	2. 多次触发的accept(IORING_ACCEPT_MULTISHOT)：提交一次，每接收一个连接产生一个完成事件
+ *	3. 多次触发的recv(IORING_RECV_MULTISHOT)：提交一次，每收到一次数据产生一个完成事件，
+ *	接收缓冲区由内核从提供的缓冲区环(IORING_REGISTER_PBUF_RING)中选取，
+ *	完成事件中带有缓冲区编号，数据处理完后再把缓冲区放回环中
+ *	4. 链接的请求(IOSQE_IO_LINK)：前一个请求成功完成后才开始下一个，
+ *	回复的数据和服务器标识用两个链接的send发送，不需要拷贝到一起
+ *	5. 同一个套接字上独立提交的send不保证顺序，所以每个连接同时只有一组send在进行
+ *	6. 没有使用liburing，直接使用io_uring_setup、io_uring_enter、io_uring_register系统调用
+ *	7. 缓冲区环是所有连接共用的，只发不收的客户端会让多次触发的recv一直占用缓冲区，
+ *	所以每个连接等待发送的缓冲区有上限，达到上限时取消recv，数据留在内核中由TCP流量控制，
+ *	回复发送出去后再重新提交；缓冲区用完(-ENOBUFS)的连接等到有缓冲区放回后再提交
+ *	********************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PORT				5005	//端口号
+#define MAX_QUE_CONN_NUM	4096	//监听队列长度
+#define BUFFER_SIZE			1024	//数据缓冲区大小
+#define RING_ENTRIES		4096	//提交队列长度，完成队列是它的4倍
+#define BUF_COUNT			8192	//提供给内核的接收缓冲区数量，必须是2的幂
+#define BUF_GROUP			1		//接收缓冲区组编号
+#define CONN_BUF_MAX		16		//每个连接最多占用的接收缓冲区数量
+#define MAX_EVENTS			256		//epoll_wait一次返回的最大事件数
+#define SERVER_IDENT		"\t(From Server)"
+#define BENCH_MSG			"ping"	//性能测试客户端发送的消息
+#define BENCH_SECONDS		3		//性能测试每项持续时间
+#define BENCH_SAMPLES		4000000	//性能测试最多记录的延迟数量
+#define MAX(a,b)			((a>b)?(a):(b))
+
+/* 完成事件的类型，保存在user_data的低位，高位是连接指针 */
+#define OP_ACCEPT			0
+#define OP_RECV				1
+#define OP_SEND				2
+#define OP_IDENT			3
+#define OP_CANCEL			4
+#define OP_MASK				7
+
+/* 服务器统计，性能测试时放在共享内存中由父进程读取 */
+typedef struct {
+	volatile long syscalls; //系统调用次数
+	volatile long requests; //回复的消息数量
+} stats_t;
+
+/* io_uring实例 */
+typedef struct {
+	int ring_fd; //io_uring描述符
+	unsigned* sq_head; //内核已经取走的位置
+	unsigned* sq_tail; //应用程序提交的位置
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned sq_local; //已经填写但还没有提交的位置
+	unsigned sq_submit; //已经提交的位置
+	struct io_uring_sqe* sqes; //请求数组
+	unsigned* cq_head; //应用程序已经处理的位置
+	unsigned* cq_tail; //内核写入的位置
+	unsigned cq_mask;
+	struct io_uring_cqe* cqes; //完成事件数组
+	struct io_uring_buf_ring* br; //提供给内核的缓冲区环
+	unsigned short br_tail; //缓冲区环的尾部
+	char* bufs; //接收缓冲区
+	int buf_len[BUF_COUNT]; //每个缓冲区中数据的长度
+	short buf_next[BUF_COUNT]; //连接中等待发送的缓冲区链表
+	int recycled; //上次唤醒等待的连接之后放回的缓冲区数量
+	struct uconn *starved, *starved_tail; //因为缓冲区用完而等待的连接队列
+} uring_t;
+
+/* io_uring模式每个客户端连接的状态 */
+typedef struct uconn {
+	int fd; //客户端套接字
+	int inflight; //还没有完成的请求数，为0时才能释放
+	int recving; //多次触发的recv还在进行
+	int canceling; //已经提交了取消recv的请求
+	int starving; //在缓冲区等待队列中
+	int sending; //正在发送一组回复
+	int closing; //连接已经关闭
+	int eof; //客户端已经关闭写，发送完剩下的回复后关闭连接
+	int send_bid; //正在发送的缓冲区
+	int head, tail; //等待发送的缓冲区链表，-1表示空
+	int queued; //占用的接收缓冲区数量，包括正在发送的
+	struct uconn* starved_next; //缓冲区等待队列中的下一个连接
+} uconn_t;
+
+/* epoll模式每个客户端连接的状态 */
+typedef struct {
+	int fd; //客户端套接字
+	char* out; //发送缓冲区，保存还没有发送出去的数据
+	int out_off; //发送缓冲区中下一个要发送的位置
+	int out_len; //发送缓冲区中数据的结尾
+	int out_cap; //发送缓冲区大小
+	int writing; //正在等待套接字可写
+} econn_t;
+
+static stats_t local_stats;
+static stats_t* stats = &local_stats;
+static int verbose = 1; //为0时不打印每条消息，性能测试时服务端使用
+
+/* 程序使用说明 */
+void Usage(char* arg) {
+	printf("Usage:%s s/S\r\n"
+			"Usage:%s e/E\r\n"
+			"Usage:%s b/B [conns]\r\n", arg, arg, arg);
+}
+
+/* 创建监听套接字 */
+static int server_listen(int port) {
+	struct sockaddr_in server_addr;
+	int server_fd;
+	int retry;
+	int ret;
+	server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (server_fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	/* 允许重复使用本地地址与套接字进行绑定 */
+	int b_reuse = 1;
+	setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &b_reuse, sizeof(b_reuse));
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(port);
+	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	/* io_uring实例在进程退出后才异步释放，其中的accept还会占用端口一小段时间 */
+	for (retry = 0; retry < 50; retry++) {
+		ret = bind(server_fd, (struct sockaddr*) &server_addr,
+				sizeof(server_addr));
+		if (ret == 0 || errno != EADDRINUSE)
+			break;
+		usleep(100 * 1000);
+	}
+	if (ret < 0) {
+		perror("bind");
+		exit(1);
+	}
+	ret = listen(server_fd, MAX_QUE_CONN_NUM);
+	if (ret < 0) {
+		perror("listen");
+		exit(1);
+	}
+	return server_fd;
+}
+
+/*
+ * 创建io_uring实例，映射两个队列和请求数组，注册接收缓冲区环
+ * 内核不支持io_uring或缓冲区环时返回-1
+ */
+static int uring_init(uring_t* u) {
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	size_t sq_size, cq_size;
+	char *sq_ptr, *cq_ptr;
+	int i;
+
+	memset(u, 0, sizeof(uring_t));
+	memset(&p, 0, sizeof(p));
+	/* 只有一个线程提交请求，内核的后续处理推迟到io_uring_enter中进行 */
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL
+			| IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	p.cq_entries = RING_ENTRIES * 4;
+	u->ring_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+	if (u->ring_fd < 0 && errno == EINVAL) {
+		/* 旧内核不认识后面几个标志 */
+		p.flags = IORING_SETUP_CQSIZE;
+		u->ring_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+	}
+	if (u->ring_fd < 0) {
+		perror("io_uring_setup");
+		return -1;
+	}
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	/* 新内核中两个队列在同一块内存中 */
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sq_size = cq_size = MAX(sq_size, cq_size);
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+	MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED) {
+		perror("mmap");
+		close(u->ring_fd);
+		return -1;
+	}
+	cq_ptr = sq_ptr;
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED) {
+			perror("mmap");
+			close(u->ring_fd);
+			return -1;
+		}
+	}
+	u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+	PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+	IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		perror("mmap");
+		close(u->ring_fd);
+		return -1;
+	}
+	u->sq_head = (unsigned*) (sq_ptr + p.sq_off.head);
+	u->sq_tail = (unsigned*) (sq_ptr + p.sq_off.tail);
+	u->sq_mask = *(unsigned*) (sq_ptr + p.sq_off.ring_mask);
+	u->sq_entries = p.sq_entries;
+	u->sq_local = u->sq_submit = *u->sq_tail;
+	/* 提交队列的索引数组固定指向对应的请求，提交时只需要移动尾部 */
+	for (i = 0; i < p.sq_entries; i++)
+		((unsigned*) (sq_ptr + p.sq_off.array))[i] = i;
+	u->cq_head = (unsigned*) (cq_ptr + p.cq_off.head);
+	u->cq_tail = (unsigned*) (cq_ptr + p.cq_off.tail);
+	u->cq_mask = *(unsigned*) (cq_ptr + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe*) (cq_ptr + p.cq_off.cqes);
+
+	/* 注册接收缓冲区环，内核从中为每次recv选取缓冲区 */
+	u->br = mmap(NULL, BUF_COUNT * sizeof(struct io_uring_buf),
+	PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	u->bufs = malloc(BUF_COUNT * BUFFER_SIZE);
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) u->br;
+	reg.ring_entries = BUF_COUNT;
+	reg.bgid = BUF_GROUP;
+	if (syscall(__NR_io_uring_register, u->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		perror("io_uring_register");
+		close(u->ring_fd);
+		return -1;
+	}
+	return 0;
+}
+
+/* 把缓冲区放回缓冲区环，内核可以再次使用 */
+static void uring_buf_recycle(uring_t* u, int bid) {
+	struct io_uring_buf* buf = &u->br->bufs[u->br_tail & (BUF_COUNT - 1)];
+	buf->addr = (unsigned long) (u->bufs + bid * BUFFER_SIZE);
+	buf->len = BUFFER_SIZE;
+	buf->bid = bid;
+	u->br_tail++;
+	u->recycled++;
+	/* 缓冲区内容写完后再移动尾部，内核才能看到 */
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+/* 提交已填写的请求，并等待至少wait个完成事件 */
+static void uring_enter(uring_t* u, unsigned wait) {
+	unsigned submit = u->sq_local - u->sq_submit;
+	int ret;
+	__atomic_store_n(u->sq_tail, u->sq_local, __ATOMIC_RELEASE);
+	u->sq_submit = u->sq_local;
+	stats->syscalls++;
+	ret = syscall(__NR_io_uring_enter, u->ring_fd, submit, wait,
+			wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (ret < 0 && errno != EINTR && errno != EBUSY) {
+		perror("io_uring_enter");
+		exit(1);
+	}
+}
+
+/* 保证提交队列中至少有count个空位，链接的请求必须在同一次提交中 */
+static void uring_reserve(uring_t* u, unsigned count) {
+	if (u->sq_local - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + count
+			> u->sq_entries)
+		uring_enter(u, 0);
+}
+
+/* 取一个空的请求 */
+static struct io_uring_sqe* uring_sqe(uring_t* u) {
+	struct io_uring_sqe* sqe;
+	uring_reserve(u, 1);
+	sqe = &u->sqes[u->sq_local & u->sq_mask];
+	u->sq_local++;
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+/* 提交多次触发的accept */
+static void uring_accept(uring_t* u, int server_fd) {
+	struct io_uring_sqe* sqe = uring_sqe(u);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = server_fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = OP_ACCEPT;
+}
+
+/* 提交多次触发的recv，缓冲区由内核从缓冲区环中选取 */
+static void uring_recv(uring_t* u, uconn_t* c) {
+	struct io_uring_sqe* sqe = uring_sqe(u);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUF_GROUP;
+	sqe->user_data = (uintptr_t) c | OP_RECV;
+	c->recving = 1;
+	c->inflight++;
+}
+
+/* 连接放入缓冲区等待队列，有缓冲区放回时按顺序重新提交recv */
+static void uring_recv_wait(uring_t* u, uconn_t* c) {
+	c->starved_next = NULL;
+	if (u->starved)
+		u->starved_tail->starved_next = c;
+	else
+		u->starved = c;
+	u->starved_tail = c;
+	c->starving = 1;
+	c->inflight++;
+}
+
+/* 没有recv在进行且占用的缓冲区没有达到上限，可以提交recv */
+static int uring_recv_idle(uconn_t* c) {
+	return !c->recving && !c->starving && !c->closing && !c->eof
+			&& c->queued < CONN_BUF_MAX;
+}
+
+/*
+ * 重新提交recv，有连接在等待缓冲区时排在它们后面，
+ * 否则放回的缓冲区总是被数据多的连接抢走
+ */
+static void uring_recv_arm(uring_t* u, uconn_t* c) {
+	if (!uring_recv_idle(c))
+		return;
+	if (u->starved)
+		uring_recv_wait(u, c);
+	else
+		uring_recv(u, c);
+}
+
+/* 占用的缓冲区达到上限，取消多次触发的recv，回复发送后再重新提交 */
+static void uring_recv_cancel(uring_t* u, uconn_t* c) {
+	struct io_uring_sqe* sqe;
+	if (!c->recving || c->canceling || c->queued < CONN_BUF_MAX)
+		return;
+	sqe = uring_sqe(u);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uintptr_t) c | OP_RECV;
+	sqe->user_data = (uintptr_t) c | OP_CANCEL;
+	c->canceling = 1;
+	c->inflight++;
+}
+
+/*
+ * 有缓冲区放回后，从队首起每个缓冲区唤醒一个等待的连接，
+ * 再次失败的连接排到队尾，各连接轮流得到缓冲区
+ */
+static void uring_recv_wake(uring_t* u) {
+	uconn_t* c;
+	for (; u->recycled > 0 && (c = u->starved) != NULL; u->recycled--) {
+		u->starved = c->starved_next;
+		c->starving = 0;
+		c->inflight--;
+		if (c->closing && c->inflight == 0)
+			free(c);
+		else if (uring_recv_idle(c))
+			uring_recv(u, c);
+	}
+	u->recycled = 0;
+}
+
+/* 发送连接中下一个等待的缓冲区，数据和服务器标识用两个链接的send发送 */
+static void uring_send_next(uring_t* u, uconn_t* c) {
+	struct io_uring_sqe* sqe;
+	int bid = c->head;
+	if (c->sending || c->closing || bid < 0)
+		return;
+	c->head = u->buf_next[bid];
+	if (c->head < 0)
+		c->tail = -1;
+	c->send_bid = bid;
+	c->sending = 1;
+	uring_reserve(u, 2);
+	/*
+	 * MSG_WAITALL使内核发送完全部数据才完成，只发送一部分时链接会断开
+	 * MSG_MORE告诉协议栈后面还有数据，两次send合成一个报文，
+	 * 否则Nagle算法会让第二个小报文等待客户端延迟40ms的确认
+	 */
+	sqe = uring_sqe(u);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = c->fd;
+	sqe->addr = (unsigned long) (u->bufs + bid * BUFFER_SIZE);
+	sqe->len = u->buf_len[bid];
+	sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL | MSG_MORE;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->user_data = (uintptr_t) c | OP_SEND;
+	sqe = uring_sqe(u);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = c->fd;
+	sqe->addr = (unsigned long) SERVER_IDENT;
+	sqe->len = sizeof(SERVER_IDENT) - 1;
+	sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+	sqe->user_data = (uintptr_t) c | OP_IDENT;
+	c->inflight += 2;
+}
+
+/*
+ * 关闭连接，shutdown使还在进行的recv和send结束，
+ * 连接的状态在所有请求都完成后才释放
+ */
+static void uring_close(uring_t* u, uconn_t* c) {
+	int bid;
+	if (c->closing)
+		return;
+	c->closing = 1;
+	while ((bid = c->head) >= 0) {
+		c->head = u->buf_next[bid];
+		uring_buf_recycle(u, bid);
+	}
+	if (verbose)
+		printf("Client %d(socket) has left\r\n", c->fd);
+	stats->syscalls += 2;
+	shutdown(c->fd, SHUT_RDWR);
+	close(c->fd);
+}
+
+/* 处理一个完成事件 */
+static void uring_complete(uring_t* u, int server_fd,
+		const struct io_uring_cqe* cqe) {
+	uconn_t* c = (uconn_t*) (uintptr_t) (cqe->user_data & ~(uint64_t) OP_MASK);
+	int more = cqe->flags & IORING_CQE_F_MORE;
+	int bid;
+
+	switch (cqe->user_data & OP_MASK) {
+	case OP_ACCEPT:
+		if (cqe->res >= 0) {
+			c = calloc(1, sizeof(uconn_t));
+			c->fd = cqe->res;
+			c->head = c->tail = -1;
+			uring_recv(u, c);
+			if (verbose)
+				printf("New connection from %d(socket)\r\n", c->fd);
+		} else if (cqe->res != -EAGAIN && cqe->res != -ECONNABORTED) {
+			errno = -cqe->res;
+			perror("accept");
+		}
+		/* 多次触发的请求结束后要重新提交 */
+		if (!more)
+			uring_accept(u, server_fd);
+		return;
+	case OP_RECV:
+		if (!more) {
+			c->inflight--;
+			c->recving = 0;
+		}
+		if (cqe->res > 0) {
+			bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			if (c->closing) {
+				uring_buf_recycle(u, bid);
+				break;
+			}
+			if (verbose)
+				printf("Receive a message from %d(socket):%.*s\r\n", c->fd,
+						cqe->res, u->bufs + bid * BUFFER_SIZE);
+			/* 放入连接的发送链表，按接收的顺序回复 */
+			u->buf_len[bid] = cqe->res;
+			u->buf_next[bid] = -1;
+			if (c->tail >= 0)
+				u->buf_next[c->tail] = bid;
+			else
+				c->head = bid;
+			c->tail = bid;
+			c->queued++;
+			uring_send_next(u, c);
+			/* 多次触发的recv可能已经带出了几个缓冲区，会略微超过上限 */
+			if (more)
+				uring_recv_cancel(u, c);
+			else
+				uring_recv_arm(u, c);
+		} else if (cqe->res == -ENOBUFS) {
+			/* 缓冲区暂时用完，立即重新提交只会再次失败，等到有缓冲区放回 */
+			if (!c->closing)
+				uring_recv_wait(u, c);
+		} else if (cqe->res == -ECANCELED && !c->closing) {
+			/* 达到上限被取消，期间回复可能已经发送完了 */
+			uring_recv_arm(u, c);
+		} else if (cqe->res == 0 && (c->sending || c->head >= 0)) {
+			/* 对端关闭了写，还有回复没有发送完 */
+			c->eof = 1;
+		} else {
+			/* 对端关闭或出错 */
+			if (cqe->res < 0 && cqe->res != -ECONNRESET && !c->closing) {
+				errno = -cqe->res;
+				perror("recv");
+			}
+			uring_close(u, c);
+		}
+		break;
+	case OP_SEND:
+		c->inflight--;
+		c->queued--;
+		uring_buf_recycle(u, c->send_bid);
+		if (cqe->res < 0)
+			uring_close(u, c);
+		break;
+	case OP_IDENT:
+		c->inflight--;
+		c->sending = 0;
+		/* 前一个send失败时这个请求返回-ECANCELED */
+		if (cqe->res < 0) {
+			uring_close(u, c);
+		} else {
+			stats->requests++;
+			uring_send_next(u, c);
+			if (c->eof && !c->sending)
+				uring_close(u, c);
+			else
+				uring_recv_arm(u, c);
+		}
+		break;
+	case OP_CANCEL:
+		/* recv已经结束时返回-ENOENT，不需要处理 */
+		c->inflight--;
+		c->canceling = 0;
+		break;
+	}
+	if (c->closing && c->inflight == 0)
+		free(c);
+}
+
+/* io_uring服务器，内核不支持时返回-1 */
+static int server_uring(int server_fd) {
+	uring_t* u = malloc(sizeof(uring_t));
+	unsigned head, tail;
+	int i;
+	if (uring_init(u) < 0) {
+		free(u);
+		return -1;
+	}
+	for (i = 0; i < BUF_COUNT; i++)
+		uring_buf_recycle(u, i);
+	uring_accept(u, server_fd);
+	while (1) {
+		/* 一次系统调用提交所有新请求并等待完成事件 */
+		uring_enter(u, 1);
+		head = *u->cq_head;
+		tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+			uring_complete(u, server_fd, &u->cqes[head & u->cq_mask]);
+		__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+		uring_recv_wake(u);
+	}
+	return 0;
+}
+
+/* epoll模式：发送缓冲区中的数据，直到发完或套接字不可写，出错返回-1 */
+static int econn_flush(int epfd, econn_t* c) {
+	struct epoll_event ev;
+	int real_write;
+	while (c->out_off < c->out_len) {
+		stats->syscalls++;
+		real_write = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+				MSG_NOSIGNAL);
+		if (real_write < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			perror("send");
+			return -1;
+		}
+		c->out_off += real_write;
+	}
+	if (c->out_off == c->out_len)
+		c->out_off = c->out_len = 0;
+	/* 只在有数据没发完时关注可写 */
+	if ((c->out_len > 0) != c->writing) {
+		c->writing = c->out_len > 0;
+		ev.events = EPOLLIN | (c->writing ? EPOLLOUT : 0);
+		ev.data.ptr = c;
+		stats->syscalls++;
+		epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	}
+	return 0;
+}
+
+/* epoll模式：把数据放入发送缓冲区 */
+static void econn_queue(econn_t* c, const char* data, int len) {
+	if (c->out_len + len > c->out_cap) {
+		c->out_cap = MAX(c->out_len + len, 2 * c->out_cap);
+		c->out = realloc(c->out, c->out_cap);
+	}
+	memcpy(c->out + c->out_len, data, len);
+	c->out_len += len;
+}
+
+/* epoll模式：读取客户端数据并回复，连接关闭返回-1 */
+static int econn_read(int epfd, econn_t* c) {
+	char buf[BUFFER_SIZE];
+	int real_read;
+	stats->syscalls++;
+	real_read = recv(c->fd, buf, BUFFER_SIZE, 0);
+	if (real_read < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		if (errno != ECONNRESET)
+			perror("recv");
+		return -1;
+	} else if (real_read == 0) {
+		if (verbose)
+			printf("Client %d(socket) has left\r\n", c->fd);
+		return -1;
+	}
+	if (verbose)
+		printf("Receive a message from %d(socket):%.*s\r\n", c->fd, real_read,
+				buf);
+	econn_queue(c, buf, real_read);
+	econn_queue(c, SERVER_IDENT, sizeof(SERVER_IDENT) - 1);
+	stats->requests++;
+	if (c->writing)
+		return 0;
+	return econn_flush(epfd, c);
+}
+
+/* epoll水平触发服务器，与io_uring版本比较，也是内核不支持io_uring时的后备 */
+static void server_epoll(int server_fd) {
+	struct epoll_event ev, events[MAX_EVENTS];
+	econn_t* c;
+	int epfd, client_fd;
+	int n, i;
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, server_fd, &ev);
+	while (1) {
+		stats->syscalls++;
+		n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			c = events[i].data.ptr;
+			/* 接收所有等待中的连接 */
+			if (c == NULL) {
+				while (1) {
+					stats->syscalls++;
+					client_fd = accept4(server_fd, NULL, NULL,
+					SOCK_NONBLOCK | SOCK_CLOEXEC);
+					if (client_fd < 0)
+						break;
+					c = calloc(1, sizeof(econn_t));
+					c->fd = client_fd;
+					ev.events = EPOLLIN;
+					ev.data.ptr = c;
+					stats->syscalls++;
+					epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &ev);
+					if (verbose)
+						printf("New connection from %d(socket)\r\n",
+								client_fd);
+				}
+				continue;
+			}
+			if (((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+					&& econn_read(epfd, c) < 0)
+					|| ((events[i].events & EPOLLOUT)
+							&& econn_flush(epfd, c) < 0)) {
+				/* 关闭描述符时内核自动把它从epoll中删除 */
+				stats->syscalls++;
+				close(c->fd);
+				free(c->out);
+				free(c);
+			}
+		}
+	}
+}
+
+/* 当前时间，单位微秒 */
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_float(const void* a, const void* b) {
+	float x = *(const float*) a, y = *(const float*) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * 性能测试客户端：建立clients个连接，每个连接发送一条消息，
+ * 收到回复后立即发送下一条，持续BENCH_SECONDS秒，
+ * 统计每秒处理的消息数、往返延迟和服务器每条消息的系统调用次数
+ */
+static void bench_run(const char* name, int clients) {
+	struct sockaddr_in addr;
+	struct epoll_event ev, events[MAX_EVENTS];
+	int reply = strlen(BENCH_MSG) + strlen(SERVER_IDENT);
+	int* fds = malloc(clients * sizeof(int));
+	int* got = calloc(clients, sizeof(int)); //已收到的回复字节数
+	double* start = malloc(clients * sizeof(double));
+	float* lat = malloc(BENCH_SAMPLES * sizeof(float));
+	long count = 0, failed = 0, syscalls, requests;
+	double t0, t1, now;
+	char buf[BUFFER_SIZE];
+	int bench_epfd, n, i, slot, ret;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bench_epfd = epoll_create1(0);
+	/* 先建立所有连接，再同时开始收发 */
+	for (slot = 0; slot < clients; slot++) {
+		fds[slot] = socket(AF_INET, SOCK_STREAM, 0);
+		if (fds[slot] < 0
+				|| connect(fds[slot], (struct sockaddr*) &addr, sizeof(addr))
+						< 0) {
+			perror("connect");
+			exit(1);
+		}
+		fcntl(fds[slot], F_SETFL, O_NONBLOCK);
+		ev.events = EPOLLIN;
+		ev.data.u32 = slot;
+		epoll_ctl(bench_epfd, EPOLL_CTL_ADD, fds[slot], &ev);
+	}
+	/* 只统计收发消息期间服务器的系统调用 */
+	syscalls = stats->syscalls;
+	requests = stats->requests;
+	t0 = now_us();
+	for (slot = 0; slot < clients; slot++) {
+		start[slot] = now_us();
+		send(fds[slot], BENCH_MSG, strlen(BENCH_MSG), MSG_NOSIGNAL);
+	}
+	t1 = t0 + BENCH_SECONDS * 1e6;
+	while ((now = now_us()) < t1) {
+		n = epoll_wait(bench_epfd, events, MAX_EVENTS, 100);
+		for (i = 0; i < n; i++) {
+			slot = events[i].data.u32;
+			ret = recv(fds[slot], buf, sizeof(buf), 0);
+			if (ret <= 0) {
+				if (ret < 0 && errno == EAGAIN)
+					continue;
+				/* 服务器关闭了连接 */
+				failed++;
+				epoll_ctl(bench_epfd, EPOLL_CTL_DEL, fds[slot], NULL);
+				continue;
+			}
+			got[slot] += ret;
+			if (got[slot] < reply)
+				continue;
+			now = now_us();
+			if (count < BENCH_SAMPLES)
+				lat[count] = now - start[slot];
+			count++;
+			got[slot] = 0;
+			start[slot] = now;
+			send(fds[slot], BENCH_MSG, strlen(BENCH_MSG), MSG_NOSIGNAL);
+		}
+	}
+	now = now_us();
+	syscalls = stats->syscalls - syscalls;
+	requests = stats->requests - requests;
+	for (slot = 0; slot < clients; slot++)
+		close(fds[slot]);
+	close(bench_epfd);
+
+	n = count < BENCH_SAMPLES ? count : BENCH_SAMPLES;
+	qsort(lat, n, sizeof(float), cmp_float);
+	if (n > 0) {
+		printf("%-9s %6d conns %9.0f msg/s  %5.2f syscalls/msg  "
+				"p50 %8.3f ms  p99 %8.3f ms%s\r\n", name, clients,
+				count / ((now - t0) / 1e6),
+				requests ? (double) syscalls / requests : 0.0, lat[n / 2] / 1e3,
+				lat[(int) (n * 0.99)] / 1e3,
+				failed ? "  (connections lost)" : "");
+	} else {
+		printf("%-9s %6d conns no reply\r\n", name, clients);
+	}
+	free(fds);
+	free(got);
+	free(start);
+	free(lat);
+}
+
+/* 在子进程中运行服务器，统计数据放在共享内存中，测试完成后杀死子进程 */
+static void bench_server(const char* name, int uring, int clients) {
+	int server_fd;
+	pid_t pid;
+	/* 父进程先创建监听套接字，子进程开始accept前的连接在监听队列中等待 */
+	server_fd = server_listen(PORT);
+	memset((void*) stats, 0, sizeof(stats_t));
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		verbose = 0;
+		if (!uring || server_uring(server_fd) < 0)
+			server_epoll(server_fd);
+		exit(0);
+	}
+	close(server_fd);
+	bench_run(name, clients);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv) {
+	int server_fd;
+	/*参数检查*/
+	if (argc <= 1) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	/* 服务端，优先使用io_uring */
+	if (strncasecmp(argv[1], "s", 1) == 0) {
+		server_fd = server_listen(PORT);
+		printf("Listening...\r\n");
+		if (server_uring(server_fd) < 0) {
+			printf("io_uring is not available, use epoll\r\n");
+			server_epoll(server_fd);
+		}
+		close(server_fd);
+	}
+	/* 服务端，使用epoll */
+	else if (strncasecmp(argv[1], "e", 1) == 0) {
+		server_fd = server_listen(PORT);
+		printf("Listening...\r\n");
+		server_epoll(server_fd);
+		close(server_fd);
+	}
+	/* 性能测试，比较epoll和io_uring */
+	else if (strncasecmp(argv[1], "b", 1) == 0) {
+		static const int conns[] = { 100, 1000, 10000 };
+		struct rlimit rl;
+		int i;
+		/* 客户端和服务器进程都要打开上万个套接字 */
+		getrlimit(RLIMIT_NOFILE, &rl);
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		stats = mmap(NULL, sizeof(stats_t), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (stats == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+		for (i = 0; i < sizeof(conns) / sizeof(conns[0]); i++) {
+			int clients = argc > 2 ? atoi(argv[2]) : conns[i];
+			if (clients <= 0) {
+				Usage(argv[0]);
+				exit(1);
+			}
+			if (clients > (int) rl.rlim_cur - 64) {
+				printf("open file limit %d, skip %d conns\r\n",
+						(int) rl.rlim_cur, clients);
+				continue;
+			}
+			bench_server("epoll", 0, clients);
+			bench_server("io_uring", 1, clients);
+			if (argc > 2)
+				break;
+		}
+	} else {
+		Usage(argv[0]);
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,636 @@
+/*
+ * 	Net_Load.c
+ *
+ *  Created on: 2026年10月19日
+ *      Author: morris
+ *  要求：
+ *  	网络编程之---负载生成器
+ *  	用同样的方法测量各个例程的服务端，比较吞吐量和延迟
+ *	********************************************************************
+ *	1. 打开N个TCP连接(或者N个UDP流)，按目标速率发送消息，消息大小固定或者在一个范围内随机
+ *	2. 开环(open loop)：请求按计划时间发送，不等前一个回复，服务端变慢时请求排队，
+ *	延迟从计划发送时间开始计算，排队的时间也算在延迟里面(避免coordinated omission)；
+ *	速率为0时是闭环，每个连接收到回复后马上发送下一个请求
+ *	3. 每个请求的延迟记录在HDR直方图中：数值按2的幂分段，每段再等分为128份，
+ *	相对误差小于1%，占用的内存与请求数量无关，最后输出p50/p90/p99/p999
+ *	4. 支持三种协议
+ *		a. t：字节流，回复是请求加上固定长度的后缀，例如Net_Select和Net_Uring
+ *		的"\t(From Server)"是14字节，Net_Thread的"OK"是2字节；
+ *		服务端每次recv回复一次，所以每个连接同时只有一个请求在路上
+ *		b. f：Net_TCP的长度前缀分帧，请求可以流水线发送
+ *		c. u：UDP，负载前8字节是计划发送时间，服务端原样返回，
+ *		没有收到回复的请求算作丢失
+ *	5. e模式是参考回显服务器，同时回显TCP和UDP，用来确认负载生成器本身的开销
+ *	********************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PORT				5006	//参考回显服务器的端口号
+#define MAX_QUE_CONN_NUM	4096	//监听队列长度
+#define BUFFER_SIZE			65536	//接收缓冲区大小
+#define MAX_EVENTS			256		//epoll_wait一次返回的最大事件数
+#define MAX_MSG_SIZE		16384	//消息的最大长度
+#define FRAME_HEADER_SIZE	4		//Net_TCP帧头大小
+#define RING_SIZE			128		//每个连接最多排队的请求数，必须是2的幂
+#define DRAIN_SECONDS		2		//停止发送后等待回复的最长时间
+#define DEFAULT_CONNS		10
+#define DEFAULT_RATE		1000	//每秒请求数
+#define DEFAULT_SECONDS		5
+#define DEFAULT_SIZE		64
+#define NSEC_PER_SEC		1000000000ULL
+
+/* HDR直方图，小于2*HIST_SUB_COUNT的值每个值一格，更大的值每个2的幂分成HIST_SUB_COUNT格 */
+#define HIST_SUB_BITS		7
+#define HIST_SUB_COUNT		(1 << HIST_SUB_BITS)
+#define HIST_SIZE			((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+enum {
+	PROTO_STREAM, PROTO_FRAME, PROTO_UDP
+};
+
+typedef struct {
+	uint64_t counts[HIST_SIZE];
+	uint64_t total;
+	uint64_t min, max;
+} hist_t;
+
+/*
+ * 连接(或者UDP流)，ring中[head,sent)是已经发送等待回复的请求，
+ * [sent,tail)是还没有写入发送缓冲区的请求
+ */
+typedef struct {
+	int fd;
+	int closed;
+	uint64_t when[RING_SIZE]; //计划发送时间(ns)
+	uint32_t size[RING_SIZE]; //负载长度
+	uint32_t head, sent, tail;
+	uint32_t rx; //当前回复已经收到的字节数
+	char* out; //发送缓冲区
+	int out_off, out_len, out_cap;
+	int want_out; //是否在等待EPOLLOUT
+} conn_t;
+
+typedef struct {
+	int proto;
+	int conns;
+	int rate; //0表示闭环
+	int seconds;
+	int min_size, max_size;
+	int extra; //字节流协议中回复比请求多的字节数
+	int epfd;
+	uint64_t end; //停止发送的时间
+	uint64_t issued, completed, errors, overflow, pending;
+	uint64_t bytes;
+	uint64_t last; //最后一个回复的时间
+	uint32_t seed;
+	hist_t hist;
+} load_t;
+
+static load_t load;
+static char payload[MAX_MSG_SIZE];
+
+/* 程序使用说明 */
+void Usage(char* arg) {
+	printf("Usage:%s t/T ipaddr port [conns] [rate] [seconds] [size[-max]] "
+			"[extra]\r\n", arg);
+	printf("Usage:%s f/F ipaddr port [conns] [rate] [seconds] [size[-max]]"
+			"\r\n", arg);
+	printf("Usage:%s u/U ipaddr port [flows] [rate] [seconds] [size[-max]]"
+			"\r\n", arg);
+	printf("Usage:%s e/E [port]\r\n", arg);
+	printf("rate=0 means closed loop\r\n");
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int hist_index(uint64_t v) {
+	int shift;
+	if (v < 2 * HIST_SUB_COUNT)
+		return v;
+	shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return (shift + 1) * HIST_SUB_COUNT + (v >> shift) - HIST_SUB_COUNT;
+}
+
+/* 一格中的最大值 */
+static uint64_t hist_value(int index) {
+	int shift;
+	uint64_t sub;
+	if (index < 2 * HIST_SUB_COUNT)
+		return index;
+	shift = index / HIST_SUB_COUNT - 1;
+	sub = index % HIST_SUB_COUNT + HIST_SUB_COUNT;
+	return ((sub + 1) << shift) - 1;
+}
+
+static void hist_record(hist_t* h, uint64_t v) {
+	h->counts[hist_index(v)]++;
+	if (h->total == 0 || v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+	h->total++;
+}
+
+/* 第p百分位的值，p在0~100之间 */
+static uint64_t hist_percentile(const hist_t* h, double p) {
+	uint64_t rank = (uint64_t) (p / 100 * h->total + 0.5), count = 0;
+	int i;
+	if (rank == 0)
+		rank = 1;
+	for (i = 0; i < HIST_SIZE; i++) {
+		count += h->counts[i];
+		if (count >= rank)
+			return hist_value(i) < h->max ? hist_value(i) : h->max;
+	}
+	return h->max;
+}
+
+static int next_size(void) {
+	if (load.min_size == load.max_size)
+		return load.min_size;
+	load.seed = load.seed * 1103515245 + 12345;
+	return load.min_size + (load.seed >> 8) % (load.max_size - load.min_size + 1);
+}
+
+/* 请求的回复长度 */
+static uint32_t reply_size(uint32_t size) {
+	if (load.proto == PROTO_FRAME)
+		return FRAME_HEADER_SIZE + size;
+	return size + load.extra;
+}
+
+static void conn_update(conn_t* c, int want_out) {
+	struct epoll_event ev;
+	if (c->want_out == want_out)
+		return;
+	c->want_out = want_out;
+	ev.events = EPOLLIN | (want_out ? EPOLLOUT : 0);
+	ev.data.ptr = c;
+	epoll_ctl(load.epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/* 连接出错，没有回复的请求都算作错误 */
+static void conn_close(conn_t* c) {
+	load.errors += c->tail - c->head;
+	load.pending -= c->tail - c->head;
+	c->head = c->sent = c->tail;
+	c->closed = 1;
+	epoll_ctl(load.epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+}
+
+/* 把排队的请求写入发送缓冲区再发送，字节流协议同时只发送一个请求 */
+static void conn_flush(conn_t* c) {
+	uint32_t size, len;
+	int ret;
+	while (c->sent != c->tail) {
+		if (load.proto == PROTO_STREAM && c->head != c->sent)
+			break;
+		size = c->size[c->sent % RING_SIZE];
+		if (c->out_len + FRAME_HEADER_SIZE + size > c->out_cap) {
+			if (c->out_off == 0)
+				break;
+			memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+			c->out_len -= c->out_off;
+			c->out_off = 0;
+			continue;
+		}
+		if (load.proto == PROTO_FRAME) {
+			len = htonl(size);
+			memcpy(c->out + c->out_len, &len, FRAME_HEADER_SIZE);
+			c->out_len += FRAME_HEADER_SIZE;
+		}
+		memcpy(c->out + c->out_len, payload, size);
+		c->out_len += size;
+		c->sent++;
+	}
+	while (c->out_off < c->out_len) {
+		ret = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+		MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			conn_close(c);
+			return;
+		}
+		c->out_off += ret;
+		load.bytes += ret;
+	}
+	if (c->out_off == c->out_len)
+		c->out_off = c->out_len = 0;
+	conn_update(c, c->out_off < c->out_len);
+}
+
+/* 发送一个计划在when时刻发送的请求，排队的请求太多时丢弃 */
+static void conn_issue(conn_t* c, uint64_t when) {
+	char buf[MAX_MSG_SIZE];
+	int size = next_size();
+	if (c->closed)
+		return;
+	load.issued++;
+	if (load.proto == PROTO_UDP) {
+		memcpy(buf, &when, sizeof(when));
+		memcpy(buf + sizeof(when), payload + sizeof(when), size - sizeof(when));
+		if (send(c->fd, buf, size, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+			load.overflow++;
+			return;
+		}
+		load.bytes += size;
+		load.pending++;
+		return;
+	}
+	if (c->tail - c->head == RING_SIZE) {
+		load.overflow++;
+		return;
+	}
+	c->when[c->tail % RING_SIZE] = when;
+	c->size[c->tail % RING_SIZE] = size;
+	c->tail++;
+	load.pending++;
+	conn_flush(c);
+}
+
+static void conn_complete(uint64_t when, uint64_t now) {
+	hist_record(&load.hist, now > when ? now - when : 0);
+	load.completed++;
+	load.pending--;
+	load.last = now;
+}
+
+/* 读取回复，按长度划分出每个请求的回复 */
+static void conn_read(conn_t* c) {
+	char buf[BUFFER_SIZE];
+	uint64_t when, now;
+	uint32_t need;
+	int ret, done;
+	while (1) {
+		ret = recv(c->fd, buf, sizeof(buf), 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EAGAIN)
+			break;
+		if (ret <= 0) {
+			conn_close(c);
+			return;
+		}
+		now = now_ns();
+		if (load.proto == PROTO_UDP) {
+			if (ret >= sizeof(when) && load.pending > 0) {
+				memcpy(&when, buf, sizeof(when));
+				conn_complete(when, now);
+			}
+			continue;
+		}
+		c->rx += ret;
+		done = 0;
+		while (c->head != c->sent) {
+			need = reply_size(c->size[c->head % RING_SIZE]);
+			if (c->rx < need)
+				break;
+			c->rx -= need;
+			conn_complete(c->when[c->head % RING_SIZE], now);
+			c->head++;
+			done++;
+		}
+		/* 闭环时收到一个回复就发送下一个请求 */
+		if (load.rate == 0 && now < load.end)
+			while (done-- > 0)
+				conn_issue(c, now);
+		else if (done > 0)
+			conn_flush(c);
+	}
+}
+
+/* 打开所有连接 */
+static conn_t* load_connect(struct sockaddr_in* addr) {
+	conn_t* conns = calloc(load.conns, sizeof(conn_t));
+	struct epoll_event ev;
+	int i, opt = 1;
+	if (conns == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < load.conns; i++) {
+		conns[i].fd = socket(AF_INET,
+				load.proto == PROTO_UDP ? SOCK_DGRAM : SOCK_STREAM, 0);
+		if (conns[i].fd < 0) {
+			perror("socket");
+			exit(1);
+		}
+		if (connect(conns[i].fd, (struct sockaddr*) addr, sizeof(*addr)) < 0) {
+			perror("connect");
+			exit(1);
+		}
+		if (load.proto != PROTO_UDP)
+			setsockopt(conns[i].fd, IPPROTO_TCP, TCP_NODELAY, &opt,
+					sizeof(opt));
+		fcntl(conns[i].fd, F_SETFL, O_NONBLOCK);
+		conns[i].out_cap = 2 * (FRAME_HEADER_SIZE + load.max_size);
+		if (conns[i].out_cap < 4096)
+			conns[i].out_cap = 4096;
+		conns[i].out = malloc(conns[i].out_cap);
+		if (conns[i].out == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		ev.events = EPOLLIN;
+		ev.data.ptr = &conns[i];
+		epoll_ctl(load.epfd, EPOLL_CTL_ADD, conns[i].fd, &ev);
+	}
+	return conns;
+}
+
+/* 按计划发送请求，直到时间结束并且收到所有回复，或者等待回复超时 */
+static void load_run(struct sockaddr_in* addr) {
+	struct epoll_event events[MAX_EVENTS];
+	struct timespec timeout;
+	conn_t* conns;
+	conn_t* c;
+	uint64_t start, now, next, interval, wait;
+	uint64_t k = 0;
+	int i, n;
+	load.epfd = epoll_create1(0);
+	if (load.epfd < 0) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	conns = load_connect(addr);
+	start = next = now = now_ns();
+	load.end = start + load.seconds * NSEC_PER_SEC;
+	interval = load.rate ? NSEC_PER_SEC / load.rate : 0;
+	if (load.rate == 0)
+		for (i = 0; i < load.conns; i++)
+			conn_issue(&conns[i], start);
+	while (1) {
+		now = now_ns();
+		/* 补发所有已经到时间的请求，依次分配给各个连接 */
+		while (load.rate && next <= now && next < load.end) {
+			conn_issue(&conns[k++ % load.conns], next);
+			next += interval;
+		}
+		if (now >= load.end
+				&& (load.pending == 0
+						|| now >= load.end + DRAIN_SECONDS * NSEC_PER_SEC))
+			break;
+		if (load.rate && next < load.end)
+			wait = next - now;
+		else if (now < load.end)
+			wait = load.end - now;
+		else
+			wait = load.end + DRAIN_SECONDS * NSEC_PER_SEC - now;
+		timeout.tv_sec = wait / NSEC_PER_SEC;
+		timeout.tv_nsec = wait % NSEC_PER_SEC;
+		n = epoll_pwait2(load.epfd, events, MAX_EVENTS, &timeout, NULL);
+		if (n < 0 && errno != EINTR) {
+			perror("epoll_pwait2");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			c = events[i].data.ptr;
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				conn_read(c);
+			if (!c->closed && (events[i].events & EPOLLOUT))
+				conn_flush(c);
+		}
+	}
+	if (load.last == 0)
+		load.last = now;
+	printf("%s, %d %s, %d s, %d", load.proto == PROTO_UDP ? "udp" :
+			load.proto == PROTO_FRAME ? "frame" : "stream", load.conns,
+			load.proto == PROTO_UDP ? "flows" : "conns", load.seconds,
+			load.min_size);
+	if (load.max_size != load.min_size)
+		printf("-%d", load.max_size);
+	printf(" bytes\r\n");
+	if (load.rate)
+		printf("target   %d req/s (open loop)\r\n", load.rate);
+	else
+		printf("target   closed loop\r\n");
+	printf("achieved %.0f req/s, %.2f MB/s sent\r\n",
+			load.completed * 1e9 / (load.last - start),
+			load.bytes / 1e6 * 1e9 / (load.last - start));
+	printf("requests %llu issued, %llu completed, %llu %s, %llu errors, "
+			"%llu overflow\r\n", (unsigned long long) load.issued,
+			(unsigned long long) load.completed,
+			(unsigned long long) load.pending,
+			load.proto == PROTO_UDP ? "lost" : "timeout",
+			(unsigned long long) load.errors,
+			(unsigned long long) load.overflow);
+	if (load.hist.total > 0)
+		printf("latency  min %.1f p50 %.1f p90 %.1f p99 %.1f p999 %.1f "
+				"max %.1f us\r\n", load.hist.min / 1e3,
+				hist_percentile(&load.hist, 50) / 1e3,
+				hist_percentile(&load.hist, 90) / 1e3,
+				hist_percentile(&load.hist, 99) / 1e3,
+				hist_percentile(&load.hist, 99.9) / 1e3, load.hist.max / 1e3);
+	for (i = 0; i < load.conns; i++) {
+		if (!conns[i].closed)
+			close(conns[i].fd);
+		free(conns[i].out);
+	}
+	free(conns);
+	close(load.epfd);
+}
+
+/*
+ * 参考回显服务器：同一个端口上回显TCP和UDP
+ * TCP连接发送不完时保存剩下的数据，等到可写再发送，在此之前不再读取
+ */
+typedef struct {
+	int fd;
+	char* pending;
+	int pending_len;
+} echo_t;
+
+static void echo_conn(int epfd, echo_t* e, int events) {
+	struct epoll_event ev;
+	char buf[BUFFER_SIZE];
+	int ret, off;
+	if (e->pending_len > 0) {
+		ret = send(e->fd, e->pending, e->pending_len, MSG_NOSIGNAL);
+		if (ret < 0 && errno != EAGAIN)
+			goto out;
+		if (ret > 0) {
+			memmove(e->pending, e->pending + ret, e->pending_len - ret);
+			e->pending_len -= ret;
+		}
+		if (e->pending_len > 0)
+			return;
+		ev.events = EPOLLIN;
+		ev.data.ptr = e;
+		epoll_ctl(epfd, EPOLL_CTL_MOD, e->fd, &ev);
+	}
+	while ((ret = recv(e->fd, buf, sizeof(buf), 0)) > 0) {
+		for (off = 0; off < ret;) {
+			int n = send(e->fd, buf + off, ret - off, MSG_NOSIGNAL);
+			if (n < 0 && errno == EAGAIN) {
+				e->pending = realloc(e->pending, ret - off);
+				memcpy(e->pending, buf + off, ret - off);
+				e->pending_len = ret - off;
+				ev.events = EPOLLOUT;
+				ev.data.ptr = e;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, e->fd, &ev);
+				return;
+			}
+			if (n < 0)
+				goto out;
+			off += n;
+		}
+	}
+	if (ret < 0 && errno == EAGAIN)
+		return;
+	out: close(e->fd);
+	free(e->pending);
+	free(e);
+}
+
+static void server_echo(int port) {
+	struct sockaddr_in addr;
+	struct epoll_event ev, events[MAX_EVENTS];
+	char buf[BUFFER_SIZE];
+	socklen_t addrlen;
+	echo_t* e;
+	int tcp_fd, udp_fd, epfd, fd, n, i, ret, opt = 1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if (tcp_fd < 0 || udp_fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if (bind(tcp_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0
+			|| bind(udp_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		perror("bind");
+		exit(1);
+	}
+	if (listen(tcp_fd, MAX_QUE_CONN_NUM) < 0) {
+		perror("listen");
+		exit(1);
+	}
+	epfd = epoll_create1(0);
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, tcp_fd, &ev);
+	ev.data.ptr = &udp_fd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, udp_fd, &ev);
+	printf("Echo server listening on tcp/udp %d...\r\n", port);
+	while (1) {
+		n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		if (n < 0 && errno != EINTR) {
+			perror("epoll_wait");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL) {
+				while ((fd = accept4(tcp_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+					setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+					e = calloc(1, sizeof(echo_t));
+					e->fd = fd;
+					ev.events = EPOLLIN;
+					ev.data.ptr = e;
+					epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+				}
+			} else if (events[i].data.ptr == &udp_fd) {
+				addrlen = sizeof(addr);
+				while ((ret = recvfrom(udp_fd, buf, sizeof(buf), 0,
+						(struct sockaddr*) &addr, &addrlen)) >= 0) {
+					sendto(udp_fd, buf, ret, 0, (struct sockaddr*) &addr,
+							addrlen);
+					addrlen = sizeof(addr);
+				}
+			} else {
+				echo_conn(epfd, events[i].data.ptr, events[i].events);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	struct sockaddr_in addr;
+	struct hostent* host;
+	struct rlimit rl;
+	int i;
+	/* 参数检查 */
+	if (argc <= 1) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	getrlimit(RLIMIT_NOFILE, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+	if (strncasecmp(argv[1], "e", 1) == 0) {
+		server_echo(argc > 2 ? atoi(argv[2]) : PORT);
+		return 0;
+	}
+	if (strncasecmp(argv[1], "t", 1) == 0)
+		load.proto = PROTO_STREAM;
+	else if (strncasecmp(argv[1], "f", 1) == 0)
+		load.proto = PROTO_FRAME;
+	else if (strncasecmp(argv[1], "u", 1) == 0)
+		load.proto = PROTO_UDP;
+	else {
+		Usage(argv[0]);
+		exit(1);
+	}
+	if (argc <= 3) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	load.conns = argc > 4 ? atoi(argv[4]) : DEFAULT_CONNS;
+	load.rate = argc > 5 ? atoi(argv[5]) : DEFAULT_RATE;
+	load.seconds = argc > 6 ? atoi(argv[6]) : DEFAULT_SECONDS;
+	load.min_size = load.max_size = DEFAULT_SIZE;
+	if (argc > 7
+			&& sscanf(argv[7], "%d-%d", &load.min_size, &load.max_size) == 1)
+		load.max_size = load.min_size;
+	load.extra = argc > 8 ? atoi(argv[8]) : 0;
+	load.seed = getpid();
+	if (load.conns <= 0 || load.rate < 0 || load.seconds <= 0
+			|| load.min_size <= 0 || load.max_size < load.min_size
+			|| load.max_size > MAX_MSG_SIZE || load.extra < 0
+			|| (load.proto == PROTO_UDP && load.min_size < sizeof(uint64_t))) {
+		Usage(argv[0]);
+		exit(1);
+	}
+	/* 地址解析 */
+	host = gethostbyname(argv[2]);
+	if (host == NULL) {
+		perror("gethostbyname");
+		exit(1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(atoi(argv[3]));
+	addr.sin_addr = *((struct in_addr*) (host->h_addr_list[0]));
+	/* 可见字符，文本服务端打印出来也能看 */
+	for (i = 0; i < MAX_MSG_SIZE; i++)
+		payload[i] = 'a' + i % 26;
+	load_run(&addr);
+	return 0;
+}